@@ -0,0 +1,355 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "annexb_packetizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+using ElementaryMediaPacket = samsung::wasm::ElementaryMediaPacket;
+using ElementaryVideoTrackConfig = samsung::wasm::ElementaryVideoTrackConfig;
+using Seconds = samsung::wasm::Seconds;
+
+namespace {
+
+constexpr uint8_t kStartCode[] = {0, 0, 0, 1};
+constexpr size_t kShortStartCodeSize = 3;
+
+// H.264 NAL unit types, see ITU-T H.264, Table 7-1.
+constexpr uint8_t kH264NalIdrSlice = 5;
+constexpr uint8_t kH264NalSei = 6;
+constexpr uint8_t kH264NalAud = 9;
+
+// HEVC NAL unit types, see ITU-T H.265, Table 7-1.
+constexpr uint8_t kHevcNalBlaWLp = 16;
+constexpr uint8_t kHevcNalRsvIrapVcl23 = 23;
+constexpr uint8_t kHevcNalRsvVcl31 = 31;
+constexpr uint8_t kHevcNalVps = 32;
+constexpr uint8_t kHevcNalAud = 35;
+constexpr uint8_t kHevcNalPrefixSei = 39;
+constexpr uint8_t kHevcNalRsvNvcl41 = 41;
+constexpr uint8_t kHevcNalRsvNvcl44 = 44;
+constexpr uint8_t kHevcNalUnspec48 = 48;
+constexpr uint8_t kHevcNalUnspec55 = 55;
+
+#if defined(__wasm_simd128__) || defined(__SSE2__) || defined(__ARM_NEON)
+constexpr ptrdiff_t kVectorSize = 16;
+#endif
+
+}  // namespace
+
+const uint8_t* FindStartCodeScalar(const uint8_t* begin, const uint8_t* end) {
+  const auto* position = begin;
+  while (end - position >= static_cast<ptrdiff_t>(kShortStartCodeSize)) {
+    // Third byte decides how far it's safe to skip: a start code can't begin
+    // at any of the three positions if it's greater than 1, and only at the
+    // current one if it's 1.
+    if (position[2] > 1) {
+      position += 3;
+    } else if (position[2] == 1) {
+      if (position[0] == 0 && position[1] == 0)
+        return position;
+      position += 3;
+    } else {
+      ++position;
+    }
+  }
+  return end;
+}
+
+const uint8_t* FindStartCode(const uint8_t* begin, const uint8_t* end) {
+  const auto* position = begin;
+#if defined(__wasm_simd128__)
+  const auto zero = wasm_i8x16_splat(0);
+  const auto one = wasm_i8x16_splat(1);
+  while (end - position >= kVectorSize + 2) {
+    auto matches = wasm_v128_and(
+        wasm_v128_and(wasm_i8x16_eq(wasm_v128_load(position), zero),
+                      wasm_i8x16_eq(wasm_v128_load(position + 1), zero)),
+        wasm_i8x16_eq(wasm_v128_load(position + 2), one));
+    if (auto mask = wasm_i8x16_bitmask(matches))
+      return position + __builtin_ctz(mask);
+    position += kVectorSize;
+  }
+#elif defined(__SSE2__)
+  const auto zero = _mm_setzero_si128();
+  const auto one = _mm_set1_epi8(1);
+  while (end - position >= kVectorSize + 2) {
+    auto matches = _mm_and_si128(
+        _mm_and_si128(
+            _mm_cmpeq_epi8(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(position)),
+                zero),
+            _mm_cmpeq_epi8(
+                _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(position + 1)),
+                zero)),
+        _mm_cmpeq_epi8(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(position + 2)),
+            one));
+    if (auto mask = _mm_movemask_epi8(matches))
+      return position + __builtin_ctz(mask);
+    position += kVectorSize;
+  }
+#elif defined(__ARM_NEON)
+  const auto zero = vdupq_n_u8(0);
+  const auto one = vdupq_n_u8(1);
+  while (end - position >= kVectorSize + 2) {
+    auto matches = vandq_u8(vandq_u8(vceqq_u8(vld1q_u8(position), zero),
+                                     vceqq_u8(vld1q_u8(position + 1), zero)),
+                            vceqq_u8(vld1q_u8(position + 2), one));
+    // NEON has no movemask: find the exact position with a scalar search
+    // once a vector contains a match.
+    auto matches64 = vreinterpretq_u64_u8(matches);
+    if (vgetq_lane_u64(matches64, 0) | vgetq_lane_u64(matches64, 1))
+      return FindStartCodeScalar(position, position + kVectorSize + 2);
+    position += kVectorSize;
+  }
+#endif
+  return FindStartCodeScalar(position, end);
+}
+
+AnnexBPacketizer::AnnexBPacketizer(Codec codec,
+                                   const ElementaryVideoTrackConfig& config)
+    : codec_(codec),
+      config_(config),
+      frame_duration_(config.framerate_num
+                          ? Seconds{static_cast<double>(config.framerate_den) /
+                                    config.framerate_num}
+                          : Seconds{0}) {}
+
+void AnnexBPacketizer::Append(const uint8_t* data, size_t size) {
+  buffer_.insert(buffer_.end(), data, data + size);
+
+  const auto* begin = buffer_.data();
+  const auto* end = begin + buffer_.size();
+  // buffer_ begins with a start code of the NAL unit being collected.
+  const auto* nal_start = begin;
+  const auto* position = begin + scan_position_;
+  while (true) {
+    const auto* start_code = FindStartCode(position, end);
+    if (start_code == end)
+      break;
+    if (found_start_code_) {
+      ProcessNalUnit(nal_start + kShortStartCodeSize,
+                     start_code - nal_start - kShortStartCodeSize,
+                     buffer_offset_ + (nal_start - begin));
+    }
+    found_start_code_ = true;
+    nal_start = start_code;
+    position = start_code + kShortStartCodeSize;
+  }
+
+  // Keep the NAL unit being collected, as it may continue in the next chunk.
+  // Otherwise (no start code found yet) keep only bytes that may begin
+  // a start code.
+  auto keep_from = found_start_code_
+                       ? static_cast<size_t>(nal_start - begin)
+                       : buffer_.size() - std::min<size_t>(buffer_.size(), 2);
+  buffer_.erase(buffer_.begin(), buffer_.begin() + keep_from);
+  buffer_offset_ += keep_from;
+  // A start code may be split between chunks, so the last 2 bytes are
+  // scanned again.
+  scan_position_ = buffer_.size() - std::min<size_t>(buffer_.size(), 2);
+  if (found_start_code_)
+    scan_position_ = std::max(scan_position_, kShortStartCodeSize);
+}
+
+void AnnexBPacketizer::Flush() {
+  if (found_start_code_ && buffer_.size() > kShortStartCodeSize) {
+    ProcessNalUnit(buffer_.data() + kShortStartCodeSize,
+                   buffer_.size() - kShortStartCodeSize, buffer_offset_);
+  }
+  buffer_offset_ += buffer_.size();
+  buffer_.clear();
+  scan_position_ = 0;
+  found_start_code_ = false;
+  if (access_unit_has_vcl_)
+    EmitAccessUnit();
+}
+
+bool AnnexBPacketizer::PopPacket(DemuxedPacket* packet) {
+  if (packets_.empty())
+    return false;
+  *packet = std::move(packets_.front());
+  packets_.pop_front();
+  return true;
+}
+
+void AnnexBPacketizer::ResumeAt(uint64_t offset, Seconds pts) {
+  buffer_.clear();
+  buffer_offset_ = offset;
+  scan_position_ = 0;
+  found_start_code_ = false;
+  access_unit_.clear();
+  access_unit_has_vcl_ = false;
+  access_unit_is_key_frame_ = false;
+  frame_count_ = frame_duration_.count() > 0
+                     ? static_cast<uint64_t>(
+                           std::llround(pts / frame_duration_))
+                     : 0;
+  packets_.clear();
+}
+
+void AnnexBPacketizer::ProcessNalUnit(const uint8_t* nal_unit,
+                                      size_t size,
+                                      uint64_t offset) {
+  // Zero bytes preceding a 4-byte start code are not a part of the NAL unit.
+  while (size > 0 && nal_unit[size - 1] == 0)
+    --size;
+  const size_t header_size = (codec_ == Codec::kH264) ? 1 : 2;
+  if (size < header_size)
+    return;
+
+  if (access_unit_has_vcl_ && StartsAccessUnit(nal_unit, size))
+    EmitAccessUnit();
+  if (access_unit_.empty())
+    access_unit_offset_ = offset;
+
+  access_unit_.insert(access_unit_.end(), std::begin(kStartCode),
+                      std::end(kStartCode));
+  access_unit_.insert(access_unit_.end(), nal_unit, nal_unit + size);
+  if (IsVcl(nal_unit)) {
+    access_unit_has_vcl_ = true;
+    access_unit_is_key_frame_ |= IsKeyFrame(nal_unit);
+  }
+}
+
+bool AnnexBPacketizer::StartsAccessUnit(const uint8_t* nal_unit,
+                                        size_t size) const {
+  if (codec_ == Codec::kH264) {
+    auto type = nal_unit[0] & 0x1F;
+    if (IsVcl(nal_unit)) {
+      // first_mb_in_slice == 0 (ue(v) coded as a single 1 bit).
+      return size > 1 && (nal_unit[1] & 0x80);
+    }
+    // SEI, SPS, PPS, AUD and reserved types 14-18 (ITU-T H.264, 7.4.1.2.3).
+    return (type >= kH264NalSei && type <= kH264NalAud) ||
+           (type >= 14 && type <= 18);
+  }
+
+  auto type = (nal_unit[0] >> 1) & 0x3F;
+  if (IsVcl(nal_unit)) {
+    // first_slice_segment_in_pic_flag.
+    return size > 2 && (nal_unit[2] & 0x80);
+  }
+  // ITU-T H.265, 7.4.2.4.4.
+  return (type >= kHevcNalVps && type <= kHevcNalAud) ||
+         type == kHevcNalPrefixSei ||
+         (type >= kHevcNalRsvNvcl41 && type <= kHevcNalRsvNvcl44) ||
+         (type >= kHevcNalUnspec48 && type <= kHevcNalUnspec55);
+}
+
+bool AnnexBPacketizer::IsKeyFrame(const uint8_t* nal_unit) const {
+  if (codec_ == Codec::kH264)
+    return (nal_unit[0] & 0x1F) == kH264NalIdrSlice;
+  auto type = (nal_unit[0] >> 1) & 0x3F;
+  return type >= kHevcNalBlaWLp && type <= kHevcNalRsvIrapVcl23;
+}
+
+bool AnnexBPacketizer::IsVcl(const uint8_t* nal_unit) const {
+  if (codec_ == Codec::kH264) {
+    auto type = nal_unit[0] & 0x1F;
+    return type >= 1 && type <= kH264NalIdrSlice;
+  }
+  return ((nal_unit[0] >> 1) & 0x3F) <= kHevcNalRsvVcl31;
+}
+
+void AnnexBPacketizer::EmitAccessUnit() {
+  DemuxedPacket packet;
+  packet.packet = {};
+  packet.packet.pts = frame_duration_ * static_cast<double>(frame_count_);
+  packet.packet.dts = packet.packet.pts;
+  packet.packet.duration = frame_duration_;
+  packet.packet.is_key_frame = access_unit_is_key_frame_;
+  packet.packet.size = access_unit_.size();
+  packet.packet.width = config_.width;
+  packet.packet.height = config_.height;
+  packet.packet.framerate_num = config_.framerate_num;
+  packet.packet.framerate_den = config_.framerate_den;
+  packet.data = std::move(access_unit_);
+  // Splitting the stream again from the access unit's first NAL unit
+  // produces it first.
+  if (access_unit_is_key_frame_)
+    packet.resume_offset = access_unit_offset_;
+  packets_.push_back(std::move(packet));
+
+  ++frame_count_;
+  access_unit_.clear();
+  access_unit_has_vcl_ = false;
+  access_unit_is_key_frame_ = false;
+}
+
+// static
+std::unique_ptr<AnnexBFileSource> AnnexBFileSource::Open(
+    const std::string& path,
+    Codec codec,
+    const ElementaryVideoTrackConfig& config,
+    Seconds duration) {
+  auto* file = std::fopen(path.c_str(), "rb");
+  if (!file)
+    return nullptr;
+  return std::unique_ptr<AnnexBFileSource>{
+      new AnnexBFileSource(file, codec, config, duration)};
+}
+
+AnnexBFileSource::AnnexBFileSource(std::FILE* file,
+                                   Codec codec,
+                                   const ElementaryVideoTrackConfig& config,
+                                   Seconds duration)
+    : StreamingFileSource(file),
+      packetizer_(codec, config),
+      config_(config),
+      duration_(duration) {}
+
+Seconds AnnexBFileSource::GetDuration() const {
+  return duration_;
+}
+
+const ElementaryVideoTrackConfig& AnnexBFileSource::GetVideoTrackConfig()
+    const {
+  return config_;
+}
+
+bool AnnexBFileSource::ProcessChunk(const uint8_t* data, size_t size) {
+  if (size)
+    packetizer_.Append(data, size);
+  else
+    packetizer_.Flush();
+
+  DemuxedPacket packet;
+  while (packetizer_.PopPacket(&packet))
+    AddPacket(std::move(packet));
+  return true;
+}
+
+void AnnexBFileSource::ResumeAt(uint64_t offset,
+                                const ElementaryMediaPacket& first_packet) {
+  packetizer_.ResumeAt(offset, first_packet.pts);
+}
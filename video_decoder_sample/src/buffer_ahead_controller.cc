@@ -0,0 +1,136 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "buffer_ahead_controller.h"
+
+#include <algorithm>
+
+namespace {
+
+// Buffer is shrunk only after this many subsequent healthy updates.
+constexpr uint32_t kHealthyUpdatesBeforeShrink = 20;
+
+constexpr double kShrinkFactor = 0.9;
+constexpr double kGrowFactor = 2.;
+
+// Weight of the newest sample in the smoothed update interval.
+constexpr double kUpdateIntervalSmoothing = 0.125;
+
+// Buffer is kept this many times larger than the time needed to notice
+// playback progress and refill the played data.
+constexpr double kSafetyFactor = 2.;
+
+// Worker is notified about playback progress this many times per buffer.
+constexpr double kUpdatesPerBuffer = 4.;
+
+BufferAheadController::Seconds Clamp(BufferAheadController::Seconds value,
+                                     BufferAheadController::Seconds low,
+                                     BufferAheadController::Seconds high) {
+  return std::min(std::max(value, low), high);
+}
+
+}  // namespace
+
+BufferAheadController::BufferAheadController(const Config& config)
+    : config_(config),
+      buffer_ahead_(Clamp(config.initial_buffer_ahead,
+                          config.min_buffer_ahead,
+                          config.max_buffer_ahead)),
+      update_threshold_(Clamp(buffer_ahead_ / kUpdatesPerBuffer,
+                              config.min_update_threshold,
+                              config.max_update_threshold)) {}
+
+void BufferAheadController::OnPlaybackTime(Clock::time_point now,
+                                           Seconds playback_time,
+                                           Seconds buffered_until,
+                                           double append_rate,
+                                           bool byte_limited) {
+  if (has_last_update_) {
+    auto interval = std::chrono::duration_cast<Seconds>(now - last_update_);
+    update_interval_ +=
+        (interval - update_interval_) * kUpdateIntervalSmoothing;
+  }
+  last_update_ = now;
+  has_last_update_ = true;
+
+  auto margin = buffered_until - playback_time;
+  if (byte_limited) {
+    // Buffer is as full as the byte budget allows, so the pipeline keeps up
+    // and growing the buffer wouldn't help. The worker still has to learn
+    // about playback progress often enough to refill the data that fits.
+    update_threshold_ =
+        Clamp(std::min(buffer_ahead_, margin) / kUpdatesPerBuffer,
+              config_.min_update_threshold, config_.max_update_threshold);
+    return;
+  }
+
+  if (refilling_) {
+    if (margin >= config_.underrun_margin)
+      refilling_ = false;
+    return;
+  }
+
+  if (margin < config_.underrun_margin) {
+    OnUnderrun();
+    return;
+  }
+
+  OnHealthyUpdate(append_rate);
+}
+
+void BufferAheadController::OnSeek() {
+  refilling_ = true;
+  healthy_updates_ = 0;
+}
+
+void BufferAheadController::OnUnderrun() {
+  ++underrun_count_;
+  healthy_updates_ = 0;
+  refilling_ = true;
+  buffer_ahead_ = std::min(buffer_ahead_ * kGrowFactor,
+                           config_.max_buffer_ahead);
+  update_threshold_ = config_.min_update_threshold;
+}
+
+void BufferAheadController::OnHealthyUpdate(double append_rate) {
+  if (++healthy_updates_ < kHealthyUpdatesBeforeShrink)
+    return;
+  healthy_updates_ = 0;
+
+  // Without a throughput measurement it's not known how much can be saved.
+  if (append_rate <= 0.)
+    return;
+
+  // Worker learns about playback progress up to update_threshold_ (plus the
+  // update interval) late, and then needs update_threshold_ / append_rate to
+  // append the played data again.
+  auto refill_time = update_threshold_ / append_rate;
+  auto lower_bound =
+      std::max(config_.min_buffer_ahead,
+               (update_interval_ + update_threshold_ + refill_time) *
+                   kSafetyFactor);
+
+  buffer_ahead_ = Clamp(buffer_ahead_ * kShrinkFactor, lower_bound,
+                        config_.max_buffer_ahead);
+  update_threshold_ =
+      Clamp(buffer_ahead_ / kUpdatesPerBuffer, config_.min_update_threshold,
+            config_.max_update_threshold);
+}
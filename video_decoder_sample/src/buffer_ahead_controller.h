@@ -0,0 +1,101 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef WASM_PLAYER_SAMPLE_BUFFER_AHEAD_CONTROLLER_H
+#define WASM_PLAYER_SAMPLE_BUFFER_AHEAD_CONTROLLER_H
+
+#include <chrono>
+#include <cstdint>
+
+// Adjusts how far ahead of a playback position TrackDataPump buffers and how
+// often its worker is notified about playback progress.
+//
+// When the pipeline is healthy the buffer is slowly shrunk to save memory,
+// down to what is needed to cover the observed update interval and append
+// throughput. When playback position gets close to the last appended pts
+// (an underrun), the buffer is grown aggressively and the worker is notified
+// as often as possible.
+//
+// The controller has no dependencies on Tizen WASM Player, so that it can be
+// driven by a simulated track on the host.
+class BufferAheadController {
+ public:
+  using Clock = std::chrono::steady_clock;
+  // Same representation as samsung::wasm::Seconds.
+  using Seconds = std::chrono::duration<double>;
+
+  struct Config {
+    Seconds initial_buffer_ahead;
+    Seconds min_buffer_ahead;
+    Seconds max_buffer_ahead;
+    Seconds min_update_threshold;
+    Seconds max_update_threshold;
+    // Playback position closer than this to the last appended pts is
+    // considered an underrun.
+    Seconds underrun_margin;
+  };  // struct Config
+
+  explicit BufferAheadController(const Config& config);
+
+  // Should be called on every playback position update.
+  //
+  // buffered_until is the end of the last appended packet and append_rate
+  // tells how many seconds of content are appended per second of wall time
+  // (0 if it wasn't measured yet). byte_limited tells that the most recent
+  // buffering stopped at the byte budget: a margin below underrun_margin is
+  // expected then and growing the buffer wouldn't help, so it's not an
+  // underrun. Only the update threshold follows the margin then.
+  void OnPlaybackTime(Clock::time_point now,
+                      Seconds playback_time,
+                      Seconds buffered_until,
+                      double append_rate,
+                      bool byte_limited = false);
+
+  // Buffer is refilled from scratch after a seek, so underruns are not
+  // detected until that happens.
+  void OnSeek();
+
+  Seconds GetBufferAhead() const { return buffer_ahead_; }
+  Seconds GetUpdateThreshold() const { return update_threshold_; }
+  uint32_t GetUnderrunCount() const { return underrun_count_; }
+
+ private:
+  void OnUnderrun();
+  void OnHealthyUpdate(double append_rate);
+
+  const Config config_;
+
+  Seconds buffer_ahead_;
+  Seconds update_threshold_;
+
+  // Smoothed wall time between subsequent playback position updates.
+  Seconds update_interval_{0};
+  Clock::time_point last_update_;
+  bool has_last_update_{false};
+
+  // Set until the buffer is refilled after start, seek or underrun.
+  bool refilling_{true};
+
+  uint32_t healthy_updates_{0};
+  uint32_t underrun_count_{0};
+};  // class BufferAheadController
+
+#endif  // WASM_PLAYER_SAMPLE_BUFFER_AHEAD_CONTROLLER_H
@@ -21,18 +21,19 @@
 
 #include "emss_sdf_sample.h"
 
-#include <algorithm>
-#include <cstdint>
 #include <iostream>
 
-#include "sample_data.h"
+#include <emscripten/emscripten.h>
+
+#include "fmp4_demuxer.h"
+#include "packet_store.h"
+#include "tracing.h"
 
 using ElementaryMediaStreamSource = samsung::wasm::ElementaryMediaStreamSource;
 using ElementaryMediaStreamSourceListener =
     samsung::wasm::ElementaryMediaStreamSourceListener;
 using ElementaryMediaTrack = samsung::wasm::ElementaryMediaTrack;
-using ElementaryMediaTrackListener =
-    samsung::wasm::ElementaryMediaTrackListener;
+using ElementaryMediaPacket = samsung::wasm::ElementaryMediaPacket;
 using HTMLMediaElement = samsung::html::HTMLMediaElement;
 using HTMLMediaElementListener = samsung::html::HTMLMediaElementListener;
 using Seconds = samsung::wasm::Seconds;
@@ -40,162 +41,166 @@ using SessionId = samsung::wasm::SessionId;
 
 static constexpr char kVideoTagId[] = "video-element";
 
-TrackDataPump::TrackDataPump(ElementaryMediaTrack video_track)
-    : video_track_(std::move(video_track)),
-      pump_worker_([this]() { this->PumpPackets(); }),
-      last_reported_running_time_(0),
-      session_id_(video_track_.GetSessionId().value) {
-  video_track_.SetListener(this);
+// A hidden video tag used by a standby channel (see
+// SamplePlayer::PrepareStandby()).
+static constexpr char kStandbyVideoTagId[] = "standby-video-element";
+
+// Packet store file (see packet_store.h) preloaded into the module's file
+// system.
+static constexpr char kPacketStorePath[] = "/sample.emps";
+
+// Fragmented MP4 file preloaded into the module's file system.
+static constexpr char kFmp4Path[] = "/sample.mp4";
+
+static void OnMainLoopIterationCallback(void* thiz) {
+  static_cast<SamplePlayer*>(thiz)->OnMainLoopIteration();
 }
 
-TrackDataPump::~TrackDataPump() {
-  messages_.PushTerminate();
-  pump_worker_.detach();
+// Records the time of a phase that happens for the first time.
+static void MarkPhase(std::chrono::steady_clock::time_point* time) {
+  if (*time == std::chrono::steady_clock::time_point{})
+    *time = std::chrono::steady_clock::now();
 }
 
-void TrackDataPump::UpdateTime(Seconds new_time) {
-  if (last_reported_running_time_ + kWorkerUpdateThreshold > new_time) {
-    // Extensive locking of main (JS) thread should be avoided
-    // (and in this case - it is also not needed), therefore update
-    // frequency is throttled to kWorkerUpdateThreshold.
-    return;
-  }
-  last_reported_running_time_ = new_time;
-  messages_.PushBufferToPts(new_time + kBufferAhead, session_id_);
+static void SetVideoTagVisible(const char* video_tag_id, bool visible) {
+  EM_ASM(
+      {
+        document.getElementById(UTF8ToString($0))
+            .classList.toggle('invisible', !$1);
+      },
+      video_tag_id, visible);
 }
 
-void TrackDataPump::OnTrackOpen() {
-  // Trigger buffering immediately.
-  messages_.PushBufferToPts(last_reported_running_time_ + kBufferAhead,
-                            session_id_);
+static std::vector<TrackDataPump::Track> MakeTracks(
+    ElementaryMediaTrack video_track,
+    std::shared_ptr<PacketSource> packet_source) {
+  std::vector<TrackDataPump::Track> tracks;
+  tracks.push_back({std::move(video_track), std::move(packet_source)});
+  return tracks;
 }
 
-void TrackDataPump::OnTrackClosed(ElementaryMediaTrack::CloseReason) {
-  messages_.Flush();
+static std::shared_ptr<PacketSource> OpenPacketSource() {
+  std::shared_ptr<PacketSource> packet_source = Fmp4FileSource::Open(kFmp4Path);
+  if (!packet_source)
+    packet_source = PacketStore::Open(kPacketStorePath);
+  if (!packet_source)
+    packet_source = std::make_shared<SampleDataPacketSource>();
+  return packet_source;
 }
 
-void TrackDataPump::OnSeek(Seconds new_time) {
-  last_reported_running_time_ = new_time;
-  messages_.PushSeekTo(new_time);
+static std::vector<PacketPump::Track> MakeSinkTracks(
+    std::vector<TrackDataPump::Track> tracks) {
+  std::vector<PacketPump::Track> sink_tracks;
+  sink_tracks.reserve(tracks.size());
+  for (auto& track : tracks) {
+    sink_tracks.push_back(
+        {std::make_unique<ElementaryMediaTrackSink>(std::move(track.track)),
+         std::move(track.packet_source)});
+  }
+  return sink_tracks;
 }
 
-void TrackDataPump::OnSessionIdChanged(SessionId session_id) {
-  session_id_ = session_id;
+ElementaryMediaTrackSink::ElementaryMediaTrackSink(ElementaryMediaTrack track)
+    : track_(std::move(track)) {}
+
+void ElementaryMediaTrackSink::AppendPacket(
+    const ElementaryMediaPacket& packet) {
+  track_.AppendPacket(packet);
 }
 
-TrackDataPump::WorkerMessageQueue::Message::Message(Type type,
-                                                    Seconds time,
-                                                    SessionId session_id)
-    : type(type), time(time), session_id(session_id) {}
+void ElementaryMediaTrackSink::AppendEndOfTrack(SessionId session_id) {
+  track_.AppendEndOfTrack(session_id);
+}
 
-void TrackDataPump::WorkerMessageQueue::Flush() {
-  std::unique_lock<std::mutex> lock{messages_mutex_};
-  FlushWhileLocked();
+ElementaryMediaTrack& ElementaryMediaTrackSink::GetTrack() {
+  return track_;
 }
 
-TrackDataPump::WorkerMessageQueue::Message
-TrackDataPump::WorkerMessageQueue::Pop() {
-  std::unique_lock<std::mutex> lock{messages_mutex_};
-  while (message_queue_.empty()) {
-    messages_changed_.wait(lock);
+TrackDataPump::TrackDataPump(ElementaryMediaTrack video_track,
+                             std::shared_ptr<PacketSource> packet_source)
+    : TrackDataPump(std::move(video_track),
+                    std::move(packet_source),
+                    BufferPolicy{kBufferAhead, kMaxBufferedBytes,
+                                 kMaxTrackSkew}) {}
+
+TrackDataPump::TrackDataPump(ElementaryMediaTrack video_track,
+                             std::shared_ptr<PacketSource> packet_source,
+                             BufferPolicy buffer_policy)
+    : TrackDataPump(MakeTracks(std::move(video_track),
+                               std::move(packet_source)),
+                    buffer_policy,
+                    kDefaultWorkerMode) {}
+
+TrackDataPump::TrackDataPump(std::vector<Track> tracks,
+                             BufferPolicy buffer_policy,
+                             WorkerMode worker_mode,
+                             PumpThreadPool* thread_pool)
+    : PacketPump(MakeSinkTracks(std::move(tracks)),
+                 buffer_policy,
+                 worker_mode,
+                 thread_pool) {
+  // Sinks were created by MakeSinkTracks(), so all of them are track sinks.
+  tracks_.reserve(GetTrackCount());
+  for (size_t track_idx = 0; track_idx < GetTrackCount(); ++track_idx) {
+    auto& track =
+        static_cast<ElementaryMediaTrackSink*>(GetSink(track_idx))->GetTrack();
+    track.SetListener(this);
+    tracks_.push_back(&track);
   }
-  auto result = message_queue_.front();
-  message_queue_.pop();
-  return result;
+  PacketPump::OnSessionIdChanged(tracks_.front()->GetSessionId().value);
 }
 
-void TrackDataPump::WorkerMessageQueue::PushBufferToPts(Seconds time,
-                                                        SessionId session_id) {
-  {
-    std::lock_guard<std::mutex> lock{messages_mutex_};
-    message_queue_.emplace(WorkerMessageQueue::Message::Type::kSetBufferToPts,
-                           time, session_id);
-  }
-  messages_changed_.notify_one();
+void TrackDataPump::OnTrackOpen() {
+  PacketPump::OnTrackOpen();
 }
 
-void TrackDataPump::WorkerMessageQueue::PushSeekTo(Seconds time) {
-  {
-    // Seek invalidates any actions queued previously.
-    FlushWhileLocked();
-    std::lock_guard<std::mutex> lock{messages_mutex_};
-    message_queue_.emplace(WorkerMessageQueue::Message::Type::kSeekTo, time,
-                           0 /* ignored for kSeekTo */);
-  }
-  messages_changed_.notify_one();
+void TrackDataPump::OnTrackClosed(ElementaryMediaTrack::CloseReason) {
+  PacketPump::OnTrackClosed();
 }
 
-void TrackDataPump::WorkerMessageQueue::PushTerminate() {
-  {
-    std::lock_guard<std::mutex> lock{messages_mutex_};
-    FlushWhileLocked();
-    message_queue_.emplace(WorkerMessageQueue::Message::Type::kTerminate,
-                           Seconds{0} /* ignored for kTerminate */,
-                           0 /* ignored for kTerminate */);
-  }
-  messages_changed_.notify_one();
-}
-
-void TrackDataPump::WorkerMessageQueue::FlushWhileLocked() {
-  std::queue<Message> tmp;
-  message_queue_.swap(tmp);
-}
-
-// static
-size_t TrackDataPump::GetClosestKeyframeIndex(Seconds time) {
-  auto keyframe = std::find_if(
-      sample_data::kVideoPackets.crbegin(), sample_data::kVideoPackets.crend(),
-      [time](const auto& packet) {
-        return (packet.is_key_frame && packet.pts < time);
-      });
-  if (keyframe == sample_data::kVideoPackets.crend())
-    return 0;
-  return (&(*keyframe) - sample_data::kVideoPackets.data());
-}
-
-void TrackDataPump::PumpPackets() {
-  using Message = WorkerMessageQueue::Message;
-  auto ended = false;
-  auto packet_idx = 0u;
-  auto session_id = 0u;
-  while (true) {
-    auto message = messages_.Pop();
-    switch (message.type) {
-      case Message::Type::kSetBufferToPts:
-        session_id = message.session_id;
-        while (packet_idx < sample_data::kVideoPackets.size() &&
-               sample_data::kVideoPackets[packet_idx].pts < message.time) {
-          auto packet = sample_data::kVideoPackets[packet_idx];
-          packet.session_id = session_id;
-          video_track_.AppendPacket(packet);
-          ++packet_idx;
-        }
-        if (!ended && packet_idx == sample_data::kVideoPackets.size()) {
-          // Make sure to mark track as ended once all packets were sent.
-          // Since HTML video tag's 'loop' property is set, Elementary Media
-          // Stream Source will automatically seek to 0s once playback reaches
-          // end.
-          ended = true;
-          video_track_.AppendEndOfTrack(session_id);
-        }
-        break;
-      case Message::Type::kSeekTo:
-        ended = false;
-        packet_idx = GetClosestKeyframeIndex(message.time);
-        break;
-      case Message::Type::kTerminate:
-        return;
-    }
-  }
+void TrackDataPump::OnSeek(Seconds new_time) {
+  PacketPump::OnSeek(new_time);
+}
+
+void TrackDataPump::OnSessionIdChanged(SessionId session_id) {
+  PacketPump::OnSessionIdChanged(session_id);
+}
+
+ElementaryMediaTrack& TrackDataPump::GetVideoTrack() {
+  return *tracks_.front();
 }
 
 void SamplePlayer::SetUp(
     ElementaryMediaStreamSource::RenderingMode rendering_mode) {
-  media_element_ = std::make_unique<HTMLMediaElement>(kVideoTagId);
+  // Opening a file is a part of startup.
+  MarkPhase(&set_up_time_);
+  SetUp(rendering_mode, ElementaryMediaStreamSource::LatencyMode::kNormal,
+        OpenPacketSource());
+}
+
+void SamplePlayer::SetUp(
+    ElementaryMediaStreamSource::RenderingMode rendering_mode,
+    ElementaryMediaStreamSource::LatencyMode latency_mode,
+    std::shared_ptr<PacketSource> packet_source) {
+  MarkPhase(&set_up_time_);
+  tracing::SetThreadName("Main");
+  packet_source_ = std::move(packet_source);
+  rendering_mode_ = rendering_mode;
+  latency_mode_ = latency_mode;
+  video_tag_id_ = kVideoTagId;
+
+  if (TrackDataPump::kDefaultWorkerMode ==
+      TrackDataPump::WorkerMode::kMainLoop) {
+    // There is no worker thread, so the pump is run from the main loop (once
+    // per animation frame).
+    emscripten_set_main_loop_arg(&OnMainLoopIterationCallback, this, 0, 0);
+  }
+
+  media_element_ = std::make_unique<HTMLMediaElement>(video_tag_id_);
   media_element_->SetListener(this);
 
-  source_ = std::make_unique<ElementaryMediaStreamSource>(
-      ElementaryMediaStreamSource::LatencyMode::kNormal, rendering_mode);
+  source_ = std::make_unique<ElementaryMediaStreamSource>(latency_mode,
+                                                          rendering_mode);
   source_->SetListener(this);
 
   // When source_ is successfully attached to media_element_, it will change
@@ -205,22 +210,40 @@ void SamplePlayer::SetUp(
 }
 
 void SamplePlayer::OnSourceClosed() {
+  tracing::ScopedEvent trace_event{"SamplePlayer::OnSourceClosed"};
+  MarkPhase(&source_closed_time_);
+  track_data_pump_ =
+      OpenSource(source_.get(), packet_source_, false /* standby */);
+}
+
+std::unique_ptr<TrackDataPump> SamplePlayer::OpenSource(
+    ElementaryMediaStreamSource* source,
+    std::shared_ptr<PacketSource> packet_source,
+    bool standby) {
   // First, Source needs to be configured:
-  source_->SetDuration(sample_data::kStreamDuration);
-  auto add_track_result = source_->AddTrack(sample_data::kVideoTrackConfig);
+  source->SetDuration(packet_source->GetDuration());
+  auto add_track_result =
+      source->AddTrack(packet_source->GetVideoTrackConfig());
   if (!add_track_result) {
     std::cout << "Cannot add a video track!" << std::endl;
-    return;
+    return nullptr;
   }
   auto video_track = std::move(add_track_result.value);
-  track_data_pump_ = CreateTrackDataPump(std::move(video_track));
+  auto track_data_pump =
+      CreateTrackDataPump(std::move(video_track), std::move(packet_source));
+  // Must be set before the track opens.
+  track_data_pump->SetStandby(standby);
+  track_data_pump->SetFastStart(fast_start_);
 
   // Then Source can be requested to enter kOpen state (where it can accept
   // elementary media data).
-  source_->Open([](auto result) {
+  source->Open([this, standby](auto result) {
     if (result != samsung::wasm::OperationResult::kSuccess) {
       std::cout << "Cannot open ElementaryMediaStreamSource." << std::endl;
+      return;
     }
+    if (!standby)
+      MarkPhase(&source_open_time_);
     // Source entered kOpen state after Open() request.
     //
     // App can send elementary media data to ElementaryMediaTrack now, so
@@ -232,19 +255,127 @@ void SamplePlayer::OnSourceClosed() {
     //
     // The latter option is preferred and is used in TrackDataPump.
   });
+  return track_data_pump;
 }
 
 void SamplePlayer::OnPlaybackPositionChanged(Seconds new_time) {
+  tracing::ScopedEvent trace_event{"SamplePlayer::OnPlaybackPositionChanged"};
   if (track_data_pump_) {
     // Broadcast new time to a component managing data buffering...
     track_data_pump_->UpdateTime(new_time);
   }
 }
 
+void SamplePlayer::OnMainLoopIteration() {
+  if (track_data_pump_ &&
+      track_data_pump_->GetWorkerMode() ==
+          TrackDataPump::WorkerMode::kMainLoop) {
+    track_data_pump_->RunSlice(TrackDataPump::kSliceBudget);
+  }
+  if (standby_ && standby_->track_data_pump &&
+      standby_->track_data_pump->GetWorkerMode() ==
+          TrackDataPump::WorkerMode::kMainLoop) {
+    standby_->track_data_pump->RunSlice(TrackDataPump::kSliceBudget);
+  }
+}
+
+void SamplePlayer::PrepareStandby(
+    std::shared_ptr<PacketSource> packet_source) {
+  // Channels take turns using the video tags, so the standby one gets the tag
+  // not used by the playing channel.
+  const char* video_tag_id =
+      video_tag_id_ == kVideoTagId ? kStandbyVideoTagId : kVideoTagId;
+  // Previous standby channel has to release the tag first.
+  standby_.reset();
+  standby_ = std::make_unique<StandbyChannel>(this, video_tag_id,
+                                              std::move(packet_source));
+
+  // Source and pump are set up the same way as in SetUp(), except that
+  // the element stays paused and hidden until the switch.
+  standby_->source = std::make_unique<ElementaryMediaStreamSource>(
+      latency_mode_, rendering_mode_);
+  standby_->source->SetListener(standby_.get());
+  standby_->media_element = std::make_unique<HTMLMediaElement>(video_tag_id);
+  standby_->media_element->SetListener(standby_.get());
+  standby_->media_element->SetSrc(standby_->source.get());
+}
+
+bool SamplePlayer::SwitchToStandby() {
+  if (!standby_)
+    return false;
+  switch_time_ = std::chrono::steady_clock::now();
+  switch_pending_ = true;
+
+  // Playing channel is torn down first, so that at most one channel is
+  // decoding at a time.
+  if (rendering_mode_ ==
+      ElementaryMediaStreamSource::RenderingMode::kMediaElement) {
+    SetVideoTagVisible(video_tag_id_, false);
+  }
+  track_data_pump_.reset();
+  media_element_.reset();
+  source_.reset();
+
+  packet_source_ = std::move(standby_->packet_source);
+  media_element_ = std::move(standby_->media_element);
+  track_data_pump_ = std::move(standby_->track_data_pump);
+  source_ = std::move(standby_->source);
+  video_tag_id_ = standby_->video_tag_id;
+  const auto can_play = standby_->can_play;
+  standby_.reset();
+
+  // From now on the player handles all events of the channel, e.g. a source
+  // that wasn't attached yet continues in OnSourceClosed().
+  source_->SetListener(this);
+  media_element_->SetListener(this);
+  if (rendering_mode_ ==
+      ElementaryMediaStreamSource::RenderingMode::kMediaElement) {
+    SetVideoTagVisible(video_tag_id_, true);
+  }
+  if (track_data_pump_)
+    track_data_pump_->SetStandby(false);
+  // Otherwise OnCanPlay() fires once the first GOP is buffered.
+  if (can_play)
+    OnCanPlay();
+  return true;
+}
+
+Seconds SamplePlayer::GetLastSwitchLatency() const {
+  return last_switch_latency_;
+}
+
+void SamplePlayer::SetFastStart(bool fast_start) {
+  fast_start_ = fast_start;
+}
+
+SamplePlayer::StartupTimes SamplePlayer::GetStartupTimes() const {
+  auto track_open_time = track_open_time_;
+  auto first_append_time = first_append_time_;
+  if (playing_time_ == std::chrono::steady_clock::time_point{} &&
+      track_data_pump_) {
+    track_open_time = track_data_pump_->GetFirstTrackOpenTime();
+    first_append_time = track_data_pump_->GetFirstAppendTime();
+  }
+  auto since_set_up = [this](std::chrono::steady_clock::time_point time) {
+    if (time == std::chrono::steady_clock::time_point{})
+      return Seconds{-1};
+    return std::chrono::duration_cast<Seconds>(time - set_up_time_);
+  };
+  return {since_set_up(source_closed_time_), since_set_up(source_open_time_),
+          since_set_up(track_open_time),     since_set_up(first_append_time),
+          since_set_up(can_play_time_),      since_set_up(playing_time_)};
+}
+
 void SamplePlayer::OnCanPlay() {
+  tracing::ScopedEvent trace_event{"SamplePlayer::OnCanPlay"};
+  MarkPhase(&can_play_time_);
   if (!media_element_->IsPaused())
     return;
 
+  StartPlayback();
+}
+
+void SamplePlayer::StartPlayback() {
   media_element_->Play([](samsung::wasm::OperationResult result) {
     if (result != samsung::wasm::OperationResult::kSuccess) {
       std::cout << "Cannot play." << std::endl;
@@ -252,7 +383,64 @@ void SamplePlayer::OnCanPlay() {
   });
 }
 
+void SamplePlayer::OnPlaying() {
+  tracing::ScopedEvent trace_event{"SamplePlayer::OnPlaying"};
+  if (playing_time_ == std::chrono::steady_clock::time_point{}) {
+    playing_time_ = std::chrono::steady_clock::now();
+    if (track_data_pump_) {
+      track_open_time_ = track_data_pump_->GetFirstTrackOpenTime();
+      first_append_time_ = track_data_pump_->GetFirstAppendTime();
+    }
+    const auto startup_times = GetStartupTimes();
+    std::cout << "Startup: source closed "
+              << startup_times.source_closed.count() << "s, source open "
+              << startup_times.source_open.count()
+              << "s, track open " << startup_times.track_open.count()
+              << "s, first append " << startup_times.first_append.count()
+              << "s, can play " << startup_times.can_play.count()
+              << "s, playing " << startup_times.playing.count() << "s."
+              << std::endl;
+  }
+
+  if (!switch_pending_)
+    return;
+  switch_pending_ = false;
+  last_switch_latency_ = std::chrono::duration_cast<Seconds>(
+      std::chrono::steady_clock::now() - switch_time_);
+  std::cout << "Switched channels in " << last_switch_latency_.count()
+            << "s." << std::endl;
+}
+
 std::unique_ptr<TrackDataPump> SamplePlayer::CreateTrackDataPump(
-    ElementaryMediaTrack&& video_track) {
-  return std::make_unique<TrackDataPump>(std::move(video_track));
+    ElementaryMediaTrack&& video_track,
+    std::shared_ptr<PacketSource> packet_source) {
+  return std::make_unique<TrackDataPump>(
+      std::move(video_track), std::move(packet_source), GetBufferPolicy());
+}
+
+TrackDataPump::BufferPolicy SamplePlayer::GetBufferPolicy() const {
+  if (latency_mode_ == ElementaryMediaStreamSource::LatencyMode::kNormal) {
+    return {TrackDataPump::kBufferAhead, TrackDataPump::kMaxBufferedBytes,
+            TrackDataPump::kMaxTrackSkew};
+  }
+  return {TrackDataPump::kLowLatencyBufferAhead,
+          TrackDataPump::kMaxBufferedBytes, TrackDataPump::kMaxTrackSkew};
+}
+
+SamplePlayer::StandbyChannel::StandbyChannel(
+    SamplePlayer* player,
+    const char* video_tag_id,
+    std::shared_ptr<PacketSource> packet_source)
+    : player(player),
+      video_tag_id(video_tag_id),
+      packet_source(std::move(packet_source)) {}
+
+void SamplePlayer::StandbyChannel::OnSourceClosed() {
+  track_data_pump =
+      player->OpenSource(source.get(), packet_source, true /* standby */);
+}
+
+void SamplePlayer::StandbyChannel::OnCanPlay() {
+  // Playback is started by SwitchToStandby().
+  can_play = true;
 }
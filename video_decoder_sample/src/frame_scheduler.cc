@@ -0,0 +1,112 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "frame_scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Definitions of constants that are ODR-used (e.g. passed to std::max()).
+constexpr FrameScheduler::Seconds FrameScheduler::kDefaultVsyncInterval;
+constexpr FrameScheduler::Seconds FrameScheduler::kMaxClockDrift;
+constexpr FrameScheduler::Seconds FrameScheduler::kMaxExtrapolation;
+
+void FrameScheduler::OnMediaTime(Seconds media_time, Clock::time_point time) {
+  last_report_time_ = time;
+  if (has_media_clock_ &&
+      std::abs((GetMediaTime(time) - media_time).count()) <
+          kMaxClockDrift.count()) {
+    return;
+  }
+  has_media_clock_ = true;
+  anchor_media_time_ = media_time;
+  anchor_time_ = time;
+}
+
+void FrameScheduler::Reset() {
+  frames_.clear();
+  has_media_clock_ = false;
+  has_frame_ = false;
+}
+
+void FrameScheduler::QueueFrame(uint32_t frame_id, Seconds pts) {
+  frames_.push_back({frame_id, pts});
+}
+
+bool FrameScheduler::OnVsync(Clock::time_point time,
+                             uint32_t* frame_id,
+                             std::vector<uint32_t>* dropped_frame_ids) {
+  if (last_vsync_time_ != Clock::time_point{}) {
+    const auto interval =
+        std::chrono::duration_cast<Seconds>(time - last_vsync_time_);
+    // Longer gaps mean vsyncs were missed (e.g. the page was hidden), so they
+    // say nothing about the refresh rate.
+    if (interval > Seconds{0} && interval < vsync_interval_ * 1.5)
+      vsync_interval_ = vsync_interval_ * 0.9 + interval * 0.1;
+  }
+  last_vsync_time_ = time;
+
+  if (!has_media_clock_ && !frames_.empty()) {
+    has_media_clock_ = true;
+    anchor_media_time_ = frames_.front().pts;
+    anchor_time_ = time;
+    last_report_time_ = time;
+  }
+
+  // A frame is due at the vsync closest to its pts.
+  const auto due_until = GetMediaTime(time) + vsync_interval_ / 2.;
+  bool has_due_frame = false;
+  while (!frames_.empty() && frames_.front().pts <= due_until) {
+    if (has_due_frame) {
+      dropped_frame_ids->push_back(*frame_id);
+      ++stats_.dropped_count;
+    }
+    has_due_frame = true;
+    *frame_id = frames_.front().frame_id;
+    frames_.pop_front();
+  }
+  if (has_due_frame) {
+    has_frame_ = true;
+    ++stats_.presented_count;
+  } else if (has_frame_) {
+    ++stats_.repeated_count;
+  }
+  return has_due_frame;
+}
+
+FrameScheduler::Seconds FrameScheduler::GetVsyncInterval() const {
+  return vsync_interval_;
+}
+
+FrameScheduler::Stats FrameScheduler::GetStats() const {
+  return stats_;
+}
+
+FrameScheduler::Seconds FrameScheduler::GetMediaTime(
+    Clock::time_point time) const {
+  if (!has_media_clock_)
+    return Seconds{0};
+  const auto clock_time = std::min(
+      time, last_report_time_ +
+                std::chrono::duration_cast<Clock::duration>(kMaxExtrapolation));
+  return anchor_media_time_ +
+         std::chrono::duration_cast<Seconds>(clock_time - anchor_time_);
+}
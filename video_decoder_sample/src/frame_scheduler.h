@@ -0,0 +1,119 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef VIDEO_DECODER_SAMPLE_FRAME_SCHEDULER_H
+#define VIDEO_DECODER_SAMPLE_FRAME_SCHEDULER_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// Maps decoded video frames to vsync slots using the media clock.
+//
+// A frame is due at the vsync closest to its pts. When several frames are due
+// at once, only the newest one is presented and the others are dropped, as
+// they missed their slot. When no frame is due the frame on screen is
+// repeated, e.g. every 5th vsync when 50 FPS content plays on a 60 Hz panel.
+//
+// The media clock is anchored to playback positions reported by the media
+// element and extrapolated in between. Until a position is reported (after
+// startup or a seek), it's anchored to pts of the first presented frame.
+// Positions are not reported while playback is paused, so the clock stops
+// kMaxExtrapolation after the latest report.
+//
+// The scheduler has no dependencies on Tizen WASM Player nor GL, so that it
+// can be driven by a simulated vsync clock on the host (see
+// tools/frame_pacing_simulator.cc).
+class FrameScheduler {
+ public:
+  using Clock = std::chrono::steady_clock;
+  // Same representation as samsung::wasm::Seconds.
+  using Seconds = std::chrono::duration<double>;
+
+  // Vsync interval assumed until it's measured.
+  static constexpr Seconds kDefaultVsyncInterval = Seconds{1. / 60.};
+
+  // Reported playback positions closer than this to the extrapolated media
+  // clock don't move it, so that late position reports don't disturb
+  // the cadence.
+  static constexpr Seconds kMaxClockDrift = Seconds{0.05};
+
+  // Limits how far the media clock runs ahead of the latest playback position
+  // report.
+  static constexpr Seconds kMaxExtrapolation = Seconds{0.5};
+
+  struct Stats {
+    uint64_t presented_count;
+    // Frames that missed their vsync slot.
+    uint64_t dropped_count;
+    // Vsyncs that kept the previous frame on screen.
+    uint64_t repeated_count;
+  };  // struct Stats
+
+  FrameScheduler() = default;
+
+  // Playback position reported at the given time.
+  void OnMediaTime(Seconds media_time, Clock::time_point time);
+
+  // Forgets queued frames and the media clock, e.g. after a seek.
+  void Reset();
+
+  // Queues a decoded frame. Frames must be queued in presentation order.
+  void QueueFrame(uint32_t frame_id, Seconds pts);
+
+  // Picks a frame to present at a vsync happening at the given time. Returns
+  // false if the frame on screen should stay. Frames that missed their slot
+  // are appended to *dropped_frame_ids, so that their resources can be
+  // released.
+  bool OnVsync(Clock::time_point time,
+               uint32_t* frame_id,
+               std::vector<uint32_t>* dropped_frame_ids);
+
+  // Measured vsync interval.
+  Seconds GetVsyncInterval() const;
+
+  Stats GetStats() const;
+
+ private:
+  struct QueuedFrame {
+    uint32_t frame_id;
+    Seconds pts;
+  };  // struct QueuedFrame
+
+  Seconds GetMediaTime(Clock::time_point time) const;
+
+  std::deque<QueuedFrame> frames_;
+
+  bool has_media_clock_{false};
+  Seconds anchor_media_time_{0};
+  Clock::time_point anchor_time_;
+  Clock::time_point last_report_time_;
+
+  Seconds vsync_interval_{kDefaultVsyncInterval};
+  Clock::time_point last_vsync_time_;
+  // Set once a frame was presented since the last Reset().
+  bool has_frame_{false};
+
+  Stats stats_{};
+};  // class FrameScheduler
+
+#endif  // VIDEO_DECODER_SAMPLE_FRAME_SCHEDULER_H
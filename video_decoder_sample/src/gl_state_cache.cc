@@ -0,0 +1,185 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "gl_state_cache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+void GLStateCache::Invalidate() {
+  has_program_ = false;
+  has_texture_unit_ = false;
+  texture_bindings_.clear();
+  has_array_buffer_ = false;
+  has_element_array_buffer_ = false;
+  uniforms_.clear();
+}
+
+void GLStateCache::UseProgram(GLuint program) {
+  if (!Issue(!has_program_ || program_ != program))
+    return;
+  glUseProgram(program);
+  has_program_ = true;
+  program_ = program;
+}
+
+void GLStateCache::ActiveTexture(GLenum texture_unit) {
+  if (!Issue(!has_texture_unit_ || texture_unit_ != texture_unit))
+    return;
+  glActiveTexture(texture_unit);
+  has_texture_unit_ = true;
+  texture_unit_ = texture_unit;
+}
+
+void GLStateCache::BindTexture(GLenum target, GLuint texture) {
+  // Bindings depend on the active texture unit, so nothing is known about
+  // them until it's set.
+  if (!has_texture_unit_) {
+    Issue(true);
+    glBindTexture(target, texture);
+    return;
+  }
+  auto binding = std::find_if(
+      texture_bindings_.begin(), texture_bindings_.end(),
+      [this, target](const TextureBinding& binding) {
+        return binding.texture_unit == texture_unit_ &&
+               binding.target == target;
+      });
+  if (!Issue(binding == texture_bindings_.end() ||
+             binding->texture != texture)) {
+    return;
+  }
+  glBindTexture(target, texture);
+  if (binding == texture_bindings_.end())
+    texture_bindings_.push_back({texture_unit_, target, texture});
+  else
+    binding->texture = texture;
+}
+
+bool GLStateCache::BindBuffer(GLenum target, GLuint buffer) {
+  auto* has_buffer = &has_array_buffer_;
+  auto* bound_buffer = &array_buffer_;
+  if (target == GL_ELEMENT_ARRAY_BUFFER) {
+    has_buffer = &has_element_array_buffer_;
+    bound_buffer = &element_array_buffer_;
+  }
+  if (!Issue(!*has_buffer || *bound_buffer != buffer))
+    return false;
+  glBindBuffer(target, buffer);
+  *has_buffer = true;
+  *bound_buffer = buffer;
+  return true;
+}
+
+void GLStateCache::Uniform1i(GLint location, GLint value) {
+  if (!Issue(SetUniform(location, {static_cast<GLfloat>(value), 0, 0, 0})))
+    return;
+  glUniform1i(location, value);
+}
+
+void GLStateCache::Uniform2f(GLint location, GLfloat x, GLfloat y) {
+  if (!Issue(SetUniform(location, {x, y, 0, 0})))
+    return;
+  glUniform2f(location, x, y);
+}
+
+void GLStateCache::Uniform4f(GLint location,
+                             GLfloat x,
+                             GLfloat y,
+                             GLfloat z,
+                             GLfloat w) {
+  if (!Issue(SetUniform(location, {x, y, z, w})))
+    return;
+  glUniform4f(location, x, y, z, w);
+}
+
+void GLStateCache::DrawArrays(GLenum mode, GLint first, GLsizei count) {
+  Issue(true);
+  glDrawArrays(mode, first, count);
+}
+
+void GLStateCache::EndFrame() {
+#ifndef NDEBUG
+  if (++frames_since_error_check_ >= kErrorCheckInterval) {
+    frames_since_error_check_ = 0;
+    bool has_error = false;
+    for (;;) {
+      Issue(true);
+      const auto error = glGetError();
+      if (error == GL_NO_ERROR)
+        break;
+      std::cout << "GL error 0x" << std::hex << error << std::dec
+                << " during the last " << kErrorCheckInterval << " frames"
+                << std::endl;
+      has_error = true;
+    }
+    assert(!has_error);
+  }
+#endif  // NDEBUG
+  calls_per_frame_.Record(frame_call_count_);
+  frame_call_count_ = 0;
+  ++stats_.frame_count;
+}
+
+uint32_t GLStateCache::GetFrameCallCount() const {
+  return frame_call_count_;
+}
+
+const Histogram& GLStateCache::GetCallsPerFrame() const {
+  return calls_per_frame_;
+}
+
+GLStateCache::Stats GLStateCache::GetStats() const {
+  return stats_;
+}
+
+bool GLStateCache::Issue(bool state_changes) {
+  if (!state_changes) {
+    ++stats_.skipped_calls;
+    return false;
+  }
+  ++frame_call_count_;
+  ++stats_.issued_calls;
+  return true;
+}
+
+// static
+uint64_t GLStateCache::GetUniformKey(GLuint program, GLint location) {
+  return (uint64_t{program} << 32) | static_cast<uint32_t>(location);
+}
+
+bool GLStateCache::SetUniform(GLint location,
+                              const std::array<GLfloat, 4>& value) {
+  // Values are unknown while no program is known to be in use. Location -1 is
+  // silently ignored by GL.
+  if (!has_program_)
+    return location != -1;
+  if (location == -1)
+    return false;
+  auto inserted = uniforms_.emplace(GetUniformKey(program_, location), value);
+  if (inserted.second)
+    return true;
+  if (inserted.first->second == value)
+    return false;
+  inserted.first->second = value;
+  return true;
+}
@@ -0,0 +1,125 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef VIDEO_DECODER_SAMPLE_GL_STATE_CACHE_H
+#define VIDEO_DECODER_SAMPLE_GL_STATE_CACHE_H
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <GLES2/gl2.h>
+
+#include "histogram.h"
+
+// Issues GL calls of a render loop, skipping the ones that wouldn't change GL
+// state (e.g. binding the program that is already in use or uploading
+// a uniform value that didn't change).
+//
+// glGetError() is a full pipeline sync in WebGL-backed contexts, so it's not
+// called after every draw: debug builds check for errors once per
+// kErrorCheckInterval frames and release builds don't check at all.
+//
+// The cache assumes state it tracks is changed only through it. Call
+// Invalidate() after changing it directly, e.g. when setting up GL objects.
+// It also counts GL calls issued on each frame, which makes it easy to see
+// the cost of a render loop on the host (see tools/gl_render_benchmark.cc).
+class GLStateCache {
+ public:
+  // Debug builds check for GL errors once per this many frames.
+  static constexpr uint32_t kErrorCheckInterval = 60;
+
+  struct Stats {
+    // GL calls made through the cache, including glGetError().
+    uint64_t issued_calls;
+    // Calls skipped as they wouldn't change GL state.
+    uint64_t skipped_calls;
+    uint64_t frame_count;
+  };  // struct Stats
+
+  GLStateCache() = default;
+
+  GLStateCache(const GLStateCache&) = delete;
+  GLStateCache& operator=(const GLStateCache&) = delete;
+
+  // Forgets all tracked state, so that the next calls are issued.
+  void Invalidate();
+
+  void UseProgram(GLuint program);
+  void ActiveTexture(GLenum texture_unit);
+  void BindTexture(GLenum target, GLuint texture);
+  // Returns true if the call was issued, i.e. another buffer was bound (or
+  // nothing was known about the binding). Vertex attribute pointers refer to
+  // the buffer bound when they were set, so they need to be set again then.
+  bool BindBuffer(GLenum target, GLuint buffer);
+
+  // Uniform values are tracked per program, so these apply to the program in
+  // use.
+  void Uniform1i(GLint location, GLint value);
+  void Uniform2f(GLint location, GLfloat x, GLfloat y);
+  void Uniform4f(GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w);
+
+  void DrawArrays(GLenum mode, GLint first, GLsizei count);
+
+  // Records the number of GL calls issued during the frame and, in debug
+  // builds, checks for GL errors once per kErrorCheckInterval frames.
+  void EndFrame();
+
+  // GL calls issued since the last EndFrame().
+  uint32_t GetFrameCallCount() const;
+  // Distribution of GL calls issued per frame.
+  const Histogram& GetCallsPerFrame() const;
+  Stats GetStats() const;
+
+ private:
+  struct TextureBinding {
+    GLenum texture_unit;
+    GLenum target;
+    GLuint texture;
+  };  // struct TextureBinding
+
+  // Returns true if the call should be issued. Counts it either way.
+  bool Issue(bool state_changes);
+
+  // Uniforms are keyed by program and location.
+  static uint64_t GetUniformKey(GLuint program, GLint location);
+  // Returns true and remembers the value if the uniform has another value.
+  bool SetUniform(GLint location, const std::array<GLfloat, 4>& value);
+
+  bool has_program_{false};
+  GLuint program_{0};
+  bool has_texture_unit_{false};
+  GLenum texture_unit_{GL_TEXTURE0};
+  std::vector<TextureBinding> texture_bindings_;
+  bool has_array_buffer_{false};
+  GLuint array_buffer_{0};
+  bool has_element_array_buffer_{false};
+  GLuint element_array_buffer_{0};
+  std::unordered_map<uint64_t, std::array<GLfloat, 4>> uniforms_;
+
+  uint32_t frame_call_count_{0};
+  uint32_t frames_since_error_check_{0};
+  Stats stats_{};
+  Histogram calls_per_frame_;
+};  // class GLStateCache
+
+#endif  // VIDEO_DECODER_SAMPLE_GL_STATE_CACHE_H
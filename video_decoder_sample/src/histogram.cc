@@ -0,0 +1,140 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+constexpr uint32_t Histogram::kSubBucketBits;
+constexpr uint32_t Histogram::kMaxValueBits;
+constexpr size_t Histogram::kBucketCount;
+
+namespace {
+
+uint32_t GetMostSignificantBit(uint64_t value) {
+  uint32_t bit = 0;
+  while (value >>= 1)
+    ++bit;
+  return bit;
+}
+
+}  // namespace
+
+void Histogram::Record(uint64_t value) {
+  buckets_[GetBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+
+  auto min = min_.load(std::memory_order_relaxed);
+  while (value < min &&
+         !min_.compare_exchange_weak(min, value, std::memory_order_relaxed)) {
+  }
+  auto max = max_.load(std::memory_order_relaxed);
+  while (value > max &&
+         !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+  }
+}
+
+uint64_t Histogram::GetCount() const {
+  return count_.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::GetMin() const {
+  return GetCount() ? min_.load(std::memory_order_relaxed) : 0;
+}
+
+uint64_t Histogram::GetMax() const {
+  return max_.load(std::memory_order_relaxed);
+}
+
+double Histogram::GetMean() const {
+  const auto count = GetCount();
+  if (!count)
+    return 0.;
+  return static_cast<double>(sum_.load(std::memory_order_relaxed)) / count;
+}
+
+uint64_t Histogram::GetPercentile(double percentile) const {
+  const auto count = GetCount();
+  if (!count)
+    return 0;
+  const auto rank = std::max<uint64_t>(
+      1, static_cast<uint64_t>(std::ceil(percentile / 100. * count)));
+  uint64_t seen = 0;
+  for (size_t idx = 0; idx < kBucketCount; ++idx) {
+    seen += buckets_[idx].load(std::memory_order_relaxed);
+    if (seen >= rank) {
+      // Values of the last bucket are unbounded.
+      if (idx + 1 == kBucketCount)
+        return GetMax();
+      return std::min(GetBucketLowerBound(idx + 1) - 1, GetMax());
+    }
+  }
+  return GetMax();
+}
+
+void Histogram::AppendJson(std::string* json) const {
+  *json += "{\"count\":" + std::to_string(GetCount()) +
+           ",\"min\":" + std::to_string(GetMin()) +
+           ",\"max\":" + std::to_string(GetMax()) +
+           ",\"mean\":" + std::to_string(GetMean()) +
+           ",\"p50\":" + std::to_string(GetPercentile(50.)) +
+           ",\"p90\":" + std::to_string(GetPercentile(90.)) +
+           ",\"p99\":" + std::to_string(GetPercentile(99.)) +
+           ",\"p999\":" + std::to_string(GetPercentile(99.9)) +
+           ",\"buckets\":[";
+  bool first = true;
+  for (size_t idx = 0; idx < kBucketCount; ++idx) {
+    const auto bucket_count = buckets_[idx].load(std::memory_order_relaxed);
+    if (!bucket_count)
+      continue;
+    if (!first)
+      *json += ',';
+    first = false;
+    *json += '[' + std::to_string(GetBucketLowerBound(idx)) + ',' +
+             std::to_string(bucket_count) + ']';
+  }
+  *json += "]}";
+}
+
+// static
+size_t Histogram::GetBucketIndex(uint64_t value) {
+  if (value < (uint64_t{1} << kSubBucketBits))
+    return value;
+  if (value >= (uint64_t{1} << kMaxValueBits))
+    return kBucketCount - 1;
+  const auto shift = GetMostSignificantBit(value) - kSubBucketBits + 1;
+  // Top kSubBucketBits bits of the value, so the most significant one is
+  // always set.
+  const auto sub_bucket = value >> shift;
+  return (size_t{shift} << (kSubBucketBits - 1)) + sub_bucket;
+}
+
+// static
+uint64_t Histogram::GetBucketLowerBound(size_t index) {
+  constexpr size_t kSubBucketCount = size_t{1} << kSubBucketBits;
+  if (index < kSubBucketCount)
+    return index;
+  const auto shift = (index >> (kSubBucketBits - 1)) - 1;
+  const auto sub_bucket = index - (shift << (kSubBucketBits - 1));
+  return uint64_t{sub_bucket} << shift;
+}
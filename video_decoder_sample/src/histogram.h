@@ -0,0 +1,86 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef WASM_PLAYER_SAMPLE_HISTOGRAM_H
+#define WASM_PLAYER_SAMPLE_HISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+// Lock-free histogram of non-negative integer values with a bounded relative
+// error, in the spirit of HdrHistogram.
+//
+// Values are bucketed log-linearly: values below 2^kSubBucketBits have
+// a bucket each and every higher power of 2 range is split into
+// 2^(kSubBucketBits - 1) equal buckets, so a recorded value is known within
+// about 6% of its magnitude. Recording takes a few relaxed atomic operations,
+// so it can be done on hot paths of any thread while another thread reads the
+// histogram. Reads are not a consistent snapshot, which is fine for
+// monitoring.
+//
+// The histogram has no dependencies on Tizen WASM Player, so that it can be
+// used on the host.
+class Histogram {
+ public:
+  static constexpr uint32_t kSubBucketBits = 5;
+  // Larger values are recorded in the last bucket.
+  static constexpr uint32_t kMaxValueBits = 40;
+  static constexpr size_t kBucketCount =
+      ((kMaxValueBits - kSubBucketBits) << (kSubBucketBits - 1)) +
+      (size_t{1} << kSubBucketBits);
+
+  Histogram() = default;
+
+  Histogram(const Histogram&) = delete;
+  Histogram& operator=(const Histogram&) = delete;
+
+  void Record(uint64_t value);
+
+  uint64_t GetCount() const;
+  // Both return 0 if nothing was recorded.
+  uint64_t GetMin() const;
+  uint64_t GetMax() const;
+  double GetMean() const;
+
+  // Returns a value that the given percentage (0-100) of recorded values
+  // doesn't exceed, within the bucket precision.
+  uint64_t GetPercentile(double percentile) const;
+
+  // Appends a JSON object with statistics and non-empty buckets (as
+  // [lower bound, count] pairs) to *json.
+  void AppendJson(std::string* json) const;
+
+ private:
+  static size_t GetBucketIndex(uint64_t value);
+  static uint64_t GetBucketLowerBound(size_t index);
+
+  std::array<std::atomic<uint64_t>, kBucketCount> buckets_{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> sum_{0};
+  std::atomic<uint64_t> min_{std::numeric_limits<uint64_t>::max()};
+  std::atomic<uint64_t> max_{0};
+};  // class Histogram
+
+#endif  // WASM_PLAYER_SAMPLE_HISTOGRAM_H
@@ -0,0 +1,166 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "jitter_buffer.h"
+
+#include <algorithm>
+#include <limits>
+
+using ElementaryMediaPacket = samsung::wasm::ElementaryMediaPacket;
+using ElementaryVideoTrackConfig = samsung::wasm::ElementaryVideoTrackConfig;
+using Seconds = samsung::wasm::Seconds;
+
+// Definitions of constants that are ODR-used (e.g. passed to operator+()).
+constexpr std::chrono::milliseconds LivePacketSource::kEmptyPollInterval;
+
+namespace {
+
+// Comparator for std::push_heap() and std::pop_heap(), which build a max-heap.
+template <typename Entry>
+bool HasLaterDts(const Entry& lhs, const Entry& rhs) {
+  return lhs.packet.packet.dts > rhs.packet.packet.dts;
+}
+
+}  // namespace
+
+JitterBuffer::JitterBuffer(const Config& config) : config_(config) {}
+
+void JitterBuffer::Push(DemuxedPacket packet, Clock::time_point arrival_time) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  ++stats_.pushed_count;
+  const auto dts = packet.packet.dts;
+  if (has_released_ && dts <= last_released_dts_) {
+    ++stats_.late_count;
+    return;
+  }
+  if (stats_.pushed_count > 1 && dts < highest_pushed_dts_)
+    ++stats_.reordered_count;
+  highest_pushed_dts_ = std::max(highest_pushed_dts_, dts);
+
+  min_offset_ = std::min(
+      min_offset_, arrival_time.time_since_epoch() -
+                       std::chrono::duration_cast<Clock::duration>(dts));
+  heap_.push_back({std::move(packet), arrival_time});
+  std::push_heap(heap_.begin(), heap_.end(), HasLaterDts<Entry>);
+}
+
+bool JitterBuffer::Pop(Clock::time_point now, DemuxedPacket* packet) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  if (heap_.empty())
+    return false;
+  const bool overflow = heap_.size() > config_.max_packets;
+  if (!overflow && now < GetReleaseTime(heap_.front()))
+    return false;
+  if (overflow)
+    ++stats_.overflow_count;
+
+  std::pop_heap(heap_.begin(), heap_.end(), HasLaterDts<Entry>);
+  *packet = std::move(heap_.back().packet);
+  heap_.pop_back();
+  has_released_ = true;
+  last_released_dts_ = packet->packet.dts;
+  ++stats_.released_count;
+  return true;
+}
+
+JitterBuffer::Clock::time_point JitterBuffer::GetNextReleaseTime() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  if (heap_.empty())
+    return Clock::time_point::max();
+  return GetReleaseTime(heap_.front());
+}
+
+bool JitterBuffer::IsEmpty() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return heap_.empty();
+}
+
+JitterBuffer::Stats JitterBuffer::GetStats() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return stats_;
+}
+
+JitterBuffer::Clock::time_point JitterBuffer::GetReleaseTime(
+    const Entry& entry) const {
+  return Clock::time_point{} +
+         std::chrono::duration_cast<Clock::duration>(entry.packet.packet.dts +
+                                                     config_.playout_delay) +
+         min_offset_;
+}
+
+LivePacketSource::LivePacketSource(
+    const ElementaryVideoTrackConfig& config,
+    const JitterBuffer::Config& jitter_buffer_config)
+    : config_(config), jitter_buffer_(jitter_buffer_config) {}
+
+void LivePacketSource::Push(DemuxedPacket packet) {
+  jitter_buffer_.Push(std::move(packet), JitterBuffer::Clock::now());
+}
+
+void LivePacketSource::PushEndOfStream() {
+  end_of_stream_.store(true);
+}
+
+JitterBuffer::Stats LivePacketSource::GetJitterBufferStats() const {
+  return jitter_buffer_.GetStats();
+}
+
+Seconds LivePacketSource::GetDuration() const {
+  return Seconds{std::numeric_limits<Seconds::rep>::infinity()};
+}
+
+const ElementaryVideoTrackConfig& LivePacketSource::GetVideoTrackConfig()
+    const {
+  return config_;
+}
+
+size_t LivePacketSource::GetPacketCount() const {
+  return packets_.size();
+}
+
+void LivePacketSource::FillPacket(size_t index,
+                                  ElementaryMediaPacket* packet) const {
+  *packet = packets_[index].packet;
+  packet->data = packets_[index].data.data();
+}
+
+void LivePacketSource::ReadUntil(Seconds /* time */) {
+  // End of stream is checked first, so that no packet pushed before it is
+  // left behind.
+  const bool end_of_stream = end_of_stream_.load();
+  const auto now = JitterBuffer::Clock::now();
+  DemuxedPacket packet;
+  while (jitter_buffer_.Pop(now, &packet))
+    packets_.push_back(std::move(packet));
+  is_complete_ = end_of_stream && jitter_buffer_.IsEmpty();
+}
+
+bool LivePacketSource::IsComplete() const {
+  return is_complete_;
+}
+
+std::chrono::steady_clock::time_point LivePacketSource::GetNextPacketTime()
+    const {
+  const auto next_release_time = jitter_buffer_.GetNextReleaseTime();
+  if (next_release_time == JitterBuffer::Clock::time_point::max())
+    return JitterBuffer::Clock::now() + kEmptyPollInterval;
+  return next_release_time;
+}
@@ -0,0 +1,237 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "mosaic_compositor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace {
+
+// A tile is drawn as two triangles.
+constexpr size_t kVerticesPerTile = 6;
+// Position, texture coordinates and texture index.
+constexpr size_t kFloatsPerVertex = 5;
+
+enum AttributeLocation : GLuint {
+  kPositionLocation = 0,
+  kTexCoordLocation = 1,
+  kTextureIdxLocation = 2,
+};  // enum AttributeLocation
+
+const char kVertexShader[] =
+    "attribute vec2 a_position;                          \n"
+    "attribute vec2 a_texCoord;                          \n"
+    "attribute float a_textureIdx;                       \n"
+    "varying vec2 v_texCoord;                            \n"
+    "varying float v_textureIdx;                         \n"
+    "void main()                                         \n"
+    "{                                                   \n"
+    "    v_texCoord = a_texCoord;                        \n"
+    "    v_textureIdx = a_textureIdx;                    \n"
+    "    gl_Position = vec4(a_position, 0.0, 1.0);       \n"
+    "}";
+
+// GLES 2 allows indexing sampler arrays only with constant expressions, so
+// the texture is picked with a chain of conditions, one per texture drawn at
+// once.
+std::string MakeFragmentShader(GLenum texture_target, size_t texture_count) {
+  const bool is_external = (texture_target == GL_TEXTURE_EXTERNAL_OES);
+  std::string source;
+  if (is_external)
+    source += "#extension GL_OES_EGL_image_external : require\n";
+  source +=
+      "precision mediump float;\n"
+      "varying vec2 v_texCoord;\n"
+      "varying float v_textureIdx;\n";
+  source += is_external ? "uniform samplerExternalOES"
+                        : "uniform sampler2D";
+  source += " s_textures[" + std::to_string(texture_count) + "];\n";
+  source += "void main()\n{\n";
+  for (size_t texture_idx = 0; texture_idx < texture_count; ++texture_idx) {
+    const auto idx = std::to_string(texture_idx);
+    if (texture_idx + 1 < texture_count)
+      source += "    if (v_textureIdx < " + idx + ".5)\n  ";
+    source += "    gl_FragColor = texture2D(s_textures[" + idx +
+              "], v_texCoord);\n";
+    if (texture_idx + 1 < texture_count)
+      source += "    else\n";
+  }
+  source += "}\n";
+  return source;
+}
+
+}  // namespace
+
+// Definitions of constants that are ODR-used (e.g. passed to std::min()).
+constexpr size_t MosaicCompositor::kMaxTexturesPerDraw;
+
+// static
+std::vector<MosaicCompositor::Rect> MosaicCompositor::MakeGridLayout(
+    size_t tile_count) {
+  std::vector<Rect> tiles;
+  if (tile_count == 0)
+    return tiles;
+  const auto columns = static_cast<size_t>(
+      std::ceil(std::sqrt(static_cast<double>(tile_count))));
+  const auto rows = (tile_count + columns - 1) / columns;
+  const auto width = 1.f / columns;
+  const auto height = 1.f / rows;
+  for (size_t tile_idx = 0; tile_idx < tile_count; ++tile_idx) {
+    tiles.push_back({(tile_idx % columns) * width,
+                     (tile_idx / columns) * height, width, height});
+  }
+  return tiles;
+}
+
+MosaicCompositor::MosaicCompositor(ShaderProgramCache* program_cache,
+                                   GLenum texture_target,
+                                   size_t textures_per_draw)
+    : texture_target_(texture_target),
+      textures_per_draw_(std::min(std::max<size_t>(textures_per_draw, 1),
+                                  kMaxTexturesPerDraw)) {
+  CreateProgram(program_cache);
+  if (!program_)
+    return;
+
+  glGenBuffers(1, &vertex_buffer_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  const auto stride = static_cast<GLsizei>(kFloatsPerVertex * sizeof(float));
+  glEnableVertexAttribArray(kPositionLocation);
+  glVertexAttribPointer(kPositionLocation, 2, GL_FLOAT, GL_FALSE, stride, 0);
+  glEnableVertexAttribArray(kTexCoordLocation);
+  glVertexAttribPointer(kTexCoordLocation, 2, GL_FLOAT, GL_FALSE, stride,
+                        static_cast<float*>(0) + 2);
+  glEnableVertexAttribArray(kTextureIdxLocation);
+  glVertexAttribPointer(kTextureIdxLocation, 1, GL_FLOAT, GL_FALSE, stride,
+                        static_cast<float*>(0) + 4);
+  // Objects were set up directly.
+  gl_state_.Invalidate();
+}
+
+MosaicCompositor::~MosaicCompositor() {
+  if (vertex_buffer_)
+    glDeleteBuffers(1, &vertex_buffer_);
+}
+
+bool MosaicCompositor::IsValid() const {
+  return program_ != 0;
+}
+
+void MosaicCompositor::SetLayout(const std::vector<Rect>& tiles) {
+  tiles_ = tiles;
+  tile_textures_.resize(tiles_.size(), 0);
+  vertices_changed_ = true;
+}
+
+size_t MosaicCompositor::GetTileCount() const {
+  return tiles_.size();
+}
+
+void MosaicCompositor::SetTileTexture(size_t tile_idx, GLuint texture) {
+  tile_textures_[tile_idx] = texture;
+}
+
+void MosaicCompositor::Draw() {
+  draw_call_count_ = 0;
+  if (!IsValid())
+    return;
+  if (vertices_changed_)
+    UploadVertices();
+
+  gl_state_.UseProgram(program_);
+  for (size_t first_tile = 0; first_tile < tiles_.size();
+       first_tile += textures_per_draw_) {
+    const auto tile_count =
+        std::min(textures_per_draw_, tiles_.size() - first_tile);
+    for (size_t texture_idx = 0; texture_idx < tile_count; ++texture_idx) {
+      gl_state_.ActiveTexture(GL_TEXTURE0 + texture_idx);
+      gl_state_.BindTexture(texture_target_,
+                            tile_textures_[first_tile + texture_idx]);
+    }
+    gl_state_.DrawArrays(GL_TRIANGLES, first_tile * kVerticesPerTile,
+                         tile_count * kVerticesPerTile);
+    ++draw_call_count_;
+  }
+  gl_state_.EndFrame();
+}
+
+size_t MosaicCompositor::GetDrawCallCount() const {
+  return draw_call_count_;
+}
+
+const GLStateCache& MosaicCompositor::GetGLState() const {
+  return gl_state_;
+}
+
+void MosaicCompositor::CreateProgram(ShaderProgramCache* program_cache) {
+  // Attributes are listed in the order of AttributeLocation.
+  const auto program = program_cache->GetProgram(
+      kVertexShader, MakeFragmentShader(texture_target_, textures_per_draw_),
+      {"a_position", "a_texCoord", "a_textureIdx"});
+  if (!program)
+    return;
+
+  // Texture units never change, only textures bound to them.
+  GLint texture_units[kMaxTexturesPerDraw];
+  for (size_t unit_idx = 0; unit_idx < textures_per_draw_; ++unit_idx)
+    texture_units[unit_idx] = static_cast<GLint>(unit_idx);
+  glUseProgram(program);
+  glUniform1iv(glGetUniformLocation(program, "s_textures"),
+               textures_per_draw_, texture_units);
+  glUseProgram(0);
+  program_ = program;
+}
+
+void MosaicCompositor::UploadVertices() {
+  std::vector<float> vertices;
+  vertices.reserve(tiles_.size() * kVerticesPerTile * kFloatsPerVertex);
+  for (size_t tile_idx = 0; tile_idx < tiles_.size(); ++tile_idx) {
+    const auto& tile = tiles_[tile_idx];
+    // Canvas fractions to normalized device coordinates, where y grows up.
+    const float left = tile.x * 2.f - 1.f;
+    const float right = (tile.x + tile.width) * 2.f - 1.f;
+    const float top = 1.f - tile.y * 2.f;
+    const float bottom = 1.f - (tile.y + tile.height) * 2.f;
+    const auto texture_idx =
+        static_cast<float>(tile_idx % textures_per_draw_);
+    const float corners[kVerticesPerTile][4] = {
+        {left, bottom, 0.f, 1.f}, {left, top, 0.f, 0.f},
+        {right, bottom, 1.f, 1.f}, {right, bottom, 1.f, 1.f},
+        {left, top, 0.f, 0.f},    {right, top, 1.f, 0.f},
+    };
+    for (const auto& corner : corners) {
+      vertices.insert(vertices.end(), corner, corner + 4);
+      vertices.push_back(texture_idx);
+    }
+  }
+
+  gl_state_.BindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  const auto size = static_cast<GLsizeiptr>(vertices.size() * sizeof(float));
+  if (tiles_.size() > vertex_buffer_tiles_) {
+    glBufferData(GL_ARRAY_BUFFER, size, vertices.data(), GL_DYNAMIC_DRAW);
+    vertex_buffer_tiles_ = tiles_.size();
+  } else if (size > 0) {
+    glBufferSubData(GL_ARRAY_BUFFER, 0, size, vertices.data());
+  }
+  vertices_changed_ = false;
+}
@@ -0,0 +1,131 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef VIDEO_DECODER_SAMPLE_MOSAIC_COMPOSITOR_H
+#define VIDEO_DECODER_SAMPLE_MOSAIC_COMPOSITOR_H
+
+#include <cstddef>
+#include <vector>
+
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include "gl_state_cache.h"
+#include "shader_program_cache.h"
+
+// Composites textures of several video streams (e.g. a multi-view sports
+// mosaic) into one canvas in a single pass.
+//
+// All tiles share one GL context, one program and one vertex buffer holding
+// a quad per tile. Each vertex carries a texture index, so that a draw call
+// covers up to kMaxTexturesPerDraw tiles bound to consecutive texture units:
+// 16 tiles take 2 draws. The layout lives only in the vertex buffer, so it can
+// be changed at any time without recompiling shaders.
+//
+// The fragment shader picks a tile's texture with a condition per texture
+// drawn at once. That's cheap on GPUs, as all pixels of a tile take the same
+// branch, but software rasterizers evaluate every branch, so fewer textures
+// per draw may be faster there.
+//
+// The compositor must be created and used with its GL context current, whose
+// ShaderProgramCache provides the program. It
+// assumes it's the only user of vertex attributes in the context, i.e.
+// attribute pointers are set up once on creation. GL calls go through
+// a GLStateCache, which reports how many of them are issued per frame.
+//
+// It has no dependencies on Tizen WASM Player, so that it can be run with
+// a software GL on the host (see tools/gl_render_benchmark.cc).
+class MosaicCompositor {
+ public:
+  // Textures are bound to texture units 0 to kMaxTexturesPerDraw - 1. GLES 2
+  // guarantees at least 8 texture units in fragment shaders.
+  static constexpr size_t kMaxTexturesPerDraw = 8;
+
+  // Tile rectangle in fractions of the canvas size, with the origin in the top
+  // left corner.
+  struct Rect {
+    float x;
+    float y;
+    float width;
+    float height;
+  };  // struct Rect
+
+  // Lays out tile_count tiles in a grid of equal tiles with as many columns as
+  // needed for the grid to be square, filled row by row.
+  static std::vector<Rect> MakeGridLayout(size_t tile_count);
+
+  // texture_target is GL_TEXTURE_EXTERNAL_OES for textures filled by
+  // ElementaryMediaTrack::FillTextureWithNextFrame(). textures_per_draw
+  // (1 to kMaxTexturesPerDraw) limits the number of tiles drawn at once.
+  explicit MosaicCompositor(
+      ShaderProgramCache* program_cache,
+      GLenum texture_target = GL_TEXTURE_EXTERNAL_OES,
+      size_t textures_per_draw = kMaxTexturesPerDraw);
+
+  ~MosaicCompositor();
+
+  MosaicCompositor(const MosaicCompositor&) = delete;
+  MosaicCompositor& operator=(const MosaicCompositor&) = delete;
+
+  // Returns false if the shader program couldn't be built. Nothing is drawn
+  // then.
+  bool IsValid() const;
+
+  // Sets the number and placement of tiles. Textures of tiles that are kept
+  // stay the same, new tiles are empty. Vertices are uploaded on the next
+  // Draw().
+  void SetLayout(const std::vector<Rect>& tiles);
+
+  size_t GetTileCount() const;
+
+  // Sets a texture shown in a tile. Tiles without a texture are drawn black.
+  void SetTileTexture(size_t tile_idx, GLuint texture);
+
+  // Draws all tiles and ends a frame of the GL state cache.
+  void Draw();
+
+  // Draw calls made by the latest Draw().
+  size_t GetDrawCallCount() const;
+
+  const GLStateCache& GetGLState() const;
+
+ private:
+  void CreateProgram(ShaderProgramCache* program_cache);
+  void UploadVertices();
+
+  const GLenum texture_target_;
+  const size_t textures_per_draw_;
+
+  // Owned by the context's ShaderProgramCache.
+  GLuint program_{0};
+  GLuint vertex_buffer_{0};
+  // Capacity of vertex_buffer_ in tiles.
+  size_t vertex_buffer_tiles_{0};
+
+  std::vector<Rect> tiles_;
+  std::vector<GLuint> tile_textures_;
+  bool vertices_changed_{false};
+  size_t draw_call_count_{0};
+
+  GLStateCache gl_state_;
+};  // class MosaicCompositor
+
+#endif  // VIDEO_DECODER_SAMPLE_MOSAIC_COMPOSITOR_H
@@ -0,0 +1,860 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "packet_pump.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+
+#include "futex.h"
+#include "tracing.h"
+
+using Seconds = samsung::wasm::Seconds;
+using SessionId = samsung::wasm::SessionId;
+
+// Definitions of constants that are ODR-used (e.g. passed to std::max()).
+constexpr Seconds PacketPump::kBufferAhead;
+constexpr Seconds PacketPump::kMinBufferAhead;
+constexpr Seconds PacketPump::kMaxBufferAhead;
+constexpr Seconds PacketPump::kLowLatencyBufferAhead;
+constexpr Seconds PacketPump::kWorkerUpdateThreshold;
+constexpr Seconds PacketPump::kMinWorkerUpdateThreshold;
+constexpr Seconds PacketPump::kUnderrunMargin;
+constexpr Seconds PacketPump::kMaxTrackSkew;
+constexpr Seconds PacketPump::kSliceBudget;
+
+// Trace event names of handling messages, indexed by
+// WorkerMessageQueue::Message::Type.
+static const char* const kHandleMessageEventNames[] = {
+    "PacketPump::HandleMessage(kSetBufferToPts)",
+    "PacketPump::HandleMessage(kSeekTo)",
+    "PacketPump::HandleMessage(kTerminate)",
+};
+
+static uint64_t ToMicroseconds(std::chrono::steady_clock::duration duration) {
+  return std::max<std::chrono::microseconds::rep>(
+      0, std::chrono::duration_cast<std::chrono::microseconds>(duration)
+             .count());
+}
+
+KeyframeIndex::KeyframeIndex(const PacketSource& packet_source) {
+  Update(packet_source);
+}
+
+void KeyframeIndex::Update(const PacketSource& packet_source) {
+  const auto packet_count = packet_source.GetPacketCount();
+  const auto indexed_entries = entries_.size();
+  for (auto packet_idx = indexed_packet_count_; packet_idx < packet_count;
+       ++packet_idx) {
+    const auto packet = packet_source.GetPacketInfo(packet_idx);
+    if (packet.is_key_frame)
+      entries_.push_back({packet.pts, packet_idx});
+  }
+  indexed_packet_count_ = packet_count;
+
+  auto by_pts = [](const Entry& lhs, const Entry& rhs) {
+    return lhs.pts < rhs.pts;
+  };
+  auto new_entries = entries_.begin() + indexed_entries;
+  std::stable_sort(new_entries, entries_.end(), by_pts);
+  std::inplace_merge(entries_.begin(), new_entries, entries_.end(), by_pts);
+}
+
+size_t KeyframeIndex::GetClosestKeyframeIndex(Seconds time) const {
+  auto next_keyframe = std::lower_bound(
+      entries_.cbegin(), entries_.cend(), time,
+      [](const Entry& entry, Seconds time) { return entry.pts < time; });
+  if (next_keyframe == entries_.cbegin())
+    return 0;
+  return std::prev(next_keyframe)->packet_index;
+}
+
+Seconds KeyframeIndex::GetGopEnd(Seconds time) const {
+  auto next_keyframe = std::upper_bound(
+      entries_.cbegin(), entries_.cend(), time,
+      [](Seconds time, const Entry& entry) { return time < entry.pts; });
+  // Content starting with a keyframe later than the given time: the first GOP
+  // contains it.
+  if (next_keyframe == entries_.cbegin() && next_keyframe != entries_.cend())
+    ++next_keyframe;
+  if (next_keyframe == entries_.cend())
+    return Seconds{std::numeric_limits<Seconds::rep>::infinity()};
+  return next_keyframe->pts;
+}
+
+PacketPump::PacketPump(std::vector<Track> tracks,
+                       BufferPolicy buffer_policy,
+                       WorkerMode worker_mode,
+                       PumpThreadPool* thread_pool)
+    : tracks_(std::move(tracks)),
+      worker_mode_(worker_mode),
+      thread_pool_(thread_pool),
+      buffer_policy_(buffer_policy),
+      track_states_(tracks_.cbegin(), tracks_.cend()),
+      pump_worker_(worker_mode == WorkerMode::kOwnThread
+                       ? std::thread([this]() { this->PumpPackets(); })
+                       : std::thread{}),
+      last_reported_running_time_(0),
+      buffer_ahead_controller_({buffer_policy.buffer_ahead,
+                                std::min(kMinBufferAhead,
+                                         buffer_policy.buffer_ahead),
+                                std::max(kMaxBufferAhead,
+                                         buffer_policy.buffer_ahead),
+                                kMinWorkerUpdateThreshold,
+                                kWorkerUpdateThreshold,
+                                std::min(kUnderrunMargin,
+                                         buffer_policy.buffer_ahead / 2.)}) {}
+
+PacketPump::~PacketPump() {
+  Terminate();
+}
+
+Seconds PacketPump::Terminate() {
+  if (stopped_)
+    return Seconds{0};
+
+  const auto start = WorkerMessageQueue::Clock::now();
+  // kTerminate preempts buffering, so the worker stops before appending
+  // the next packet.
+  switch (worker_mode_) {
+    case WorkerMode::kOwnThread:
+      messages_.PushTerminate();
+      pump_worker_.join();
+      break;
+    case WorkerMode::kThreadPool: {
+      // A pump idle in the pool is neither queued nor running. Claiming
+      // a notification keeps wake-ups from posting it, so it's stopped
+      // without involving the pool.
+      uint32_t idle = 0;
+      if (!notification_count_.compare_exchange_strong(idle, 1)) {
+        messages_.PushTerminate();
+        NotifyWorker();
+        // The pool keeps a pointer to the pump until kTerminate is handled.
+        while (terminated_.load() == 0)
+          FutexWait(&terminated_, 0);
+      }
+      // The worker doesn't schedule wake-ups anymore, but one can be pending.
+      thread_pool_->CancelWakeUp(this);
+      break;
+    }
+    case WorkerMode::kMainLoop:
+      // Worker runs on this thread, so there is nothing to wait for.
+      break;
+  }
+  stopped_ = true;
+  return std::chrono::duration_cast<Seconds>(
+      WorkerMessageQueue::Clock::now() - start);
+}
+
+void PacketPump::UpdateTime(Seconds new_time) {
+  tracing::ScopedEvent trace_event{"PacketPump::UpdateTime"};
+  // Nobody would handle messages anymore.
+  if (stopped_)
+    return;
+  const auto buffered_until =
+      Seconds{buffered_until_.load(std::memory_order_relaxed)};
+  // Buffered data of ended tracks is unbounded.
+  if (std::isfinite(buffered_until.count())) {
+    buffer_ahead_margin_ms_.Record(static_cast<uint64_t>(
+        std::max(0., (buffered_until - new_time).count() * 1e3)));
+  }
+  buffer_ahead_controller_.OnPlaybackTime(
+      BufferAheadController::Clock::now(), new_time, buffered_until,
+      append_rate_.load(std::memory_order_relaxed),
+      byte_limited_.load(std::memory_order_relaxed));
+  if (last_reported_running_time_ +
+          buffer_ahead_controller_.GetUpdateThreshold() >
+      new_time) {
+    // Waking worker thread up too often should be avoided (and in this case -
+    // it is also not needed), therefore update frequency is throttled to
+    // the current update threshold.
+    return;
+  }
+  last_reported_running_time_ = new_time;
+  messages_.PushBufferToPts(
+      new_time + buffer_ahead_controller_.GetBufferAhead(), session_id_,
+      new_time);
+  NotifyWorker();
+}
+
+void PacketPump::OnTrackOpen() {
+  tracing::ScopedEvent trace_event{"PacketPump::OnTrackOpen"};
+  if (stopped_)
+    return;
+  seek_in_progress_ = false;
+  track_open_ = true;
+  if (first_track_open_time_ == std::chrono::steady_clock::time_point{})
+    first_track_open_time_ = std::chrono::steady_clock::now();
+  // Trigger buffering immediately.
+  const auto buffer_to_pts =
+      last_reported_running_time_ + buffer_ahead_controller_.GetBufferAhead();
+  if (fast_start_) {
+    // Worker doesn't merge a GOP-only request with the one that follows.
+    messages_.PushBufferToPts(
+        std::min(buffer_to_pts, last_reported_running_time_ + kMinBufferAhead),
+        session_id_, last_reported_running_time_, true /* gop_only */);
+    if (!standby_) {
+      messages_.PushBufferToPts(buffer_to_pts, session_id_,
+                                last_reported_running_time_);
+    }
+  } else {
+    messages_.PushBufferToPts(buffer_to_pts, session_id_,
+                              last_reported_running_time_, standby_);
+  }
+  NotifyWorker();
+}
+
+void PacketPump::OnTrackClosed() {
+  track_open_ = false;
+  messages_.Flush();
+}
+
+void PacketPump::OnSeek(Seconds new_time) {
+  tracing::ScopedEvent trace_event{"PacketPump::OnSeek"};
+  if (stopped_)
+    return;
+  if (seek_in_progress_ && last_reported_running_time_ == new_time)
+    return;
+  seek_in_progress_ = true;
+  last_reported_running_time_ = new_time;
+  buffer_ahead_controller_.OnSeek();
+  if (worker_mode_ == WorkerMode::kMainLoop) {
+    // PushSeekTo() waits for the consumer if the queue is full. Consumer runs
+    // on this thread in this mode, so make room by dropping stale messages.
+    messages_.Flush();
+    messages_.DropFlushed();
+  }
+  messages_.PushSeekTo(new_time);
+  NotifyWorker();
+}
+
+void PacketPump::OnSessionIdChanged(SessionId session_id) {
+  session_id_ = session_id;
+}
+
+PacketPump::WorkerMode PacketPump::GetWorkerMode() const {
+  return worker_mode_;
+}
+
+void PacketPump::SetFastStart(bool fast_start) {
+  fast_start_ = fast_start;
+}
+
+void PacketPump::SetStandby(bool standby) {
+  if (standby_ == standby)
+    return;
+  standby_ = standby;
+  // Buffering starts with OnTrackOpen() otherwise.
+  if (standby_ || stopped_ || !track_open_)
+    return;
+  // Buffering the rest is not throttled: playback is about to start.
+  messages_.PushBufferToPts(
+      last_reported_running_time_ + buffer_ahead_controller_.GetBufferAhead(),
+      session_id_, last_reported_running_time_);
+  NotifyWorker();
+}
+
+Seconds PacketPump::GetLastSeekLatency() const {
+  return Seconds{last_seek_latency_.load(std::memory_order_relaxed)};
+}
+
+PacketPump::BatchStats PacketPump::GetBatchStats() const {
+  return {batch_count_.load(std::memory_order_relaxed),
+          batched_packet_count_.load(std::memory_order_relaxed),
+          largest_batch_size_.load(std::memory_order_relaxed)};
+}
+
+std::string PacketPump::GetMetricsJson() const {
+  using Type = WorkerMessageQueue::Message::Type;
+  std::string json = "{\"queue_wait_us\":{\"set_buffer_to_pts\":";
+  queue_wait_us_[static_cast<size_t>(Type::kSetBufferToPts)].AppendJson(&json);
+  json += ",\"seek_to\":";
+  queue_wait_us_[static_cast<size_t>(Type::kSeekTo)].AppendJson(&json);
+  json += ",\"terminate\":";
+  queue_wait_us_[static_cast<size_t>(Type::kTerminate)].AppendJson(&json);
+  json += "},\"append_packet_us\":";
+  append_packet_us_.AppendJson(&json);
+  json += ",\"window_packets\":";
+  window_packets_.AppendJson(&json);
+  json += ",\"window_bytes\":";
+  window_bytes_.AppendJson(&json);
+  json += ",\"keyframe_lookup_us\":";
+  keyframe_lookup_us_.AppendJson(&json);
+  json += ",\"buffer_ahead_margin_ms\":";
+  buffer_ahead_margin_ms_.AppendJson(&json);
+  json += '}';
+  return json;
+}
+
+std::chrono::steady_clock::time_point PacketPump::GetFirstTrackOpenTime()
+    const {
+  return first_track_open_time_;
+}
+
+std::chrono::steady_clock::time_point PacketPump::GetFirstAppendTime() const {
+  return std::chrono::steady_clock::time_point{
+      std::chrono::steady_clock::duration{
+          first_append_time_.load(std::memory_order_relaxed)}};
+}
+
+const BufferAheadController& PacketPump::GetBufferAheadController() const {
+  return buffer_ahead_controller_;
+}
+
+size_t PacketPump::GetTrackCount() const {
+  return tracks_.size();
+}
+
+PacketSink* PacketPump::GetSink(size_t track_idx) {
+  return tracks_[track_idx].sink.get();
+}
+
+PacketPump::TrackState::TrackState(const Track& track)
+    : keyframe_index(*track.packet_source) {}
+
+PacketPump::WorkerMessageQueue::Message::Message(Type type,
+                                                 Seconds time,
+                                                 SessionId session_id,
+                                                 Seconds playback_time,
+                                                 bool gop_only)
+    : type(type),
+      time(time),
+      session_id(session_id),
+      playback_time(playback_time),
+      gop_only(gop_only) {}
+
+void PacketPump::WorkerMessageQueue::Flush() {
+  // Consumer owns read_index_, so instead of moving it the producer marks
+  // everything written so far as stale.
+  flush_index_.store(write_index_.load(std::memory_order_relaxed),
+                     std::memory_order_release);
+}
+
+bool PacketPump::WorkerMessageQueue::Pop(Clock::time_point deadline,
+                                         Message* message) {
+  while (true) {
+    auto write = write_index_.load(std::memory_order_acquire);
+    if (TryPop(message))
+      return true;
+    if (Clock::now() >= deadline)
+      return false;
+
+    consumer_waiting_.store(1);
+    // Re-check after announcing we are about to sleep: if producer published
+    // a message in the meantime, futex wait returns immediately.
+    if (write_index_.load() == write) {
+      FutexWait(&write_index_, write, deadline);
+    }
+    consumer_waiting_.store(0);
+  }
+}
+
+bool PacketPump::WorkerMessageQueue::TryPop(Message* message) {
+  auto read = read_index_.load(std::memory_order_relaxed);
+  auto flush = flush_index_.load(std::memory_order_acquire);
+  if (static_cast<int32_t>(flush - read) > 0)
+    read = flush;
+
+  auto write = write_index_.load(std::memory_order_acquire);
+  if (read == write) {
+    read_index_.store(read, std::memory_order_release);
+    return false;
+  }
+
+  *message = ring_[read % kCapacity];
+  read_index_.store(read + 1, std::memory_order_release);
+  return true;
+}
+
+void PacketPump::WorkerMessageQueue::DropFlushed() {
+  auto read = read_index_.load(std::memory_order_relaxed);
+  auto flush = flush_index_.load(std::memory_order_acquire);
+  if (static_cast<int32_t>(flush - read) > 0)
+    read_index_.store(flush, std::memory_order_release);
+}
+
+bool PacketPump::WorkerMessageQueue::HasPending() const {
+  auto read = read_index_.load(std::memory_order_relaxed);
+  auto flush = flush_index_.load(std::memory_order_acquire);
+  if (static_cast<int32_t>(flush - read) > 0)
+    read = flush;
+  return read != write_index_.load(std::memory_order_acquire);
+}
+
+uint32_t PacketPump::WorkerMessageQueue::GetFlushIndex() const {
+  return flush_index_.load(std::memory_order_acquire);
+}
+
+bool PacketPump::WorkerMessageQueue::PopPendingBufferToPts(Message* message) {
+  auto read = read_index_.load(std::memory_order_relaxed);
+  auto flush = flush_index_.load(std::memory_order_acquire);
+  if (static_cast<int32_t>(flush - read) > 0)
+    read = flush;
+
+  auto write = write_index_.load(std::memory_order_acquire);
+  if (read == write ||
+      ring_[read % kCapacity].type != Message::Type::kSetBufferToPts) {
+    read_index_.store(read, std::memory_order_release);
+    return false;
+  }
+
+  *message = ring_[read % kCapacity];
+  read_index_.store(read + 1, std::memory_order_release);
+  return true;
+}
+
+bool PacketPump::WorkerMessageQueue::IsPreempted() const {
+  return static_cast<int32_t>(
+             preempt_index_.load(std::memory_order_acquire) -
+             read_index_.load(std::memory_order_relaxed)) > 0;
+}
+
+void PacketPump::WorkerMessageQueue::PushBufferToPts(
+    Seconds time,
+    SessionId session_id,
+    Seconds playback_time,
+    bool gop_only) {
+  // Dropping this message when the ring is full is harmless: the worker is
+  // busy handling older messages and the next UpdateTime() will request an
+  // even later pts.
+  TryPush({WorkerMessageQueue::Message::Type::kSetBufferToPts, time,
+           session_id, playback_time, gop_only});
+}
+
+void PacketPump::WorkerMessageQueue::PushSeekTo(Seconds time) {
+  // Seek invalidates any actions queued previously.
+  Flush();
+  while (!TryPush({WorkerMessageQueue::Message::Type::kSeekTo, time,
+                   0 /* ignored for kSeekTo */})) {
+    std::this_thread::yield();
+  }
+  preempt_index_.store(write_index_.load(std::memory_order_relaxed),
+                       std::memory_order_release);
+}
+
+void PacketPump::WorkerMessageQueue::PushTerminate() {
+  Flush();
+  while (!TryPush({WorkerMessageQueue::Message::Type::kTerminate,
+                   Seconds{0} /* ignored for kTerminate */,
+                   0 /* ignored for kTerminate */})) {
+    std::this_thread::yield();
+  }
+  preempt_index_.store(write_index_.load(std::memory_order_relaxed),
+                       std::memory_order_release);
+}
+
+bool PacketPump::WorkerMessageQueue::TryPush(Message message) {
+  auto write = write_index_.load(std::memory_order_relaxed);
+  if (write - read_index_.load(std::memory_order_acquire) == kCapacity)
+    return false;
+
+  message.push_time = Clock::now();
+  ring_[write % kCapacity] = message;
+  write_index_.store(write + 1);
+  if (consumer_waiting_.load())
+    FutexWake(&write_index_, 1);
+  return true;
+}
+
+void PacketPump::NotifyWorker() {
+  // Own thread is woken up by messages_ and RunSlice() polls it. A pooled
+  // pump is posted to the pool unless it's already waiting there or running.
+  if (!stopped_ && worker_mode_ == WorkerMode::kThreadPool &&
+      notification_count_.fetch_add(1) == 0) {
+    thread_pool_->Post(this);
+  }
+}
+
+void PacketPump::RunSlice(Seconds budget) {
+  tracing::ScopedEvent trace_event{"PacketPump::RunSlice"};
+  if (stopped_)
+    return;
+  const auto deadline =
+      WorkerMessageQueue::Clock::now() +
+      std::chrono::duration_cast<WorkerMessageQueue::Clock::duration>(budget);
+  // Appending packets staged in a previous slice is resumed first.
+  if (worker_state_.appending) {
+    if (!ContinueAppending(deadline))
+      return;
+    FinishAppending();
+  }
+  WorkerMessageQueue::Message message;
+  while (!worker_state_.appending &&
+         WorkerMessageQueue::Clock::now() < deadline &&
+         messages_.TryPop(&message)) {
+    HandleMessage(message, deadline);
+  }
+  if (!worker_state_.appending &&
+      WorkerMessageQueue::Clock::now() >= worker_state_.wake_up_time) {
+    RetryBuffering(deadline);
+  }
+}
+
+void PacketPump::PumpPackets() {
+  tracing::SetThreadName("PacketPump");
+  constexpr auto kNoDeadline = WorkerMessageQueue::Clock::time_point::max();
+  WorkerMessageQueue::Message message;
+  while (true) {
+    if (!messages_.Pop(worker_state_.wake_up_time, &message))
+      RetryBuffering(kNoDeadline);
+    else if (!HandleMessage(message, kNoDeadline))
+      return;
+  }
+}
+
+void PacketPump::Run() {
+  auto* thread_pool = thread_pool_;
+  auto& worker = worker_state_;
+  auto notifications = notification_count_.load();
+  WorkerMessageQueue::Message message;
+  // Only a single message is handled per run, so that pumps sharing the pool
+  // take turns.
+  if (messages_.TryPop(&message)) {
+    if (!HandleMessage(message, WorkerMessageQueue::Clock::time_point::max())) {
+      // Destructor is waiting for this, so the pump can't be touched anymore.
+      // Futex wake-up only uses the address and doesn't access the memory.
+      terminated_.store(1);
+      FutexWake(&terminated_, 1);
+      return;
+    }
+  } else if (WorkerMessageQueue::Clock::now() >= worker.wake_up_time) {
+    RetryBuffering(WorkerMessageQueue::Clock::time_point::max());
+  }
+  if (worker.wake_up_time != worker.scheduled_wake_up_time) {
+    // A stale wake-up left scheduled just runs the pump in vain.
+    if (worker.wake_up_time != WorkerMessageQueue::Clock::time_point::max())
+      thread_pool->ScheduleWakeUp(this, worker.wake_up_time);
+    worker.scheduled_wake_up_time = worker.wake_up_time;
+  }
+  if (messages_.HasPending()) {
+    thread_pool->Post(this);
+    return;
+  }
+  // Pump is not posted again until the main thread notifies it. Once
+  // notification_count_ is reset the main thread can post or destroy the pump
+  // at any time, so it's not touched afterwards.
+  if (!notification_count_.compare_exchange_strong(notifications, 0))
+    thread_pool->Post(this);
+}
+
+void PacketPump::OnWakeUp() {
+  // Posted like by NotifyWorker(), so that the pump never runs on two threads
+  // at once.
+  if (notification_count_.fetch_add(1) == 0)
+    thread_pool_->Post(this);
+}
+
+bool PacketPump::HandleMessage(
+    WorkerMessageQueue::Message message,
+    WorkerMessageQueue::Clock::time_point deadline) {
+  using Message = WorkerMessageQueue::Message;
+  tracing::ScopedEvent trace_event{
+      kHandleMessageEventNames[static_cast<size_t>(message.type)]};
+  auto& worker = worker_state_;
+  RecordQueueWait(message);
+  switch (message.type) {
+    case Message::Type::kSetBufferToPts:
+      // Only the most recent target matters, so requests that piled up
+      // while the worker was busy are handled at once. A GOP-only request is
+      // handled on its own, so that its packets are appended first.
+      while (!message.gop_only && messages_.PopPendingBufferToPts(&message))
+        RecordQueueWait(message);
+      StartAppending(message);
+      if (ContinueAppending(deadline))
+        FinishAppending();
+      break;
+    case Message::Type::kSeekTo: {
+      auto keyframe_lookup_time = WorkerMessageQueue::Clock::duration{0};
+      for (size_t track_idx = 0; track_idx < tracks_.size(); ++track_idx) {
+        auto& packet_source = *tracks_[track_idx].packet_source;
+        auto& state = track_states_[track_idx];
+        packet_source.ReadUntil(message.time);
+        const auto lookup_start = WorkerMessageQueue::Clock::now();
+        state.keyframe_index.Update(packet_source);
+        state.packet_idx =
+            state.keyframe_index.GetClosestKeyframeIndex(message.time);
+        keyframe_lookup_time += WorkerMessageQueue::Clock::now() - lookup_start;
+        packet_source.DiscardPayloadsBefore(state.packet_idx);
+        // Track drops all buffered packets on seek.
+        state.played_packet_idx = state.packet_idx;
+        state.buffered_until = Seconds{0};
+        state.ended = false;
+      }
+      keyframe_lookup_us_.Record(ToMicroseconds(keyframe_lookup_time));
+      worker.buffered_bytes = 0;
+      // Buffering resumes with the next kSetBufferToPts.
+      worker.wake_up_time = WorkerMessageQueue::Clock::time_point::max();
+      worker.seek_pending = true;
+      worker.seek_time = message.push_time;
+      break;
+    }
+    case Message::Type::kTerminate:
+      return false;
+  }
+  return true;
+}
+
+void PacketPump::StartAppending(const WorkerMessageQueue::Message& message) {
+  auto& worker = worker_state_;
+  worker.session_id = message.session_id;
+  auto time = message.time;
+  for (size_t track_idx = 0; track_idx < tracks_.size(); ++track_idx) {
+    auto& packet_source = *tracks_[track_idx].packet_source;
+    auto& state = track_states_[track_idx];
+    while (state.played_packet_idx < state.packet_idx) {
+      auto played_packet =
+          packet_source.GetPacketInfo(state.played_packet_idx);
+      if (played_packet.pts >= message.playback_time)
+        break;
+      worker.buffered_bytes -= played_packet.size;
+      ++state.played_packet_idx;
+    }
+    // Payloads are kept from the keyframe preceding the playback position, so
+    // that seeking back within the GOP being played doesn't make the source
+    // read them again. Discarding first lets the source read packets it needs
+    // again (e.g. for a new pump) in ReadUntil().
+    state.keyframe_index.Update(packet_source);
+    packet_source.DiscardPayloadsBefore(std::min(
+        state.played_packet_idx,
+        state.keyframe_index.GetClosestKeyframeIndex(message.playback_time)));
+    packet_source.ReadUntil(message.time);
+  }
+  if (message.gop_only) {
+    // GOP boundaries are taken from the video track.
+    auto& state = track_states_.front();
+    state.keyframe_index.Update(*tracks_.front().packet_source);
+    time = std::min(time,
+                    state.keyframe_index.GetGopEnd(message.playback_time));
+  }
+  worker.buffer_target = message;
+  worker.buffer_target_time = time;
+  worker.buffer_target_flush_index = messages_.GetFlushIndex();
+  StagePackets(time, worker.session_id);
+  worker.appending = true;
+  worker.append_start = WorkerMessageQueue::Clock::now();
+  worker.appended_duration = Seconds{0};
+  worker.appended_count = 0;
+  worker.appended_bytes = 0;
+  worker.byte_limited = false;
+}
+
+bool PacketPump::ContinueAppending(
+    WorkerMessageQueue::Clock::time_point deadline) {
+  auto& worker = worker_state_;
+  while (true) {
+    // Packets of all tracks are appended in decoding time order, so that the
+    // track buffered the least is served first.
+    const StagedPacket* next = nullptr;
+    for (const auto& state : track_states_) {
+      if (state.staged_begin == state.staged_end)
+        continue;
+      const auto& staged = append_batch_[state.staged_begin];
+      if (!next || staged.packet.dts < next->packet.dts)
+        next = &staged;
+    }
+    if (!next)
+      return true;
+    // A pending seek will discard anything appended from now on, so stop
+    // buffering and handle it as soon as possible.
+    if (messages_.IsPreempted())
+      return true;
+    const auto& packet = next->packet;
+    // Always allow at least one packet, so that a packet larger than the
+    // budget doesn't stall playback.
+    if (worker.buffered_bytes > 0 &&
+        worker.buffered_bytes + packet.size >
+            buffer_policy_.max_buffered_bytes) {
+      worker.byte_limited = true;
+      return true;
+    }
+    if (deadline != WorkerMessageQueue::Clock::time_point::max() &&
+        WorkerMessageQueue::Clock::now() >= deadline)
+      return false;
+    auto& state = track_states_[next->track_idx];
+    const auto append_start = WorkerMessageQueue::Clock::now();
+    tracks_[next->track_idx].sink->AppendPacket(packet);
+    append_packet_us_.Record(
+        ToMicroseconds(WorkerMessageQueue::Clock::now() - append_start));
+    worker.appended_bytes += packet.size;
+    worker.appended_duration += packet.duration;
+    state.buffered_until =
+        std::max(state.buffered_until, packet.pts + packet.duration);
+    if (state.played_packet_idx == state.packet_idx &&
+        packet.pts < worker.buffer_target.playback_time) {
+      // Packets preceding the playback position (e.g. from a keyframe to
+      // a seek target) are decoded right away, so they don't take up the byte
+      // budget. Otherwise they could fill it while playback waits for data.
+      ++state.played_packet_idx;
+    } else {
+      worker.buffered_bytes += packet.size;
+    }
+    ++state.packet_idx;
+    ++state.staged_begin;
+    ++worker.appended_count;
+    if (!worker.has_appended) {
+      worker.has_appended = true;
+      first_append_time_.store(
+          WorkerMessageQueue::Clock::now().time_since_epoch().count(),
+          std::memory_order_relaxed);
+    }
+    if (worker.seek_pending) {
+      worker.seek_pending = false;
+      last_seek_latency_.store(
+          std::chrono::duration_cast<Seconds>(
+              WorkerMessageQueue::Clock::now() - worker.seek_time)
+              .count(),
+          std::memory_order_relaxed);
+    }
+  }
+}
+
+void PacketPump::FinishAppending() {
+  auto& worker = worker_state_;
+  worker.appending = false;
+  window_packets_.Record(worker.appended_count);
+  window_bytes_.Record(worker.appended_bytes);
+  if (worker.appended_count > 0) {
+    batch_count_.fetch_add(1, std::memory_order_relaxed);
+    batched_packet_count_.fetch_add(worker.appended_count,
+                                    std::memory_order_relaxed);
+    if (worker.appended_count >
+        largest_batch_size_.load(std::memory_order_relaxed)) {
+      largest_batch_size_.store(worker.appended_count,
+                                std::memory_order_relaxed);
+    }
+  }
+  auto append_time = std::chrono::duration_cast<Seconds>(
+      WorkerMessageQueue::Clock::now() - worker.append_start);
+  if (worker.appended_duration > Seconds{0} && append_time > Seconds{0}) {
+    // Tracks are appended side by side, so playback time gained is roughly
+    // the average over tracks.
+    append_rate_.store(
+        worker.appended_duration / tracks_.size() / append_time,
+        std::memory_order_relaxed);
+  }
+  for (size_t track_idx = 0; track_idx < tracks_.size(); ++track_idx) {
+    const auto& packet_source = *tracks_[track_idx].packet_source;
+    auto& state = track_states_[track_idx];
+    if (!state.ended && state.packet_idx == packet_source.GetPacketCount() &&
+        packet_source.IsComplete()) {
+      // Make sure to mark track as ended once all packets were sent. Since
+      // HTML video tag's 'loop' property is set, Elementary Media Stream
+      // Source will automatically seek to 0s once playback reaches end.
+      state.ended = true;
+      tracks_[track_idx].sink->AppendEndOfTrack(worker.session_id);
+    }
+  }
+  buffered_until_.store(GetBufferedUntil().count(),
+                        std::memory_order_relaxed);
+  byte_limited_.store(worker.byte_limited, std::memory_order_relaxed);
+  worker.wake_up_time = GetWakeUpTime();
+}
+
+void PacketPump::RetryBuffering(
+    WorkerMessageQueue::Clock::time_point deadline) {
+  tracing::ScopedEvent trace_event{"PacketPump::RetryBuffering"};
+  auto& worker = worker_state_;
+  worker.wake_up_time = WorkerMessageQueue::Clock::time_point::max();
+  if (messages_.GetFlushIndex() != worker.buffer_target_flush_index)
+    return;
+  StartAppending(worker.buffer_target);
+  if (ContinueAppending(deadline))
+    FinishAppending();
+}
+
+PacketPump::WorkerMessageQueue::Clock::time_point PacketPump::GetWakeUpTime()
+    const {
+  auto wake_up_time = WorkerMessageQueue::Clock::time_point::max();
+  for (size_t track_idx = 0; track_idx < tracks_.size(); ++track_idx) {
+    const auto& packet_source = *tracks_[track_idx].packet_source;
+    const auto& state = track_states_[track_idx];
+    // Packets that are available, but weren't appended, were held back by
+    // a buffering limit: appending resumes as playback progresses.
+    if (state.ended || packet_source.IsComplete() ||
+        state.packet_idx < packet_source.GetPacketCount() ||
+        state.buffered_until >= worker_state_.buffer_target_time) {
+      continue;
+    }
+    wake_up_time =
+        std::min(wake_up_time, packet_source.GetNextPacketTime());
+  }
+  return wake_up_time;
+}
+
+void PacketPump::RecordQueueWait(const WorkerMessageQueue::Message& message) {
+  queue_wait_us_[static_cast<size_t>(message.type)].Record(
+      ToMicroseconds(WorkerMessageQueue::Clock::now() - message.push_time));
+}
+
+void PacketPump::StagePackets(Seconds time, SessionId session_id) {
+  // Packets of a track that can't be fed right now (its source didn't produce
+  // them yet) limit how far the remaining tracks are buffered.
+  auto limit = time;
+  for (size_t track_idx = 0; track_idx < tracks_.size(); ++track_idx) {
+    const auto& packet_source = *tracks_[track_idx].packet_source;
+    const auto& state = track_states_[track_idx];
+    if (state.ended || packet_source.IsComplete())
+      continue;
+    auto available_until = state.buffered_until;
+    const auto packet_count = packet_source.GetPacketCount();
+    if (packet_count > state.packet_idx) {
+      auto last_packet = packet_source.GetPacketInfo(packet_count - 1);
+      available_until =
+          std::max(available_until, last_packet.pts + last_packet.duration);
+    }
+    limit = std::min(limit, available_until + buffer_policy_.max_track_skew);
+  }
+
+  // Descriptors are filled and stamped with the session id in place, so none
+  // of them is copied on its way to the track.
+  append_batch_.clear();
+  for (size_t track_idx = 0; track_idx < tracks_.size(); ++track_idx) {
+    const auto& packet_source = *tracks_[track_idx].packet_source;
+    auto& state = track_states_[track_idx];
+    const auto packet_count = packet_source.GetPacketCount();
+    state.staged_begin = append_batch_.size();
+    for (auto idx = state.packet_idx; idx < packet_count; ++idx) {
+      append_batch_.emplace_back();
+      auto& staged = append_batch_.back();
+      packet_source.FillPacket(idx, &staged.packet);
+      if (staged.packet.pts >= limit) {
+        append_batch_.pop_back();
+        break;
+      }
+      staged.track_idx = track_idx;
+      staged.packet.session_id = session_id;
+    }
+    state.staged_end = append_batch_.size();
+  }
+}
+
+Seconds PacketPump::GetBufferedUntil() const {
+  // Nothing more to buffer for ended tracks: approaching their end is not an
+  // underrun.
+  auto buffered_until = Seconds{std::numeric_limits<Seconds::rep>::infinity()};
+  for (const auto& state : track_states_) {
+    if (!state.ended)
+      buffered_until = std::min(buffered_until, state.buffered_until);
+  }
+  return buffered_until;
+}
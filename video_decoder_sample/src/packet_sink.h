@@ -0,0 +1,48 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef WASM_PLAYER_SAMPLE_PACKET_SINK_H
+#define WASM_PLAYER_SAMPLE_PACKET_SINK_H
+
+#include <samsung/wasm/elementary_media_packet.h>
+
+// Destination of packets buffered by PacketPump.
+//
+// In the module a sink forwards packets to an ElementaryMediaTrack (see
+// TrackDataPump). Host builds can plug in a sink that doesn't depend on
+// Tizen WASM Player at all, e.g. SimulatedDecoderSink, so that buffering can
+// be run and measured off-device.
+//
+// Methods are called on the pump's worker thread.
+class PacketSink {
+ public:
+  using ElementaryMediaPacket = samsung::wasm::ElementaryMediaPacket;
+  using SessionId = samsung::wasm::SessionId;
+
+  virtual ~PacketSink() = default;
+
+  virtual void AppendPacket(const ElementaryMediaPacket& packet) = 0;
+
+  // All packets of the track were appended.
+  virtual void AppendEndOfTrack(SessionId session_id) = 0;
+};  // class PacketSink
+
+#endif  // WASM_PLAYER_SAMPLE_PACKET_SINK_H
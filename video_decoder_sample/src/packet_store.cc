@@ -0,0 +1,197 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "packet_store.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+using ElementaryMediaPacket = samsung::wasm::ElementaryMediaPacket;
+using ElementaryVideoTrackConfig = samsung::wasm::ElementaryVideoTrackConfig;
+using Seconds = samsung::wasm::Seconds;
+
+namespace {
+
+bool IsInRange(uint64_t offset, uint64_t size, uint64_t limit) {
+  return offset <= limit && size <= limit - offset;
+}
+
+// Reads exactly size bytes at the given offset. Returns false on error or at
+// the end of file.
+bool ReadAt(int fd, uint64_t offset, void* data, size_t size) {
+  auto* bytes = static_cast<uint8_t*>(data);
+  while (size > 0) {
+    const auto read_size = pread(fd, bytes, size, static_cast<off_t>(offset));
+    if (read_size < 0 && errno == EINTR)
+      continue;
+    if (read_size <= 0)
+      return false;
+    bytes += read_size;
+    offset += read_size;
+    size -= read_size;
+  }
+  return true;
+}
+
+}  // namespace
+
+// static
+std::unique_ptr<PacketStore> PacketStore::Open(const std::string& path) {
+  auto fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return nullptr;
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    std::cout << "Invalid packet store: " << path << std::endl;
+    close(fd);
+    return nullptr;
+  }
+
+  // The store owns the descriptor from now on.
+  std::unique_ptr<PacketStore> store{
+      new PacketStore(fd, static_cast<uint64_t>(file_stat.st_size))};
+  if (!store->Initialize()) {
+    std::cout << "Invalid packet store: " << path << std::endl;
+    return nullptr;
+  }
+  return store;
+}
+
+PacketStore::PacketStore(int fd, uint64_t file_size)
+    : fd_(fd), file_size_(file_size) {}
+
+PacketStore::~PacketStore() {
+  close(fd_);
+}
+
+Seconds PacketStore::GetDuration() const {
+  return Seconds{header_.duration};
+}
+
+const ElementaryVideoTrackConfig& PacketStore::GetVideoTrackConfig() const {
+  return video_track_config_;
+}
+
+size_t PacketStore::GetPacketCount() const {
+  return packets_.size();
+}
+
+void PacketStore::FillPacket(size_t index,
+                             ElementaryMediaPacket* packet) const {
+  assert(index >= first_payload_idx_);
+  FillPacketInfo(index, packet);
+  while (first_payload_idx_ + payloads_.size() <= index)
+    payloads_.emplace_back();
+  auto& payload = payloads_[index - first_payload_idx_];
+  const auto& entry = packets_[index];
+  if (!payload.is_loaded) {
+    payload.data.resize(entry.payload_size);
+    payload.is_loaded =
+        ReadAt(fd_, header_.payload_offset + entry.payload_offset,
+               payload.data.data(), payload.data.size());
+    if (!payload.is_loaded) {
+      // Offsets were checked on open, so the file must have changed since or
+      // the read failed. The packet is zeroed rather than left with a part of
+      // the payload, and read again when it's filled next time.
+      std::fill(payload.data.begin(), payload.data.end(), 0);
+      std::cout << "Cannot read packet " << index << " of a packet store."
+                << std::endl;
+    }
+  }
+  packet->data = payload.data.data();
+}
+
+void PacketStore::FillPacketInfo(size_t index,
+                                 ElementaryMediaPacket* packet) const {
+  const auto& entry = packets_[index];
+  *packet = {};
+  packet->pts = Seconds{entry.pts};
+  packet->dts = Seconds{entry.dts};
+  packet->duration = Seconds{entry.duration};
+  packet->is_key_frame = (entry.flags & packet_store::kKeyFrameFlag);
+  packet->size = entry.payload_size;
+  packet->width = header_.width;
+  packet->height = header_.height;
+  packet->framerate_num = header_.framerate_num;
+  packet->framerate_den = header_.framerate_den;
+}
+
+void PacketStore::DiscardPayloadsBefore(size_t index) {
+  if (index < first_payload_idx_) {
+    // Seeking back: payloads are read again as packets are filled.
+    payloads_.clear();
+    first_payload_idx_ = index;
+    return;
+  }
+  while (first_payload_idx_ < index && !payloads_.empty()) {
+    payloads_.pop_front();
+    ++first_payload_idx_;
+  }
+  first_payload_idx_ = index;
+}
+
+bool PacketStore::Initialize() {
+  if (!ReadAt(fd_, 0, &header_, sizeof(header_)) ||
+      std::memcmp(header_.magic, packet_store::kMagic,
+                  sizeof(packet_store::kMagic)) != 0 ||
+      header_.version != packet_store::kVersion ||
+      std::memchr(header_.mime_type, '\0', packet_store::kMaxMimeTypeLength) ==
+          nullptr) {
+    return false;
+  }
+
+  const auto table_size =
+      uint64_t{header_.packet_count} * sizeof(packet_store::PacketEntry);
+  if (!IsInRange(header_.packet_table_offset, table_size, file_size_) ||
+      !IsInRange(header_.extradata_offset, header_.extradata_size,
+                 file_size_) ||
+      !IsInRange(header_.payload_offset, header_.payload_size, file_size_)) {
+    return false;
+  }
+
+  packets_.resize(header_.packet_count);
+  if (!ReadAt(fd_, header_.packet_table_offset, packets_.data(), table_size))
+    return false;
+  for (const auto& entry : packets_) {
+    if (!IsInRange(entry.payload_offset, entry.payload_size,
+                   header_.payload_size))
+      return false;
+  }
+
+  video_track_config_.mimeType = header_.mime_type;
+  video_track_config_.extradata.resize(header_.extradata_size);
+  if (!ReadAt(fd_, header_.extradata_offset,
+              video_track_config_.extradata.data(), header_.extradata_size))
+    return false;
+  video_track_config_.width = header_.width;
+  video_track_config_.height = header_.height;
+  video_track_config_.framerate_num = header_.framerate_num;
+  video_track_config_.framerate_den = header_.framerate_den;
+  return true;
+}
@@ -0,0 +1,145 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef WASM_PLAYER_SAMPLE_PACKET_STORE_H
+#define WASM_PLAYER_SAMPLE_PACKET_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "packet_source.h"
+
+// On-disk packet store format.
+//
+// Lets an application ship long content without linking it into the module.
+// Only the header and the packet table are read upfront, payloads are read as
+// they're needed. A file consists of:
+//  - FileHeader,
+//  - a table of FileHeader::packet_count PacketEntry structures,
+//  - video track extradata,
+//  - a payload blob with packet data.
+//
+// All values are little-endian and all offsets are relative to the beginning
+// of the file. Use tools/make_packet_store.cc to convert sample_data into this
+// format.
+namespace packet_store {
+
+constexpr char kMagic[4] = {'E', 'M', 'P', 'S'};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kMaxMimeTypeLength = 128;
+
+constexpr uint32_t kKeyFrameFlag = 1 << 0;
+
+struct FileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t packet_count;
+  uint32_t extradata_size;
+  double duration;
+  // NUL-terminated.
+  char mime_type[kMaxMimeTypeLength];
+  uint32_t width;
+  uint32_t height;
+  uint32_t framerate_num;
+  uint32_t framerate_den;
+  uint64_t packet_table_offset;
+  uint64_t extradata_offset;
+  uint64_t payload_offset;
+  uint64_t payload_size;
+};  // struct FileHeader
+
+struct PacketEntry {
+  double pts;
+  double dts;
+  double duration;
+  // Relative to FileHeader::payload_offset.
+  uint64_t payload_offset;
+  uint32_t payload_size;
+  uint32_t flags;
+};  // struct PacketEntry
+
+static_assert(sizeof(FileHeader) == 200, "FileHeader layout changed");
+static_assert(sizeof(PacketEntry) == 40, "PacketEntry layout changed");
+
+}  // namespace packet_store
+
+// Reads packets from a packet store file.
+//
+// Payloads are read with pread() when packets are filled and kept only until
+// the pump discards them (see PacketSource::DiscardPayloadsBefore()), so
+// memory used by the store is bounded by the buffered packets rather than the
+// content length. Note that a file preloaded with Emscripten's --preload-file
+// lives in MEMFS, i.e. in memory, anyway: the store then only saves copying it
+// again. Only a file system that reads from storage on demand (e.g. NODEFS or
+// a lazily fetched file) keeps the unplayed part of the content out of memory.
+class PacketStore : public PacketSource {
+ public:
+  // Returns nullptr if the file can't be read or is malformed.
+  static std::unique_ptr<PacketStore> Open(const std::string& path);
+
+  ~PacketStore() override;
+
+  PacketStore(const PacketStore&) = delete;
+  PacketStore& operator=(const PacketStore&) = delete;
+
+  Seconds GetDuration() const override;
+  const ElementaryVideoTrackConfig& GetVideoTrackConfig() const override;
+  size_t GetPacketCount() const override;
+  void FillPacket(size_t index, ElementaryMediaPacket* packet) const override;
+  void FillPacketInfo(size_t index,
+                      ElementaryMediaPacket* packet) const override;
+  void DiscardPayloadsBefore(size_t index) override;
+
+ private:
+  PacketStore(int fd, uint64_t file_size);
+
+  // Reads the header, the packet table and the track config, checking all
+  // offsets stored in the file are within it. Returns false if the file is
+  // malformed.
+  bool Initialize();
+
+  // Payload of a packet, zeroed if reading it failed.
+  struct Payload {
+    std::vector<uint8_t> data;
+    // False until data was read in full, so that a failed read is retried
+    // the next time the packet is filled.
+    bool is_loaded{false};
+  };  // struct Payload
+
+  int fd_;
+  uint64_t file_size_;
+
+  packet_store::FileHeader header_{};
+  std::vector<packet_store::PacketEntry> packets_;
+
+  // Payloads of packets from first_payload_idx_ on, empty until read. Filled
+  // by the worker in FillPacket(), which is const for callers.
+  mutable std::deque<Payload> payloads_;
+  size_t first_payload_idx_{0};
+
+  ElementaryVideoTrackConfig video_track_config_;
+};  // class PacketStore
+
+#endif  // WASM_PLAYER_SAMPLE_PACKET_STORE_H
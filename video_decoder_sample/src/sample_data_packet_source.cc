@@ -0,0 +1,46 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "packet_source.h"
+
+#include "sample_data.h"
+
+using ElementaryMediaPacket = samsung::wasm::ElementaryMediaPacket;
+using ElementaryVideoTrackConfig = samsung::wasm::ElementaryVideoTrackConfig;
+using Seconds = samsung::wasm::Seconds;
+
+Seconds SampleDataPacketSource::GetDuration() const {
+  return sample_data::kStreamDuration;
+}
+
+const ElementaryVideoTrackConfig& SampleDataPacketSource::GetVideoTrackConfig()
+    const {
+  return sample_data::kVideoTrackConfig;
+}
+
+size_t SampleDataPacketSource::GetPacketCount() const {
+  return sample_data::kVideoPackets.size();
+}
+
+void SampleDataPacketSource::FillPacket(size_t index,
+                                        ElementaryMediaPacket* packet) const {
+  *packet = sample_data::kVideoPackets[index];
+}
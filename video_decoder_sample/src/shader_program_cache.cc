@@ -0,0 +1,139 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "shader_program_cache.h"
+
+#include <iostream>
+
+namespace {
+
+// Returns 0 and logs the reason if the shader doesn't compile.
+GLuint CompileShader(GLenum type, const std::string& source) {
+  GLuint shader = glCreateShader(type);
+  const char* source_data = source.c_str();
+  const auto source_size = static_cast<GLint>(source.size());
+  glShaderSource(shader, 1, &source_data, &source_size);
+  glCompileShader(shader);
+  GLint compiled = GL_FALSE;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+  if (compiled)
+    return shader;
+  char log[512] = {};
+  glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+  std::cout << "Cannot compile shader: " << log << std::endl;
+  glDeleteShader(shader);
+  return 0;
+}
+
+}  // namespace
+
+// static
+ShaderProgramCache* ShaderProgramCache::GetForContext(ContextId context) {
+  auto& cache = GetContextCaches()[context];
+  if (!cache)
+    cache = std::make_unique<ShaderProgramCache>();
+  return cache.get();
+}
+
+// static
+void ShaderProgramCache::ReleaseContext(ContextId context) {
+  GetContextCaches().erase(context);
+}
+
+ShaderProgramCache::~ShaderProgramCache() {
+  for (const auto& entry : programs_)
+    glDeleteProgram(entry.second);
+}
+
+GLuint ShaderProgramCache::GetProgram(
+    const std::string& vertex_source,
+    const std::string& fragment_source,
+    const std::vector<std::string>& attributes,
+    bool* cache_hit) {
+  // Sources and attribute names can't contain NULs, so they separate parts
+  // of the key.
+  auto key = vertex_source;
+  key += '\0';
+  key += fragment_source;
+  for (const auto& attribute : attributes) {
+    key += '\0';
+    key += attribute;
+  }
+
+  auto program_it = programs_.find(key);
+  if (cache_hit)
+    *cache_hit = (program_it != programs_.end());
+  if (program_it != programs_.end())
+    return program_it->second;
+
+  const auto program =
+      BuildProgram(vertex_source, fragment_source, attributes);
+  if (program)
+    programs_.emplace(std::move(key), program);
+  return program;
+}
+
+size_t ShaderProgramCache::GetProgramCount() const {
+  return programs_.size();
+}
+
+// static
+std::map<ShaderProgramCache::ContextId, std::unique_ptr<ShaderProgramCache>>&
+ShaderProgramCache::GetContextCaches() {
+  // Leaked, so that programs aren't deleted at exit when no context is
+  // current.
+  static auto* caches =
+      new std::map<ContextId, std::unique_ptr<ShaderProgramCache>>();
+  return *caches;
+}
+
+// static
+GLuint ShaderProgramCache::BuildProgram(
+    const std::string& vertex_source,
+    const std::string& fragment_source,
+    const std::vector<std::string>& attributes) {
+  GLuint vertex_shader = CompileShader(GL_VERTEX_SHADER, vertex_source);
+  GLuint fragment_shader = CompileShader(GL_FRAGMENT_SHADER, fragment_source);
+  if (!vertex_shader || !fragment_shader) {
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+    return 0;
+  }
+
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vertex_shader);
+  glAttachShader(program, fragment_shader);
+  for (GLuint location = 0; location < attributes.size(); ++location)
+    glBindAttribLocation(program, location, attributes[location].c_str());
+  glLinkProgram(program);
+  // Shaders are deleted along with the program.
+  glDeleteShader(vertex_shader);
+  glDeleteShader(fragment_shader);
+  GLint linked = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if (linked)
+    return program;
+  char log[512] = {};
+  glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+  std::cout << "Cannot link shader program: " << log << std::endl;
+  glDeleteProgram(program);
+  return 0;
+}
@@ -0,0 +1,83 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef VIDEO_DECODER_SAMPLE_SHADER_PROGRAM_CACHE_H
+#define VIDEO_DECODER_SAMPLE_SHADER_PROGRAM_CACHE_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <GLES2/gl2.h>
+
+// Linked shader programs of a GL context, keyed by shader sources.
+//
+// Compiling and linking shaders is one of the slowest steps of setting up
+// rendering, so renderers sharing a context (e.g. a player created again for
+// the next content) reuse a program built once instead of building it again.
+// Programs are owned by the cache and live as long as it does.
+//
+// The cache has no dependencies on Tizen WASM Player, so that it can be used
+// with a software GL on the host (see tools/gl_render_benchmark.cc).
+class ShaderProgramCache {
+ public:
+  // Identifies a GL context, e.g. SDL_GLContext or EGLContext.
+  using ContextId = const void*;
+
+  // Returns the cache of the given context, creating it on first use.
+  static ShaderProgramCache* GetForContext(ContextId context);
+
+  // Forgets the cache of a context, e.g. when it's destroyed. Must be called
+  // with the context current, so that its programs are deleted.
+  static void ReleaseContext(ContextId context);
+
+  ShaderProgramCache() = default;
+  ~ShaderProgramCache();
+
+  ShaderProgramCache(const ShaderProgramCache&) = delete;
+  ShaderProgramCache& operator=(const ShaderProgramCache&) = delete;
+
+  // Returns a program linked from the given shaders, building it if it's not
+  // cached. attributes are bound to locations in their order (0, 1, ...)
+  // before linking. Returns 0 and logs the reason if the shaders don't compile
+  // or link; failures are not cached. *cache_hit (if given) tells whether the
+  // program was cached. Must be called with the context current.
+  GLuint GetProgram(const std::string& vertex_source,
+                    const std::string& fragment_source,
+                    const std::vector<std::string>& attributes = {},
+                    bool* cache_hit = nullptr);
+
+  size_t GetProgramCount() const;
+
+ private:
+  static std::map<ContextId, std::unique_ptr<ShaderProgramCache>>&
+  GetContextCaches();
+
+  static GLuint BuildProgram(const std::string& vertex_source,
+                             const std::string& fragment_source,
+                             const std::vector<std::string>& attributes);
+
+  std::unordered_map<std::string, GLuint> programs_;
+};  // class ShaderProgramCache
+
+#endif  // VIDEO_DECODER_SAMPLE_SHADER_PROGRAM_CACHE_H
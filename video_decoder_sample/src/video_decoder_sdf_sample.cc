@@ -21,6 +21,7 @@
 
 #include "video_decoder_sdf_sample.h"
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 
@@ -28,7 +29,8 @@
 #include <emscripten/emscripten.h>
 #include <emscripten/html5.h>
 
-#include "sample_data.h"
+#include "shader_program_cache.h"
+#include "tracing.h"
 
 #define assertNoGLError() assert(!glGetError());
 
@@ -60,48 +62,245 @@ const char kFragmentShaderExternal[] =
     "    gl_FragColor = texture2D(s_texture, v_texCoord); \n"
     "}                                                    \n";
 
-void CreateShader(GLuint program, GLenum type, const char* source, int size) {
-  GLuint shader = glCreateShader(type);
-  glShaderSource(shader, 1, &source, &size);
-  glCompileShader(shader);
-  glAttachShader(program, shader);
-  glDeleteShader(shader);
+// Attributes are bound to these locations when the program is linked.
+enum AttributeLocation : GLuint {
+  kPositionLocation = 0,
+  kTexCoordLocation = 1,
+};  // enum AttributeLocation
+
+// Canvas window and its GL context, shared by all pumps.
+struct SharedGLWindow {
+  SDL_Window* window{nullptr};
+  SDL_GLContext gl_context{nullptr};
+  // GL state belongs to the context, so all pumps must track it with the same
+  // cache: a cache of each pump would skip binding its program or buffer
+  // after another pump bound its own.
+  GLStateCache gl_state;
+};  // struct SharedGLWindow
+
+SharedGLWindow& GetSharedGLWindow() {
+  static SharedGLWindow shared_gl_window;
+  return shared_gl_window;
 }
 
-int CAPIOnDrawTextureCompleted(double /* time */, void* thiz) {
+int CAPIOnAnimationFrame(double /* time */, void* thiz) {
   if (thiz)
-    static_cast<VideoDecoderTrackDataPump*>(thiz)->OnDrawCompleted();
+    static_cast<VideoDecoderTrackDataPump*>(thiz)->OnAnimationFrame();
 
   return 0;
 }
 
+// Frame duration of a track, assuming 30 FPS if the config doesn't tell.
+samsung::wasm::Seconds GetFrameDuration(const PacketSource& packet_source) {
+  const auto& config = packet_source.GetVideoTrackConfig();
+  if (config.framerate_num == 0 || config.framerate_den == 0)
+    return samsung::wasm::Seconds{1. / 30.};
+  return samsung::wasm::Seconds{static_cast<double>(config.framerate_den) /
+                                config.framerate_num};
+}
+
+uint64_t ToMicroseconds(std::chrono::steady_clock::duration duration) {
+  return std::max<std::chrono::microseconds::rep>(
+      0, std::chrono::duration_cast<std::chrono::microseconds>(duration)
+             .count());
+}
+
+uint64_t ToMicroseconds(samsung::wasm::Seconds duration) {
+  return ToMicroseconds(
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          duration));
+}
+
 }  // namespace
 
+// Definitions of constants that are ODR-used (e.g. passed to std::max()).
+constexpr size_t VideoDecoderTrackDataPump::kDefaultTextureCount;
+
 VideoDecoderTrackDataPump::VideoDecoderTrackDataPump(
-    ElementaryMediaTrack video_track)
-    : TrackDataPump(std::move(video_track)) {
+    ElementaryMediaTrack video_track,
+    std::shared_ptr<PacketSource> packet_source,
+    BufferPolicy buffer_policy,
+    size_t texture_count)
+    : TrackDataPump(std::move(video_track), packet_source, buffer_policy),
+      texture_slots_(std::max<size_t>(texture_count, 1)),
+      frame_duration_(GetFrameDuration(*packet_source)),
+      gl_state_(&GetSharedGLWindow().gl_state) {}
+
+VideoDecoderTrackDataPump::~VideoDecoderTrackDataPump() {
+  if (animation_frame_id_)
+    emscripten_cancel_animation_frame(animation_frame_id_);
+  if (!graphics_initialized_)
+    return;
+  // The context outlives pumps, so objects of this one are deleted explicitly.
+  SDL_GL_MakeCurrent(window_, gl_context_);
+  for (auto& slot : texture_slots_) {
+    if (slot.texture)
+      glDeleteTextures(1, &slot.texture);
+  }
+  if (vertex_buffer_)
+    glDeleteBuffers(1, &vertex_buffer_);
+  // Deleted objects are unbound and their names can be reused by the next
+  // pump, so the cache of the context must not assume they're still bound.
+  gl_state_->Invalidate();
+}
+
+void VideoDecoderTrackDataPump::InitializeGraphics() {
+  tracing::ScopedEvent trace_event{
+      "VideoDecoderTrackDataPump::InitializeGraphics"};
+  if (graphics_initialized_)
+    return;
+  graphics_initialized_ = true;
+
+  auto step_start = Clock::now();
+  auto end_step = [&step_start](Seconds* duration) {
+    const auto now = Clock::now();
+    *duration = std::chrono::duration_cast<Seconds>(now - step_start);
+    step_start = now;
+  };
   InitializeGL();
+  end_step(&graphics_init_times_.context);
   CreateGLObjects();
+  end_step(&graphics_init_times_.gl_objects);
   CreateProgram();
-
-  video_track_.RegisterCurrentGraphicsContext();
+  end_step(&graphics_init_times_.program);
+  GetVideoTrack().RegisterCurrentGraphicsContext();
+  end_step(&graphics_init_times_.register_context);
+
+  std::cout << "Graphics initialized: context "
+            << graphics_init_times_.context.count() << "s, GL objects "
+            << graphics_init_times_.gl_objects.count() << "s, program "
+            << graphics_init_times_.program.count() << "s"
+            << (graphics_init_times_.program_cached ? " (cached)" : "")
+            << ", context registration "
+            << graphics_init_times_.register_context.count() << "s."
+            << std::endl;
 }
 
-void VideoDecoderTrackDataPump::OnDrawCompleted() {
-  video_track_.RecycleTexture(texture_);
-  RequestNewVideoTexture();
+VideoDecoderTrackDataPump::GraphicsInitTimes
+VideoDecoderTrackDataPump::GetGraphicsInitTimes() const {
+  return graphics_init_times_;
 }
 
 void VideoDecoderTrackDataPump::RequestNewVideoTexture() {
-  video_track_.FillTextureWithNextFrame(
-      texture_, [this](samsung::wasm::OperationResult result) {
-        if (result != samsung::wasm::OperationResult::kSuccess) {
-          std::cout << "Filling texture with next frame failed" << std::endl;
-          return;
-        }
+  tracing::ScopedEvent trace_event{
+      "VideoDecoderTrackDataPump::RequestNewVideoTexture"};
+  // In case the player didn't initialize graphics earlier.
+  InitializeGraphics();
+  FillFreeTextures();
+  if (!animation_frame_id_) {
+    animation_frame_id_ =
+        emscripten_request_animation_frame(&CAPIOnAnimationFrame, this);
+  }
+}
 
-        Draw();
-      });
+void VideoDecoderTrackDataPump::FillFreeTextures() {
+  for (size_t slot_idx = 0; slot_idx < texture_slots_.size(); ++slot_idx) {
+    auto& slot = texture_slots_[slot_idx];
+    if (slot.state != TextureSlot::State::kFree)
+      continue;
+    slot.state = TextureSlot::State::kFilling;
+    slot.fill_request_time = Clock::now();
+    GetVideoTrack().FillTextureWithNextFrame(
+        slot.texture,
+        [this, slot_idx](samsung::wasm::OperationResult result) {
+          OnTextureFilled(slot_idx, result);
+        });
+  }
+}
+
+void VideoDecoderTrackDataPump::OnTextureFilled(
+    size_t slot_idx,
+    samsung::wasm::OperationResult result) {
+  auto& slot = texture_slots_[slot_idx];
+  if (result != samsung::wasm::OperationResult::kSuccess) {
+    std::cout << "Filling texture with next frame failed" << std::endl;
+    // Filling is retried on the next animation frame.
+    slot.state = TextureSlot::State::kFree;
+    return;
+  }
+  slot.state = TextureSlot::State::kReady;
+  slot.ready_time = Clock::now();
+  slot.pts = next_frame_pts_;
+  next_frame_pts_ += frame_duration_;
+  fill_latency_us_.Record(
+      ToMicroseconds(slot.ready_time - slot.fill_request_time));
+  frame_scheduler_.QueueFrame(static_cast<uint32_t>(slot_idx), slot.pts);
+}
+
+void VideoDecoderTrackDataPump::OnMediaTime(Seconds media_time) {
+  frame_scheduler_.OnMediaTime(media_time, Clock::now());
+}
+
+void VideoDecoderTrackDataPump::OnSeek(Seconds new_time) {
+  TrackDataPump::OnSeek(new_time);
+  frame_scheduler_.Reset();
+  next_frame_pts_ = new_time;
+  for (auto& slot : texture_slots_) {
+    if (slot.state == TextureSlot::State::kReady)
+      RecycleTexture(&slot);
+  }
+}
+
+void VideoDecoderTrackDataPump::OnAnimationFrame() {
+  tracing::ScopedEvent trace_event{
+      "VideoDecoderTrackDataPump::OnAnimationFrame"};
+  animation_frame_id_ = 0;
+
+  const auto now = Clock::now();
+  uint32_t frame_id = 0;
+  dropped_frame_ids_.clear();
+  const bool present =
+      frame_scheduler_.OnVsync(now, &frame_id, &dropped_frame_ids_);
+  for (auto dropped_frame_id : dropped_frame_ids_)
+    RecycleTexture(&texture_slots_[dropped_frame_id]);
+  // Otherwise the previous frame stays on screen.
+  if (present) {
+    for (auto& slot : texture_slots_) {
+      if (slot.state == TextureSlot::State::kPresented)
+        RecycleTexture(&slot);
+    }
+    auto& slot = texture_slots_[frame_id];
+    Draw(slot.texture);
+    slot.state = TextureSlot::State::kPresented;
+    present_latency_us_.Record(ToMicroseconds(now - slot.ready_time));
+  }
+  gl_state_->EndFrame();
+
+  FillFreeTextures();
+  animation_frame_id_ =
+      emscripten_request_animation_frame(&CAPIOnAnimationFrame, this);
+}
+
+void VideoDecoderTrackDataPump::RecycleTexture(TextureSlot* slot) {
+  GetVideoTrack().RecycleTexture(slot->texture);
+  slot->state = TextureSlot::State::kFree;
+}
+
+std::string VideoDecoderTrackDataPump::GetRenderMetricsJson() const {
+  std::string json = "{\"fill_latency_us\":";
+  fill_latency_us_.AppendJson(&json);
+  json += ",\"present_latency_us\":";
+  present_latency_us_.AppendJson(&json);
+  const auto stats = frame_scheduler_.GetStats();
+  json += ",\"presented_frames\":" + std::to_string(stats.presented_count);
+  json += ",\"dropped_frames\":" + std::to_string(stats.dropped_count);
+  json += ",\"repeated_frames\":" + std::to_string(stats.repeated_count);
+  json += ",\"gl_calls_per_frame\":";
+  gl_state_->GetCallsPerFrame().AppendJson(&json);
+  json += ",\"gl_calls_skipped\":" +
+          std::to_string(gl_state_->GetStats().skipped_calls);
+  json += ",\"graphics_init_us\":{\"context\":" +
+          std::to_string(ToMicroseconds(graphics_init_times_.context));
+  json += ",\"gl_objects\":" +
+          std::to_string(ToMicroseconds(graphics_init_times_.gl_objects));
+  json += ",\"program\":" +
+          std::to_string(ToMicroseconds(graphics_init_times_.program));
+  json += ",\"register_context\":" +
+          std::to_string(ToMicroseconds(graphics_init_times_.register_context));
+  json += ",\"program_cached\":";
+  json += graphics_init_times_.program_cached ? "true}" : "false}";
+  json += '}';
+  return json;
 }
 
 void VideoDecoderTrackDataPump::CreateGLObjects() {
@@ -112,52 +311,53 @@ void VideoDecoderTrackDataPump::CreateGLObjects() {
       0,  1,  0,  0, 1, 1,  1, 0,  // Texture coordinates.
   };
 
-  GLuint buffer;
-  glGenBuffers(1, &buffer);
-  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+  glGenBuffers(1, &vertex_buffer_);
+  gl_state_->BindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
   glBufferData(GL_ARRAY_BUFFER, sizeof(kVertices), kVertices, GL_STATIC_DRAW);
   assertNoGLError();
 }
 
 void VideoDecoderTrackDataPump::CreateProgram() {
-  // Create shader program.
-  program_ = glCreateProgram();
-  CreateShader(program_, GL_VERTEX_SHADER, kVertexShader,
-               strlen(kVertexShader));
-  CreateShader(program_, GL_FRAGMENT_SHADER, kFragmentShaderExternal,
-               strlen(kFragmentShaderExternal));
-  glLinkProgram(program_);
-  glUseProgram(program_);
-  glUniform1i(glGetUniformLocation(program_, "s_texture"), 0);
+  // Get shader program, it's built only by the first pump.
+  program_ = ShaderProgramCache::GetForContext(gl_context_)
+                 ->GetProgram(kVertexShader, kFragmentShaderExternal,
+                              {"a_position", "a_texCoord"},
+                              &graphics_init_times_.program_cached);
+  if (!program_)
+    return;
+  // Through the cache, as other pumps draw with the same program.
+  gl_state_->UseProgram(program_);
+  gl_state_->Uniform1i(glGetUniformLocation(program_, "s_texture"), 0);
   assertNoGLError();
 
   texcoord_scale_location_ = glGetUniformLocation(program_, "v_scale");
 
   assertNoGLError();
+}
 
-  GLint pos_location = glGetAttribLocation(program_, "a_position");
-  GLint tc_location = glGetAttribLocation(program_, "a_texCoord");
-
-  glEnableVertexAttribArray(pos_location);
-  glVertexAttribPointer(pos_location, 2, GL_FLOAT, GL_FALSE, 0, 0);
-  glEnableVertexAttribArray(tc_location);
+void VideoDecoderTrackDataPump::SetVertexAttribPointers() {
+  glEnableVertexAttribArray(kPositionLocation);
+  glVertexAttribPointer(kPositionLocation, 2, GL_FLOAT, GL_FALSE, 0, 0);
+  glEnableVertexAttribArray(kTexCoordLocation);
   glVertexAttribPointer(
-      tc_location, 2, GL_FLOAT, GL_FALSE, 0,
+      kTexCoordLocation, 2, GL_FLOAT, GL_FALSE, 0,
       static_cast<float*>(0) + 8);  // Skip position coordinates.
-
-  glUseProgram(0);
 }
 
-void VideoDecoderTrackDataPump::Draw() {
-  glUseProgram(program_);
-  glUniform2f(texcoord_scale_location_, 1.0, 1.0);
-
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_EXTERNAL_OES, texture_);
-  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-  assertNoGLError();
-
-  emscripten_request_animation_frame(&CAPIOnDrawTextureCompleted, this);
+void VideoDecoderTrackDataPump::Draw(GLuint texture) {
+  tracing::ScopedEvent trace_event{"VideoDecoderTrackDataPump::Draw"};
+  if (!program_)
+    return;
+  gl_state_->UseProgram(program_);
+  gl_state_->Uniform2f(texcoord_scale_location_, 1.0, 1.0);
+  // Each pump has its own vertex buffer, and attribute pointers (which aren't
+  // tracked by the cache) are set with it whenever it's bound again.
+  if (gl_state_->BindBuffer(GL_ARRAY_BUFFER, vertex_buffer_))
+    SetVertexAttribPointers();
+
+  gl_state_->ActiveTexture(GL_TEXTURE0);
+  gl_state_->BindTexture(GL_TEXTURE_EXTERNAL_OES, texture);
+  gl_state_->DrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 }
 
 void VideoDecoderTrackDataPump::InitializeSDL() {
@@ -172,25 +372,32 @@ void VideoDecoderTrackDataPump::InitializeSDL() {
 }
 
 void VideoDecoderTrackDataPump::InitializeGL() {
-  InitializeSDL();
   int width;
   int height;
   emscripten_get_canvas_element_size("#canvas", &width, &height);
-  window_ = SDL_CreateWindow("VideoTexture", SDL_WINDOWPOS_CENTERED,
-                             SDL_WINDOWPOS_CENTERED, width, height,
-                             SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN);
-  gl_context_ = SDL_GL_CreateContext(window_);
+  auto& shared_gl_window = GetSharedGLWindow();
+  if (!shared_gl_window.gl_context) {
+    InitializeSDL();
+    shared_gl_window.window = SDL_CreateWindow(
+        "VideoTexture", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, width,
+        height, SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN);
+    shared_gl_window.gl_context =
+        SDL_GL_CreateContext(shared_gl_window.window);
+  }
+  window_ = shared_gl_window.window;
+  gl_context_ = shared_gl_window.gl_context;
   SDL_GL_MakeCurrent(window_, gl_context_);
-  glGenTextures(1, &texture_);
+  for (auto& slot : texture_slots_)
+    glGenTextures(1, &slot.texture);
   glViewport(0, 0, width, height);
   glClearColor(1, 0, 0, 0);
   glClear(GL_COLOR_BUFFER_BIT);
 }
 
-void VideoDecoderSamplePlayer::OnCanPlay() {
-  if (!media_element_->IsPaused())
-    return;
+VideoDecoderSamplePlayer::VideoDecoderSamplePlayer(size_t texture_count)
+    : texture_count_(texture_count) {}
 
+void VideoDecoderSamplePlayer::StartPlayback() {
   media_element_->Play([this](samsung::wasm::OperationResult result) {
     if (result != samsung::wasm::OperationResult::kSuccess) {
       std::cout << "Cannot play." << std::endl;
@@ -206,7 +413,29 @@ void VideoDecoderSamplePlayer::OnCanPlay() {
   });
 }
 
+void VideoDecoderSamplePlayer::OnSourceClosed() {
+  SamplePlayer::OnSourceClosed();
+  // The source was requested to open and opens asynchronously. See
+  // StartPlayback() for the cast.
+  if (track_data_pump_) {
+    static_cast<VideoDecoderTrackDataPump*>(track_data_pump_.get())
+        ->InitializeGraphics();
+  }
+}
+
+void VideoDecoderSamplePlayer::OnPlaybackPositionChanged(Seconds new_time) {
+  SamplePlayer::OnPlaybackPositionChanged(new_time);
+  // See StartPlayback().
+  if (track_data_pump_) {
+    static_cast<VideoDecoderTrackDataPump*>(track_data_pump_.get())
+        ->OnMediaTime(new_time);
+  }
+}
+
 std::unique_ptr<TrackDataPump> VideoDecoderSamplePlayer::CreateTrackDataPump(
-    ElementaryMediaTrack&& video_track) {
-  return std::make_unique<VideoDecoderTrackDataPump>(std::move(video_track));
+    ElementaryMediaTrack&& video_track,
+    std::shared_ptr<PacketSource> packet_source) {
+  return std::make_unique<VideoDecoderTrackDataPump>(
+      std::move(video_track), std::move(packet_source), GetBufferPolicy(),
+      texture_count_);
 }
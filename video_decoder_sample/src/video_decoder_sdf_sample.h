@@ -31,36 +31,163 @@
 
 #include "emss_sdf_sample.h"
 
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
 #include <GLES2/gl2.h>
 #include <SDL2/SDL.h>
 
+#include "frame_scheduler.h"
+#include "gl_state_cache.h"
+#include "histogram.h"
+
 // This class is responsible for sending elementary media data to Elementary
 // Media Stream Source via ElementaryMediaTrack object.
+//
+// Decoded frames are rendered through a ring of textures: several
+// FillTextureWithNextFrame() requests are kept in flight, so that decoding
+// the next frames overlaps with presenting the current one. Animation frames
+// are paced with a FrameScheduler: a filled texture is drawn at the vsync
+// closest to its pts and textures that missed their vsync are recycled without
+// being shown.
+//
+// FillTextureWithNextFrame() doesn't tell pts of a frame, so it's estimated:
+// frames follow each other at the track's framerate starting from a playback
+// position (0s or a seek target).
+//
+// Frames are drawn through a GLStateCache, so that state which doesn't change
+// between frames (the program, texture unit and uniforms) isn't set again and
+// glGetError() isn't called on every frame. GL state belongs to the context,
+// so all pumps share one cache of it.
+//
+// Pumps share the canvas' GL context and get their shader program from its
+// ShaderProgramCache, so only the first pump builds the program. Graphics are
+// set up by InitializeGraphics() rather than on construction, so that
+// a player can request its source to open first.
 class VideoDecoderTrackDataPump : public TrackDataPump {
  public:
   using ElementaryMediaTrack = samsung::wasm::ElementaryMediaTrack;
   using Seconds = samsung::wasm::Seconds;
   using SessionId = samsung::wasm::SessionId;
 
-  explicit VideoDecoderTrackDataPump(ElementaryMediaTrack video_track);
+  // A texture being presented, a texture ready to be presented on the next
+  // animation frame and one being filled.
+  static constexpr size_t kDefaultTextureCount = 3;
+
+  // Durations of InitializeGraphics() steps, zero until it's called.
+  struct GraphicsInitTimes {
+    // Making the shared window and GL context current, creating them first
+    // if this is the first pump.
+    Seconds context;
+    // Creating textures and a vertex buffer.
+    Seconds gl_objects;
+    // Building the shader program or getting it from ShaderProgramCache.
+    Seconds program;
+    // ElementaryMediaTrack::RegisterCurrentGraphicsContext().
+    Seconds register_context;
+    // Whether the program was cached.
+    bool program_cached;
+  };  // struct GraphicsInitTimes
 
-  ~VideoDecoderTrackDataPump() override = default;
+  VideoDecoderTrackDataPump(ElementaryMediaTrack video_track,
+                            std::shared_ptr<PacketSource> packet_source,
+                            BufferPolicy buffer_policy,
+                            size_t texture_count = kDefaultTextureCount);
 
-  void OnDrawCompleted();
+  ~VideoDecoderTrackDataPump() override;
+
+  // Sets up GL and registers the context with the video track. Must be called
+  // before frames are requested; does nothing when called again.
+  void InitializeGraphics();
+
+  GraphicsInitTimes GetGraphicsInitTimes() const;
+
+  // Starts filling textures and presenting them on animation frames.
   void RequestNewVideoTexture();
 
+  void OnAnimationFrame();
+
+  // Playback position reported by the media element, which drives the media
+  // clock frames are paced with.
+  void OnMediaTime(Seconds media_time);
+
+  // Drops filled frames, as they precede the seek target.
+  void OnSeek(Seconds new_time) override;
+
+  // Returns rendering statistics as a JSON object:
+  //  - fill_latency_us: time from requesting a frame to its texture being
+  //    filled,
+  //  - present_latency_us: time from a texture being filled to it being
+  //    drawn,
+  //  - presented_frames: number of frames drawn,
+  //  - dropped_frames: number of frames filled, but never drawn, as they
+  //    missed their vsync,
+  //  - repeated_frames: number of animation frames that kept the previous
+  //    frame on screen,
+  //  - gl_calls_per_frame: GL calls issued on an animation frame,
+  //  - gl_calls_skipped: GL calls skipped as they wouldn't change GL state,
+  //    both counted by the cache shared by all pumps, i.e. they include calls
+  //    of other pumps since the previous animation frame,
+  //  - graphics_init_us: durations of InitializeGraphics() steps (see
+  //    GraphicsInitTimes).
+  // Must be called on the main thread.
+  std::string GetRenderMetricsJson() const;
+
  private:
+  using Clock = std::chrono::steady_clock;
+
+  struct TextureSlot {
+    enum class State { kFree, kFilling, kReady, kPresented };
+
+    GLuint texture{0};
+    State state{State::kFree};
+    // Estimated pts of the frame (see the class comment).
+    Seconds pts{0};
+    Clock::time_point fill_request_time;
+    Clock::time_point ready_time;
+  };  // struct TextureSlot
+
   void CreateGLObjects();
   void CreateProgram();
-  void Draw();
+  // Points vertex attributes to vertex_buffer_, which must be bound.
+  void SetVertexAttribPointers();
+  void Draw(GLuint texture);
   void InitializeSDL();
   void InitializeGL();
 
-  GLuint texture_{0};
+  // Requests free textures to be filled with the next frames.
+  void FillFreeTextures();
+  void OnTextureFilled(size_t slot_idx, samsung::wasm::OperationResult result);
+
+  // Returns a texture to the track, so that it can be filled again.
+  void RecycleTexture(TextureSlot* slot);
+
+  std::vector<TextureSlot> texture_slots_;
+  // Animation frame request pending or 0.
+  long animation_frame_id_{0};
+
+  FrameScheduler frame_scheduler_;
+  const Seconds frame_duration_;
+  Seconds next_frame_pts_{0};
+  // Scratch space for FrameScheduler::OnVsync().
+  std::vector<uint32_t> dropped_frame_ids_;
+
+  Histogram fill_latency_us_;
+  Histogram present_latency_us_;
+
+  // Shared by all pumps of the context.
+  GLStateCache* const gl_state_;
+  bool graphics_initialized_{false};
+  GraphicsInitTimes graphics_init_times_{};
+
   SDL_Window* window_{nullptr};
   SDL_GLContext gl_context_{nullptr};
+  // Owned by the context's ShaderProgramCache.
   GLuint program_{0};
-  GLuint texcoord_scale_location_{0};
+  GLint texcoord_scale_location_{-1};
+  GLuint vertex_buffer_{0};
 };  // class VideoDecoderTrackDataPump
 
 class VideoDecoderSamplePlayer : public SamplePlayer {
@@ -70,14 +197,28 @@ class VideoDecoderSamplePlayer : public SamplePlayer {
   using HTMLMediaElement = samsung::html::HTMLMediaElement;
   using Seconds = samsung::wasm::Seconds;
 
-  VideoDecoderSamplePlayer() = default;
+  // Decoded frames are rendered through a ring of texture_count textures (see
+  // VideoDecoderTrackDataPump).
+  explicit VideoDecoderSamplePlayer(
+      size_t texture_count = VideoDecoderTrackDataPump::kDefaultTextureCount);
 
-  // samsung::wasm::ElementaryMediaStreamSourceListener interface //
-  void OnCanPlay() override;
+  // Initializes graphics of the pump right after requesting the source to
+  // open, so that GL setup overlaps with opening the source.
+  void OnSourceClosed() override;
+
+  // Forwards playback position to the pump to pace frames.
+  void OnPlaybackPositionChanged(Seconds new_time) override;
+
+ protected:
+  // Starts requesting video textures once playback starts.
+  void StartPlayback() override;
 
  private:
   std::unique_ptr<TrackDataPump> CreateTrackDataPump(
-      ElementaryMediaTrack&& video_track) override;
+      ElementaryMediaTrack&& video_track,
+      std::shared_ptr<PacketSource> packet_source) override;
+
+  const size_t texture_count_;
 };  // class VideoDecoderSamplePlayer
 
 #endif  // VIDEO_DECODER_SAMPLE_VIDEO_DECODER_SDF_SAMPLE_H
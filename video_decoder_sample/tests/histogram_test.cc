@@ -0,0 +1,173 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//          *** Histogram Test ***
+//
+// Records known values into Histogram and checks its bucket counts (as
+// exported by AppendJson()), reported statistics and percentiles, including
+// values past the last bucket and the relative error of percentiles.
+//
+// Built and run by ctest, see CMakeLists.txt.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "histogram.h"
+
+namespace {
+
+// Returns the "buckets" array exported by AppendJson().
+std::string GetBucketsJson(const Histogram& histogram) {
+  std::string json;
+  histogram.AppendJson(&json);
+  const auto begin = json.find("\"buckets\":");
+  if (begin == std::string::npos)
+    return {};
+  return json.substr(begin + 10, json.size() - begin - 11);
+}
+
+bool Expect(const char* what, uint64_t value, uint64_t expected) {
+  if (value == expected)
+    return true;
+  std::cout << "FAILED, " << what << " is " << value << ", expected "
+            << expected << std::endl;
+  return false;
+}
+
+bool ExpectBuckets(const Histogram& histogram, const std::string& expected) {
+  const auto buckets = GetBucketsJson(histogram);
+  if (buckets == expected)
+    return true;
+  std::cout << "FAILED, buckets are " << buckets << ", expected " << expected
+            << std::endl;
+  return false;
+}
+
+bool TestEmpty() {
+  std::cout << "Empty: ";
+  Histogram histogram;
+  if (!Expect("count", histogram.GetCount(), 0) ||
+      !Expect("min", histogram.GetMin(), 0) ||
+      !Expect("max", histogram.GetMax(), 0) ||
+      !Expect("p50", histogram.GetPercentile(50.), 0) ||
+      !ExpectBuckets(histogram, "[]"))
+    return false;
+  std::cout << "passed" << std::endl;
+  return true;
+}
+
+bool TestBuckets() {
+  std::cout << "Buckets: ";
+  Histogram histogram;
+  // Values below 2^kSubBucketBits have a bucket each, above them buckets of
+  // [32, 64) are 2 wide and buckets of [64, 128) are 4 wide.
+  for (uint64_t value : {0, 5, 5, 31, 32, 33, 34, 64, 67, 68})
+    histogram.Record(value);
+  if (!ExpectBuckets(histogram,
+                     "[[0,1],[5,2],[31,1],[32,2],[34,1],[64,2],[68,1]]") ||
+      !Expect("count", histogram.GetCount(), 10) ||
+      !Expect("min", histogram.GetMin(), 0) ||
+      !Expect("max", histogram.GetMax(), 68) ||
+      !Expect("mean * 10", std::llround(histogram.GetMean() * 10), 339))
+    return false;
+  std::cout << "passed" << std::endl;
+  return true;
+}
+
+bool TestPercentiles() {
+  std::cout << "Percentiles: ";
+  Histogram histogram;
+  for (uint64_t value = 1; value <= 100; ++value)
+    histogram.Record(value);
+  // Upper bounds of buckets holding the ranked values, up to the maximum.
+  if (!Expect("p0", histogram.GetPercentile(0.), 1) ||
+      !Expect("p10", histogram.GetPercentile(10.), 10) ||
+      !Expect("p50", histogram.GetPercentile(50.), 51) ||
+      !Expect("p90", histogram.GetPercentile(90.), 91) ||
+      !Expect("p99", histogram.GetPercentile(99.), 99) ||
+      !Expect("p100", histogram.GetPercentile(100.), 100))
+    return false;
+
+  // Percentiles overestimate values by less than a bucket, i.e. by less than
+  // 1 / 2^(kSubBucketBits - 1) of their magnitude.
+  Histogram wide_histogram;
+  std::vector<uint64_t> values;
+  for (uint64_t value = 1; value < (uint64_t{1} << 39); value = value * 7 + 3)
+    values.push_back(value);
+  for (auto value : values)
+    wide_histogram.Record(value);
+  const double max_error = 1. / (1 << (Histogram::kSubBucketBits - 1));
+  for (size_t rank = 1; rank <= values.size(); ++rank) {
+    // Half a rank lower, so that rounding can't select the next value.
+    const double percentile = 100. * (rank - 0.5) / values.size();
+    const auto value = wide_histogram.GetPercentile(percentile);
+    const auto exact = values[rank - 1];
+    if (value < exact || value > exact + exact * max_error) {
+      std::cout << "FAILED, p" << percentile << " is " << value
+                << ", expected " << exact << std::endl;
+      return false;
+    }
+  }
+  std::cout << "passed" << std::endl;
+  return true;
+}
+
+bool TestOverflow() {
+  std::cout << "Overflow: ";
+  Histogram histogram;
+  constexpr uint64_t kMaxValue = uint64_t{1} << Histogram::kMaxValueBits;
+  histogram.Record(1);
+  histogram.Record(kMaxValue - 1);
+  histogram.Record(kMaxValue);
+  histogram.Record(std::numeric_limits<uint64_t>::max());
+  // Lower bound of the last bucket.
+  const auto last_bucket =
+      std::to_string(((uint64_t{1} << Histogram::kSubBucketBits) - 1)
+                     << (Histogram::kMaxValueBits - Histogram::kSubBucketBits));
+  // Values of the last bucket are unbounded, so percentiles falling into it
+  // report the maximum.
+  if (!ExpectBuckets(histogram, "[[1,1],[" + last_bucket + ",3]]") ||
+      !Expect("count", histogram.GetCount(), 4) ||
+      !Expect("max", histogram.GetMax(),
+              std::numeric_limits<uint64_t>::max()) ||
+      !Expect("p25", histogram.GetPercentile(25.), 1) ||
+      !Expect("p50", histogram.GetPercentile(50.),
+              std::numeric_limits<uint64_t>::max()))
+    return false;
+  std::cout << "passed" << std::endl;
+  return true;
+}
+
+}  // namespace
+
+int main() {
+  bool passed = TestEmpty();
+  passed &= TestBuckets();
+  passed &= TestPercentiles();
+  passed &= TestOverflow();
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,154 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//          *** Live Start Test ***
+//
+// Checks that live playback starts without any playback position updates.
+// A LivePacketSource is fed in real time by a simulated network thread, while
+// nothing calls PacketPump::UpdateTime(): a media element can't report
+// progress before it has data to play. The pump has to buffer
+// kLowLatencyBufferAhead on its own as the JitterBuffer releases packets, in
+// every WorkerMode.
+//
+// Built and run by ctest, see CMakeLists.txt.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "jitter_buffer.h"
+#include "packet_pump.h"
+#include "pump_thread_pool.h"
+#include "simulated_decoder_sink.h"
+
+namespace {
+
+using Seconds = PacketPump::Seconds;
+using WallClock = std::chrono::steady_clock;
+using WorkerMode = PacketPump::WorkerMode;
+
+constexpr double kFps = 30.;
+constexpr size_t kFrameCount = 24;
+constexpr size_t kFrameSize = 1000;
+constexpr auto kPlayoutDelay = std::chrono::milliseconds{50};
+
+// Packets due up to kLowLatencyBufferAhead are released by the jitter buffer
+// about this long after the network starts delivering them.
+constexpr auto kExpectedStartTime =
+    std::chrono::duration_cast<WallClock::duration>(
+        PacketPump::kLowLatencyBufferAhead) +
+    kPlayoutDelay;
+
+// Allowed delay on top of kExpectedStartTime, generous enough for a loaded CI
+// machine. Without wake-ups the pump never starts.
+constexpr auto kStartTolerance = std::chrono::milliseconds{400};
+
+const char* GetModeName(WorkerMode worker_mode) {
+  switch (worker_mode) {
+    case WorkerMode::kOwnThread:
+      return "kOwnThread";
+    case WorkerMode::kThreadPool:
+      return "kThreadPool";
+    case WorkerMode::kMainLoop:
+      return "kMainLoop";
+  }
+  return "";
+}
+
+// Returns true if kLowLatencyBufferAhead was buffered in time.
+bool TestLiveStart(WorkerMode worker_mode, PumpThreadPool* thread_pool) {
+  auto source = std::make_shared<LivePacketSource>(
+      samsung::wasm::ElementaryVideoTrackConfig{},
+      JitterBuffer::Config{kPlayoutDelay, 256});
+  auto sink = std::make_unique<SimulatedDecoderSink>();
+  auto* decoder = sink.get();
+  std::vector<PacketPump::Track> tracks;
+  tracks.push_back({std::move(sink), source});
+  PacketPump pump{std::move(tracks),
+                  {PacketPump::kLowLatencyBufferAhead,
+                   PacketPump::kMaxBufferedBytes, PacketPump::kMaxTrackSkew},
+                  worker_mode,
+                  thread_pool};
+  // The track opens before the first packet arrives.
+  pump.OnTrackOpen();
+
+  const auto frame_duration = Seconds{1. / kFps};
+  const auto start = WallClock::now();
+  std::thread network([&]() {
+    for (size_t frame_idx = 0; frame_idx < kFrameCount; ++frame_idx) {
+      const auto dts = frame_duration * frame_idx;
+      std::this_thread::sleep_until(
+          start + std::chrono::duration_cast<WallClock::duration>(dts));
+      DemuxedPacket packet;
+      packet.packet.pts = dts;
+      packet.packet.dts = dts;
+      packet.packet.duration = frame_duration;
+      packet.packet.is_key_frame = frame_idx == 0;
+      packet.data.resize(kFrameSize);
+      packet.packet.size = packet.data.size();
+      source->Push(std::move(packet));
+    }
+  });
+
+  const auto deadline = start + kExpectedStartTime + kStartTolerance;
+  auto start_time = WallClock::time_point::max();
+  while (WallClock::now() < deadline) {
+    if (worker_mode == WorkerMode::kMainLoop)
+      pump.RunSlice(PacketPump::kSliceBudget);
+    if (decoder->GetStats().max_buffered_duration >=
+        PacketPump::kLowLatencyBufferAhead) {
+      start_time = WallClock::now();
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds{1});
+  }
+  network.join();
+  pump.Terminate();
+
+  std::cout << GetModeName(worker_mode) << ": ";
+  if (start_time == WallClock::time_point::max()) {
+    std::cout << "FAILED, buffered "
+              << decoder->GetStats().max_buffered_duration.count()
+              << "s without position updates" << std::endl;
+    return false;
+  }
+  std::cout << "buffered " << PacketPump::kLowLatencyBufferAhead.count()
+            << "s after "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(
+                   start_time - start)
+                   .count()
+            << "ms" << std::endl;
+  return true;
+}
+
+}  // namespace
+
+int main() {
+  PumpThreadPool thread_pool{2};
+  bool passed = TestLiveStart(WorkerMode::kOwnThread, nullptr);
+  passed &= TestLiveStart(WorkerMode::kThreadPool, &thread_pool);
+  passed &= TestLiveStart(WorkerMode::kMainLoop, nullptr);
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
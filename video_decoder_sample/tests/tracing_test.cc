@@ -0,0 +1,317 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//          *** Tracing Test ***
+//
+// Records a few events on two threads and checks that
+// tracing::ExportChromeTraceJson() returns well-formed JSON in Chrome trace
+// event format: thread names as metadata ("ph":"M") events and every recorded
+// event as a complete ("ph":"X") event with its "ts" and "dur", nested events
+// within their parents. Events recorded while tracing is disabled must not be
+// exported.
+//
+// Built and run by ctest, see CMakeLists.txt.
+
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tracing.h"
+
+namespace {
+
+// Parsed JSON value, enough to inspect the exported trace.
+struct JsonValue {
+  enum class Type { kNull, kBool, kNumber, kString, kArray, kObject };
+
+  Type type = Type::kNull;
+  double number = 0.;
+  std::string string;
+  std::vector<JsonValue> array;
+  std::map<std::string, JsonValue> object;
+};  // struct JsonValue
+
+// Strict JSON parser (RFC 8259), except for \u escapes which are kept as is.
+class JsonParser {
+ public:
+  explicit JsonParser(const std::string& text) : text_(text) {}
+
+  bool Parse(JsonValue* value) {
+    return ParseValue(value) && (SkipWhitespace(), pos_ == text_.size());
+  }
+
+ private:
+  void SkipWhitespace() {
+    while (pos_ < text_.size() &&
+           (text_[pos_] == ' ' || text_[pos_] == '\t' || text_[pos_] == '\n' ||
+            text_[pos_] == '\r')) {
+      ++pos_;
+    }
+  }
+
+  bool Consume(char c) {
+    SkipWhitespace();
+    if (pos_ == text_.size() || text_[pos_] != c)
+      return false;
+    ++pos_;
+    return true;
+  }
+
+  bool ConsumeLiteral(const char* literal) {
+    const std::string expected{literal};
+    if (text_.compare(pos_, expected.size(), expected) != 0)
+      return false;
+    pos_ += expected.size();
+    return true;
+  }
+
+  bool ParseValue(JsonValue* value) {
+    SkipWhitespace();
+    if (pos_ == text_.size())
+      return false;
+    switch (text_[pos_]) {
+      case '{':
+        return ParseObject(value);
+      case '[':
+        return ParseArray(value);
+      case '"':
+        value->type = JsonValue::Type::kString;
+        return ParseString(&value->string);
+      case 't':
+        value->type = JsonValue::Type::kBool;
+        return ConsumeLiteral("true");
+      case 'f':
+        value->type = JsonValue::Type::kBool;
+        return ConsumeLiteral("false");
+      case 'n':
+        value->type = JsonValue::Type::kNull;
+        return ConsumeLiteral("null");
+      default:
+        value->type = JsonValue::Type::kNumber;
+        return ParseNumber(&value->number);
+    }
+  }
+
+  bool ParseObject(JsonValue* value) {
+    value->type = JsonValue::Type::kObject;
+    ++pos_;
+    if (Consume('}'))
+      return true;
+    do {
+      std::string key;
+      SkipWhitespace();
+      if (!ParseString(&key) || !Consume(':') ||
+          !ParseValue(&value->object[key])) {
+        return false;
+      }
+    } while (Consume(','));
+    return Consume('}');
+  }
+
+  bool ParseArray(JsonValue* value) {
+    value->type = JsonValue::Type::kArray;
+    ++pos_;
+    if (Consume(']'))
+      return true;
+    do {
+      value->array.emplace_back();
+      if (!ParseValue(&value->array.back()))
+        return false;
+    } while (Consume(','));
+    return Consume(']');
+  }
+
+  bool ParseString(std::string* string) {
+    if (pos_ == text_.size() || text_[pos_] != '"')
+      return false;
+    for (++pos_; pos_ < text_.size(); ++pos_) {
+      const char c = text_[pos_];
+      if (c == '"') {
+        ++pos_;
+        return true;
+      }
+      if (static_cast<unsigned char>(c) < 0x20)
+        return false;
+      if (c == '\\') {
+        if (++pos_ == text_.size() ||
+            std::string{"\"\\/bfnrtu"}.find(text_[pos_]) == std::string::npos)
+          return false;
+      }
+      *string += c;
+    }
+    return false;
+  }
+
+  bool ParseNumber(double* number) {
+    const auto begin = pos_;
+    if (pos_ < text_.size() && text_[pos_] == '-')
+      ++pos_;
+    const auto digits_begin = pos_;
+    while (pos_ < text_.size() &&
+           (std::isdigit(static_cast<unsigned char>(text_[pos_])) ||
+            text_[pos_] == '.' || text_[pos_] == 'e' || text_[pos_] == 'E' ||
+            text_[pos_] == '+' || text_[pos_] == '-')) {
+      ++pos_;
+    }
+    if (pos_ == digits_begin ||
+        !std::isdigit(static_cast<unsigned char>(text_[digits_begin])))
+      return false;
+    char* end = nullptr;
+    const std::string literal = text_.substr(begin, pos_ - begin);
+    *number = std::strtod(literal.c_str(), &end);
+    return end == literal.c_str() + literal.size();
+  }
+
+  const std::string& text_;
+  size_t pos_ = 0;
+};  // class JsonParser
+
+// Complete event ("ph":"X") of the exported trace.
+struct TraceEvent {
+  std::string name;
+  double tid;
+  double ts;
+  double dur;
+};  // struct TraceEvent
+
+bool Fail(const std::string& message) {
+  std::cout << "FAILED, " << message << std::endl;
+  return false;
+}
+
+const JsonValue* GetMember(const JsonValue& object,
+                           const std::string& key,
+                           JsonValue::Type type) {
+  const auto it = object.object.find(key);
+  if (it == object.object.end() || it->second.type != type)
+    return nullptr;
+  return &it->second;
+}
+
+bool FindEvent(const std::vector<TraceEvent>& events,
+               const std::string& name,
+               TraceEvent* found) {
+  for (const auto& event : events) {
+    if (event.name == name) {
+      *found = event;
+      return true;
+    }
+  }
+  return false;
+}
+
+void RecordEvents() {
+  {
+    tracing::ScopedEvent event{"Ignored"};
+  }
+  tracing::SetEnabled(true);
+  tracing::SetThreadName("Main");
+  {
+    tracing::ScopedEvent outer{"Outer"};
+    {
+      tracing::ScopedEvent inner{"Inner"};
+      std::this_thread::sleep_for(std::chrono::milliseconds{2});
+    }
+    std::thread worker{[]() {
+      tracing::SetThreadName("Worker");
+      tracing::ScopedEvent event{"WorkerEvent"};
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }};
+    worker.join();
+  }
+  tracing::SetEnabled(false);
+  {
+    tracing::ScopedEvent event{"Ignored"};
+  }
+}
+
+bool TestExport() {
+  RecordEvents();
+  const auto json = tracing::ExportChromeTraceJson();
+
+  JsonValue trace;
+  if (!JsonParser{json}.Parse(&trace) ||
+      trace.type != JsonValue::Type::kObject)
+    return Fail("malformed JSON: " + json);
+  const auto* trace_events =
+      GetMember(trace, "traceEvents", JsonValue::Type::kArray);
+  if (!trace_events)
+    return Fail("no traceEvents array");
+
+  std::map<double, std::string> thread_names;
+  std::vector<TraceEvent> events;
+  for (const auto& value : trace_events->array) {
+    if (value.type != JsonValue::Type::kObject)
+      return Fail("trace event isn't an object");
+    const auto* name = GetMember(value, "name", JsonValue::Type::kString);
+    const auto* ph = GetMember(value, "ph", JsonValue::Type::kString);
+    const auto* tid = GetMember(value, "tid", JsonValue::Type::kNumber);
+    if (!name || !ph || !tid ||
+        !GetMember(value, "pid", JsonValue::Type::kNumber))
+      return Fail("trace event without name, ph, pid or tid");
+    if (ph->string == "M") {
+      const auto* args = GetMember(value, "args", JsonValue::Type::kObject);
+      const auto* thread_name =
+          args ? GetMember(*args, "name", JsonValue::Type::kString) : nullptr;
+      if (name->string != "thread_name" || !thread_name)
+        return Fail("unexpected metadata event " + name->string);
+      thread_names[tid->number] = thread_name->string;
+    } else if (ph->string == "X") {
+      const auto* ts = GetMember(value, "ts", JsonValue::Type::kNumber);
+      const auto* dur = GetMember(value, "dur", JsonValue::Type::kNumber);
+      if (!ts || !dur || ts->number < 0 || dur->number < 0)
+        return Fail("event " + name->string + " without valid ts and dur");
+      events.push_back({name->string, tid->number, ts->number, dur->number});
+    } else {
+      return Fail("unexpected ph " + ph->string);
+    }
+  }
+
+  TraceEvent outer, inner, worker;
+  if (events.size() != 3 || !FindEvent(events, "Outer", &outer) ||
+      !FindEvent(events, "Inner", &inner) ||
+      !FindEvent(events, "WorkerEvent", &worker))
+    return Fail("expected Outer, Inner and WorkerEvent only: " + json);
+  if (thread_names[outer.tid] != "Main" || inner.tid != outer.tid ||
+      thread_names[worker.tid] != "Worker" || worker.tid == outer.tid)
+    return Fail("events on wrong threads: " + json);
+  // Durations are truncated to microseconds.
+  if (inner.dur < 2000 || inner.ts < outer.ts ||
+      inner.ts + inner.dur > outer.ts + outer.dur + 1 ||
+      worker.ts < inner.ts + inner.dur - 1 ||
+      worker.ts + worker.dur > outer.ts + outer.dur + 1)
+    return Fail("events not nested: " + json);
+  return true;
+}
+
+}  // namespace
+
+int main() {
+  if (!TestExport())
+    return EXIT_FAILURE;
+  std::cout << "Tracing: passed" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,279 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//          *** Frame Pacing Simulator ***
+//
+// Host tool that drives a FrameScheduler (see src/frame_scheduler.h) with
+// a simulated vsync clock and a simulated decoder filling a ring of textures,
+// the way VideoDecoderTrackDataPump does. Reports presented, dropped and
+// repeated frames, how many vsyncs frames stay on screen (the cadence, e.g.
+// 1-1-1-1-2 for 50 FPS on a 60 Hz panel) and the presentation error, i.e. the
+// difference between a frame's pts and the media time of the vsync that shows
+// it. Time is simulated, so a run takes a fraction of a second.
+//
+// The decoder fills one texture at a time, each taking the decode time plus
+// an exponentially distributed jitter, and a texture is filled again once the
+// frame it held was shown and replaced or dropped. Playback position is
+// reported every position update interval and delivered late by the given
+// delay, like HTMLMediaElement's time updates.
+//
+// Build it with a host compiler, e.g.:
+//   g++ -std=gnu++14 -I../src frame_pacing_simulator.cc
+//       ../src/frame_scheduler.cc -o frame_pacing_simulator
+//
+// Usage:
+//   frame_pacing_simulator [--fps=<default 50>]
+//                          [--refresh-hz=<default 60>]
+//                          [--textures=<default 3>]
+//                          [--decode-ms=<default 5>]
+//                          [--decode-jitter-ms=<mean jitter, default 2>]
+//                          [--position-update-ms=<default 250>]
+//                          [--position-delay-ms=<default 10>]
+//                          [--duration-s=<default 60>]
+//                          [--seed=<default 1>]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "frame_scheduler.h"
+
+namespace {
+
+using Clock = FrameScheduler::Clock;
+using Seconds = FrameScheduler::Seconds;
+
+struct Options {
+  double fps = 50.;
+  double refresh_hz = 60.;
+  double textures = 3.;
+  double decode_ms = 5.;
+  double decode_jitter_ms = 2.;
+  double position_update_ms = 250.;
+  double position_delay_ms = 10.;
+  double duration_s = 60.;
+  double seed = 1.;
+};  // struct Options
+
+// A texture being filled with a frame.
+struct Fill {
+  Seconds done_time;
+  uint32_t texture_id;
+  uint64_t frame_idx;
+};  // struct Fill
+
+// Parses --name=value arguments. Returns false on an unknown argument.
+bool ParseOptions(int argc, char* argv[], Options* options) {
+  const struct {
+    const char* name;
+    double* value;
+  } kFlags[] = {
+      {"--fps=", &options->fps},
+      {"--refresh-hz=", &options->refresh_hz},
+      {"--textures=", &options->textures},
+      {"--decode-ms=", &options->decode_ms},
+      {"--decode-jitter-ms=", &options->decode_jitter_ms},
+      {"--position-update-ms=", &options->position_update_ms},
+      {"--position-delay-ms=", &options->position_delay_ms},
+      {"--duration-s=", &options->duration_s},
+      {"--seed=", &options->seed},
+  };
+  for (int arg_idx = 1; arg_idx < argc; ++arg_idx) {
+    bool parsed = false;
+    for (const auto& flag : kFlags) {
+      const auto name_length = std::strlen(flag.name);
+      if (std::strncmp(argv[arg_idx], flag.name, name_length) == 0) {
+        *flag.value = std::atof(argv[arg_idx] + name_length);
+        parsed = true;
+        break;
+      }
+    }
+    if (!parsed) {
+      std::cout << "Unknown argument: " << argv[arg_idx] << std::endl;
+      return false;
+    }
+  }
+  return options->fps > 0. && options->refresh_hz > 0. &&
+         options->textures >= 1. && options->position_update_ms > 0.;
+}
+
+Clock::time_point ToTimePoint(Seconds time) {
+  return Clock::time_point{} +
+         std::chrono::duration_cast<Clock::duration>(time);
+}
+
+// Returns the given percentile of sorted values.
+double Percentile(const std::vector<double>& sorted_values, double percentile) {
+  if (sorted_values.empty())
+    return 0.;
+  const auto idx = static_cast<size_t>(percentile / 100. *
+                                       (sorted_values.size() - 1) + 0.5);
+  return sorted_values[idx];
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    std::cout << "Usage: " << argv[0]
+              << " [--fps=N] [--refresh-hz=N] [--textures=N] [--decode-ms=N]"
+                 " [--decode-jitter-ms=N] [--position-update-ms=N]"
+                 " [--position-delay-ms=N] [--duration-s=N] [--seed=N]"
+              << std::endl;
+    return 1;
+  }
+
+  const auto frame_duration = Seconds{1. / options.fps};
+  const auto vsync_interval = Seconds{1. / options.refresh_hz};
+  const auto position_update_interval =
+      Seconds{options.position_update_ms / 1000.};
+  const auto position_delay = Seconds{options.position_delay_ms / 1000.};
+  const auto frame_count =
+      static_cast<uint64_t>(options.duration_s * options.fps);
+  std::mt19937 generator{static_cast<std::mt19937::result_type>(options.seed)};
+  std::exponential_distribution<double> jitter_ms{
+      options.decode_jitter_ms > 0. ? 1. / options.decode_jitter_ms : 1.};
+  auto decode_time = [&]() {
+    auto time_ms = options.decode_ms;
+    if (options.decode_jitter_ms > 0.)
+      time_ms += jitter_ms(generator);
+    return Seconds{time_ms / 1000.};
+  };
+
+  FrameScheduler scheduler;
+  std::vector<uint32_t> free_textures;
+  for (uint32_t texture_id = 0;
+       texture_id < static_cast<uint32_t>(options.textures); ++texture_id) {
+    free_textures.push_back(texture_id);
+  }
+  std::vector<uint64_t> texture_frames(free_textures.size());
+  std::deque<Fill> fills;
+  uint64_t next_frame_idx = 0;
+  Seconds decoder_free_time{0};
+
+  // Playback starts with the first presented frame.
+  bool playing = false;
+  Seconds playback_start{0};
+  Seconds next_position_update{0};
+  // Reports made, but not delivered yet: (delivery time, position).
+  std::deque<std::pair<Seconds, Seconds>> position_reports;
+
+  bool has_frame_on_screen = false;
+  uint32_t on_screen_texture = 0;
+  uint32_t on_screen_vsyncs = 0;
+  // Number of frames by the number of vsyncs they stayed on screen.
+  std::map<uint32_t, uint64_t> cadence;
+  std::vector<double> presentation_errors_ms;
+  std::vector<uint32_t> dropped_textures;
+
+  for (auto now = Seconds{0};; now += vsync_interval) {
+    while (!fills.empty() && fills.front().done_time <= now) {
+      texture_frames[fills.front().texture_id] = fills.front().frame_idx;
+      scheduler.QueueFrame(fills.front().texture_id,
+                           frame_duration * fills.front().frame_idx);
+      fills.pop_front();
+    }
+
+    if (playing) {
+      for (; next_position_update <= now;
+           next_position_update += position_update_interval) {
+        position_reports.emplace_back(next_position_update + position_delay,
+                                      next_position_update - playback_start);
+      }
+      while (!position_reports.empty() &&
+             position_reports.front().first <= now) {
+        scheduler.OnMediaTime(position_reports.front().second,
+                              ToTimePoint(position_reports.front().first));
+        position_reports.pop_front();
+      }
+    }
+
+    uint32_t texture_id = 0;
+    dropped_textures.clear();
+    const bool present =
+        scheduler.OnVsync(ToTimePoint(now), &texture_id, &dropped_textures);
+    free_textures.insert(free_textures.end(), dropped_textures.begin(),
+                         dropped_textures.end());
+    if (present) {
+      if (!playing) {
+        playing = true;
+        playback_start = now;
+        next_position_update = now;
+      }
+      if (has_frame_on_screen) {
+        ++cadence[on_screen_vsyncs];
+        free_textures.push_back(on_screen_texture);
+      }
+      has_frame_on_screen = true;
+      on_screen_texture = texture_id;
+      on_screen_vsyncs = 1;
+      const auto pts = frame_duration * texture_frames[texture_id];
+      presentation_errors_ms.push_back(
+          (now - playback_start - pts).count() * 1e3);
+    } else if (has_frame_on_screen) {
+      ++on_screen_vsyncs;
+    }
+
+    // Free textures are filled right after presenting, one at a time.
+    while (!free_textures.empty() && next_frame_idx < frame_count) {
+      decoder_free_time = std::max(decoder_free_time, now) + decode_time();
+      fills.push_back({decoder_free_time, free_textures.back(),
+                       next_frame_idx++});
+      free_textures.pop_back();
+    }
+
+    if (next_frame_idx == frame_count && fills.empty() && !present &&
+        free_textures.size() + 1 == texture_frames.size()) {
+      break;
+    }
+  }
+  if (has_frame_on_screen)
+    ++cadence[on_screen_vsyncs];
+
+  const auto stats = scheduler.GetStats();
+  std::cout << "Frames: " << frame_count
+            << ", presented: " << stats.presented_count
+            << ", dropped: " << stats.dropped_count
+            << ", repeated vsyncs: " << stats.repeated_count
+            << ", measured vsync interval: "
+            << scheduler.GetVsyncInterval().count() * 1e3 << "ms"
+            << std::endl;
+  std::cout << "Frames by vsyncs on screen:";
+  for (const auto& entry : cadence)
+    std::cout << " " << entry.first << ": " << entry.second;
+  std::cout << std::endl;
+  std::sort(presentation_errors_ms.begin(), presentation_errors_ms.end());
+  std::cout << "Presentation error [ms]:"
+            << " p1 " << Percentile(presentation_errors_ms, 1.)
+            << " p50 " << Percentile(presentation_errors_ms, 50.)
+            << " p99 " << Percentile(presentation_errors_ms, 99.)
+            << std::endl;
+  return 0;
+}
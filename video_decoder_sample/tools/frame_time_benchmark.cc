@@ -0,0 +1,298 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//          *** Main Loop Frame Time Benchmark ***
+//
+// Host tool that compares main thread frame times of players whose pumps run
+// on their own threads (WorkerMode::kOwnThread) with ones whose pumps run in
+// slices on the main thread (WorkerMode::kMainLoop), as in builds without
+// pthreads.
+//
+// The main thread runs animation frames at 60 FPS in real time. At every frame
+// it runs a slice of every kMainLoop pump, advances playback of every player's
+// SimulatedDecoderSink and reports playback positions to the pumps. Time it
+// spends on that work is a frame time. Appending to an ElementaryMediaTrack
+// on a TV takes longer than appending to a simulated sink, so every append
+// spins for a given time. Players seek now and then, which makes pumps refill
+// their buffers in a burst, and content loops once it ends.
+//
+// Build it with a host compiler, e.g. (Samsung WASM headers are shipped with
+// Emscripten SDK with Samsung extensions):
+//   g++ -std=gnu++14 -pthread -I../src -I<path to Samsung WASM headers>
+//       frame_time_benchmark.cc ../src/packet_pump.cc
+//       ../src/simulated_decoder_sink.cc ../src/buffer_ahead_controller.cc
+//       ../src/futex.cc ../src/histogram.cc ../src/packet_source.cc
+//       ../src/pump_thread_pool.cc ../src/tracing.cc -o frame_time_benchmark
+//
+// Usage:
+//   frame_time_benchmark [--players=<default 1>]
+//                        [--duration-s=<per worker mode, default 20>]
+//                        [--append-us=<time an append takes, default 50>]
+//                        [--bitrate-kbps=<default 8000>]
+//                        [--seek-interval-s=<0 disables seeks, default 5>]
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "histogram.h"
+#include "packet_pump.h"
+#include "simulated_decoder_sink.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Seconds = PacketPump::Seconds;
+using WorkerMode = PacketPump::WorkerMode;
+
+constexpr double kFps = 30.;
+constexpr size_t kGop = 30;
+constexpr Seconds kContentDuration = Seconds{60.};
+constexpr auto kFrameInterval = std::chrono::microseconds{16667};
+constexpr Seconds kUpdateInterval = Seconds{0.25};
+
+struct Options {
+  double players = 1.;
+  double duration_s = 20.;
+  double append_us = 50.;
+  double bitrate_kbps = 8000.;
+  double seek_interval_s = 5.;
+};  // struct Options
+
+// Parses --name=value arguments. Returns false on an unknown argument.
+bool ParseOptions(int argc, char* argv[], Options* options) {
+  const struct {
+    const char* name;
+    double* value;
+  } kFlags[] = {
+      {"--players=", &options->players},
+      {"--duration-s=", &options->duration_s},
+      {"--append-us=", &options->append_us},
+      {"--bitrate-kbps=", &options->bitrate_kbps},
+      {"--seek-interval-s=", &options->seek_interval_s},
+  };
+  for (int arg_idx = 1; arg_idx < argc; ++arg_idx) {
+    bool parsed = false;
+    for (const auto& flag : kFlags) {
+      const auto name_length = std::strlen(flag.name);
+      if (std::strncmp(argv[arg_idx], flag.name, name_length) == 0) {
+        *flag.value = std::atof(argv[arg_idx] + name_length);
+        parsed = true;
+        break;
+      }
+    }
+    if (!parsed) {
+      std::cout << "Unknown argument: " << argv[arg_idx] << std::endl;
+      return false;
+    }
+  }
+  return options->players >= 1. && options->duration_s > 0. &&
+         options->append_us >= 0. && options->bitrate_kbps > 0. &&
+         options->seek_interval_s >= 0.;
+}
+
+// Constant bitrate stream where a keyframe is 4 times larger than other
+// frames. All packets share a single payload buffer, as its contents don't
+// matter to the pump.
+class SyntheticPacketSource : public PacketSource {
+ public:
+  explicit SyntheticPacketSource(double bitrate_kbps) {
+    const auto gop_bytes = bitrate_kbps * 1000. / 8. * kGop / kFps;
+    frame_size_ = static_cast<uint32_t>(gop_bytes / (kGop + 3));
+    payload_.resize(frame_size_ * 4);
+  }
+
+  Seconds GetDuration() const override { return kContentDuration; }
+
+  const ElementaryVideoTrackConfig& GetVideoTrackConfig() const override {
+    return video_track_config_;
+  }
+
+  size_t GetPacketCount() const override {
+    return static_cast<size_t>(kContentDuration.count() * kFps);
+  }
+
+  void FillPacket(size_t index, ElementaryMediaPacket* packet) const override {
+    *packet = {};
+    packet->pts = packet->dts = Seconds{index / kFps};
+    packet->duration = Seconds{1. / kFps};
+    packet->is_key_frame = index % kGop == 0;
+    packet->size = packet->is_key_frame ? frame_size_ * 4 : frame_size_;
+    packet->data = payload_.data();
+  }
+
+ private:
+  uint32_t frame_size_;
+  std::vector<uint8_t> payload_;
+  ElementaryVideoTrackConfig video_track_config_;
+};  // class SyntheticPacketSource
+
+// Takes as long to append a packet as a track on a TV would.
+class SlowAppendSink : public SimulatedDecoderSink {
+ public:
+  explicit SlowAppendSink(Clock::duration append_time)
+      : append_time_(append_time) {}
+
+  void AppendPacket(const ElementaryMediaPacket& packet) override {
+    const auto end = Clock::now() + append_time_;
+    while (Clock::now() < end) {
+    }
+    SimulatedDecoderSink::AppendPacket(packet);
+  }
+
+ private:
+  Clock::duration append_time_;
+};  // class SlowAppendSink
+
+struct Player {
+  // Owned by the pump.
+  SimulatedDecoderSink* sink;
+  std::unique_ptr<PacketPump> pump;
+  Seconds position;
+  Clock::time_point next_seek_time;
+};  // struct Player
+
+void PrintPercentiles(const char* name, const Histogram& histogram) {
+  std::cout << name << " p50 " << histogram.GetPercentile(50.)
+            << " p99 " << histogram.GetPercentile(99.) << " max "
+            << histogram.GetMax();
+}
+
+void Seek(Player* player, Seconds time) {
+  // A track closes before it's seeked and opens once it's ready for data.
+  player->pump->OnTrackClosed();
+  player->sink->Seek(time);
+  player->pump->OnSeek(time);
+  player->pump->OnTrackOpen();
+  player->position = time;
+}
+
+void RunPlayers(WorkerMode worker_mode, const Options& options) {
+  const auto source =
+      std::make_shared<SyntheticPacketSource>(options.bitrate_kbps);
+  const auto append_time = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double, std::micro>{options.append_us});
+  const auto seek_interval = std::chrono::duration_cast<Clock::duration>(
+      Seconds{options.seek_interval_s});
+  const auto player_count = static_cast<size_t>(options.players);
+  const auto start = Clock::now();
+
+  std::vector<Player> players(player_count);
+  for (size_t player_idx = 0; player_idx < player_count; ++player_idx) {
+    auto& player = players[player_idx];
+    auto sink = std::make_unique<SlowAppendSink>(append_time);
+    player.sink = sink.get();
+    std::vector<PacketPump::Track> tracks;
+    tracks.push_back({std::move(sink), source});
+    player.pump = std::make_unique<PacketPump>(
+        std::move(tracks),
+        PacketPump::BufferPolicy{PacketPump::kBufferAhead,
+                                 PacketPump::kMaxBufferedBytes,
+                                 PacketPump::kMaxTrackSkew},
+        worker_mode);
+    player.position = Seconds{0};
+    // Players seek at different times.
+    player.next_seek_time =
+        start + seek_interval * (player_idx + 1) / player_count;
+    player.pump->OnTrackOpen();
+  }
+
+  Histogram frame_us;
+  uint64_t long_frame_count = 0;
+  const auto end = start + std::chrono::duration_cast<Clock::duration>(
+                               Seconds{options.duration_s});
+  const auto update_interval =
+      std::chrono::duration_cast<Clock::duration>(kUpdateInterval);
+  auto next_update = start + update_interval;
+  auto last_frame = start;
+  for (auto frame = start + kFrameInterval; frame < end;
+       frame += kFrameInterval) {
+    std::this_thread::sleep_until(frame);
+    const auto frame_start = Clock::now();
+    const auto update = frame_start >= next_update;
+    if (update)
+      next_update += update_interval;
+    for (auto& player : players) {
+      if (worker_mode == WorkerMode::kMainLoop)
+        player.pump->RunSlice(PacketPump::kSliceBudget);
+      player.position = player.sink->Advance(frame_start - last_frame);
+      if (player.sink->HasEnded()) {
+        Seek(&player, Seconds{0});
+      } else if (seek_interval > Clock::duration::zero() &&
+                 frame_start >= player.next_seek_time) {
+        player.next_seek_time += seek_interval;
+        // Jumps forward by a third of the content, wrapping around.
+        const auto target = player.position + kContentDuration / 3.;
+        Seek(&player, Seconds{std::fmod(target.count(),
+                                        kContentDuration.count())});
+      } else if (update) {
+        player.pump->UpdateTime(player.position);
+      }
+    }
+    last_frame = frame_start;
+    const auto frame_time = Clock::now() - frame_start;
+    frame_us.Record(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(frame_time)
+            .count()));
+    long_frame_count += frame_time > kFrameInterval;
+  }
+
+  uint32_t underrun_count = 0;
+  Seconds stall_time{0};
+  for (auto& player : players) {
+    const auto stats = player.sink->GetStats();
+    underrun_count += stats.underrun_count;
+    stall_time += stats.stall_time;
+    player.pump->Terminate();
+  }
+
+  std::cout << (worker_mode == WorkerMode::kMainLoop ? "kMainLoop"
+                                                     : "kOwnThread")
+            << ": " << player_count << " players, main thread frame time [us]:";
+  PrintPercentiles("", frame_us);
+  std::cout << ", frames over " << kFrameInterval.count() / 1000. << "ms: "
+            << long_frame_count << " of " << frame_us.GetCount()
+            << ", underruns: " << underrun_count
+            << ", stalled: " << stall_time.count() << "s" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    std::cout << "Usage: " << argv[0]
+              << " [--players=N] [--duration-s=N] [--append-us=N]"
+              << " [--bitrate-kbps=N] [--seek-interval-s=N]" << std::endl;
+    return 1;
+  }
+
+  RunPlayers(WorkerMode::kOwnThread, options);
+  RunPlayers(WorkerMode::kMainLoop, options);
+  return 0;
+}
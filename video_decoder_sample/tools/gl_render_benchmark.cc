@@ -0,0 +1,382 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//          *** GL Render Benchmark ***
+//
+// Host tool that runs the render loop of VideoDecoderTrackDataPump, i.e.
+// drawing a full-screen quad textured with the next texture of a ring, with
+// a software GL (e.g. Mesa llvmpipe) in an offscreen EGL context. Reports GL
+// calls issued per frame and frame time, so that changes to the render path
+// can be compared without a TV.
+//
+// Frames are drawn either through a GLStateCache (see src/gl_state_cache.h),
+// like the sample does, or the way the sample used to draw them: setting all
+// the state and calling glGetError() on every frame. Each frame ends with
+// glFinish(), so frame time includes rasterization. Decoded frames are
+// replaced with regular 2D textures, as host GL doesn't have external ones.
+//
+// With --tiles, a MosaicCompositor (see src/mosaic_compositor.h) draws the
+// given number of streams in a grid instead, every tile showing another
+// texture on every frame, and draw calls per frame are reported as well.
+// Running it for e.g. 1, 4, 9 and 16 tiles shows how frame time scales with
+// the tile count. The layout can be mirrored every few frames to include
+// the cost of layout updates.
+//
+// Programs come from a ShaderProgramCache (see src/shader_program_cache.h);
+// the time to build the program and to get it from the cache is reported too.
+//
+// Build it with a host compiler, e.g.:
+//   g++ -std=gnu++14 -I../src gl_render_benchmark.cc ../src/gl_state_cache.cc
+//       ../src/histogram.cc ../src/mosaic_compositor.cc
+//       ../src/shader_program_cache.cc -lEGL -lGLESv2
+//       -o gl_render_benchmark
+// and run it without a display server with EGL_PLATFORM=surfaceless.
+//
+// Usage:
+//   gl_render_benchmark [--frames=<default 600>]
+//                       [--textures=<default 3>]
+//                       [--width=<default 1280>]
+//                       [--height=<default 720>]
+//                       [--cache=<0 sets all state every frame, default 1>]
+//                       [--tiles=<0 draws a single stream, default 0>]
+//                       [--textures-per-draw=<mosaic tiles drawn at once,
+//                                             default 8>]
+//                       [--layout-interval=<frames between mosaic layout
+//                                           changes, 0 never, default 0>]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+
+#include "gl_state_cache.h"
+#include "histogram.h"
+#include "mosaic_compositor.h"
+#include "shader_program_cache.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  double frames = 600.;
+  double textures = 3.;
+  double width = 1280.;
+  double height = 720.;
+  double cache = 1.;
+  double tiles = 0.;
+  double textures_per_draw = 8.;
+  double layout_interval = 0.;
+};  // struct Options
+
+// Same as the sample's shaders, but sampling a 2D texture.
+const char kVertexShader[] =
+    "varying vec2 v_texCoord;               \n"
+    "attribute vec4 a_position;             \n"
+    "attribute vec2 a_texCoord;             \n"
+    "uniform vec2 v_scale;                  \n"
+    "void main()                            \n"
+    "{                                      \n"
+    "    v_texCoord = v_scale * a_texCoord; \n"
+    "    gl_Position = a_position;          \n"
+    "}";
+
+const char kFragmentShader[] =
+    "precision mediump float;                             \n"
+    "varying vec2 v_texCoord;                             \n"
+    "uniform sampler2D s_texture;                         \n"
+    "void main()                                          \n"
+    "{                                                    \n"
+    "    gl_FragColor = texture2D(s_texture, v_texCoord); \n"
+    "}                                                    \n";
+
+// Parses --name=value arguments. Returns false on an unknown argument.
+bool ParseOptions(int argc, char* argv[], Options* options) {
+  const struct {
+    const char* name;
+    double* value;
+  } kFlags[] = {
+      {"--frames=", &options->frames},
+      {"--textures=", &options->textures},
+      {"--width=", &options->width},
+      {"--height=", &options->height},
+      {"--cache=", &options->cache},
+      {"--tiles=", &options->tiles},
+      {"--textures-per-draw=", &options->textures_per_draw},
+      {"--layout-interval=", &options->layout_interval},
+  };
+  for (int arg_idx = 1; arg_idx < argc; ++arg_idx) {
+    bool parsed = false;
+    for (const auto& flag : kFlags) {
+      const auto name_length = std::strlen(flag.name);
+      if (std::strncmp(argv[arg_idx], flag.name, name_length) == 0) {
+        *flag.value = std::atof(argv[arg_idx] + name_length);
+        parsed = true;
+        break;
+      }
+    }
+    if (!parsed) {
+      std::cout << "Unknown argument: " << argv[arg_idx] << std::endl;
+      return false;
+    }
+  }
+  return options->frames >= 1. && options->textures >= 1. &&
+         options->width >= 1. && options->height >= 1. &&
+         options->tiles >= 0. && options->textures_per_draw >= 1. &&
+         options->layout_interval >= 0.;
+}
+
+// Creates an offscreen GLES 2 context of the given size and makes it current.
+bool CreateContext(EGLint width, EGLint height) {
+  auto display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (!eglInitialize(display, nullptr, nullptr))
+    return false;
+  const EGLint config_attributes[] = {
+      EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE,
+      EGL_OPENGL_ES2_BIT, EGL_NONE,
+  };
+  EGLConfig config;
+  EGLint config_count = 0;
+  if (!eglChooseConfig(display, config_attributes, &config, 1,
+                       &config_count) ||
+      config_count == 0) {
+    return false;
+  }
+  const EGLint surface_attributes[] = {EGL_WIDTH, width, EGL_HEIGHT, height,
+                                       EGL_NONE};
+  auto surface = eglCreatePbufferSurface(display, config, surface_attributes);
+  eglBindAPI(EGL_OPENGL_ES_API);
+  const EGLint context_attributes[] = {EGL_CONTEXT_CLIENT_VERSION, 2,
+                                       EGL_NONE};
+  auto context =
+      eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+  return surface != EGL_NO_SURFACE && context != EGL_NO_CONTEXT &&
+         eglMakeCurrent(display, surface, surface, context);
+}
+
+ShaderProgramCache* GetProgramCache() {
+  return ShaderProgramCache::GetForContext(eglGetCurrentContext());
+}
+
+uint64_t ToMicroseconds(Clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(duration)
+      .count();
+}
+
+// Sets up GL objects like VideoDecoderTrackDataPump does. Returns the program
+// or 0 if it can't be built.
+GLuint CreateGLObjects() {
+  static const float kVertices[] = {
+      -1, -1, -1, 1, 1, -1, 1, 1,  // Position coordinates.
+      0,  1,  0,  0, 1, 1,  1, 0,  // Texture coordinates.
+  };
+  GLuint buffer;
+  glGenBuffers(1, &buffer);
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(kVertices), kVertices, GL_STATIC_DRAW);
+
+  // The second request shows what players created after the first one pay.
+  auto start = Clock::now();
+  GLuint program =
+      GetProgramCache()->GetProgram(kVertexShader, kFragmentShader);
+  const auto build_time = Clock::now() - start;
+  start = Clock::now();
+  GetProgramCache()->GetProgram(kVertexShader, kFragmentShader);
+  const auto cache_hit_time = Clock::now() - start;
+  std::cout << "Shader program: built in " << ToMicroseconds(build_time)
+            << "us, cache hit in " << ToMicroseconds(cache_hit_time) << "us"
+            << std::endl;
+  if (!program)
+    return 0;
+  glUseProgram(program);
+  glUniform1i(glGetUniformLocation(program, "s_texture"), 0);
+  GLint pos_location = glGetAttribLocation(program, "a_position");
+  GLint tc_location = glGetAttribLocation(program, "a_texCoord");
+  glEnableVertexAttribArray(pos_location);
+  glVertexAttribPointer(pos_location, 2, GL_FLOAT, GL_FALSE, 0, 0);
+  glEnableVertexAttribArray(tc_location);
+  glVertexAttribPointer(tc_location, 2, GL_FLOAT, GL_FALSE, 0,
+                        static_cast<float*>(0) + 8);
+  glUseProgram(0);
+  return program;
+}
+
+// Creates textures with a frame of decoded video of the given size each.
+std::vector<GLuint> CreateTextures(size_t count,
+                                   GLsizei width,
+                                   GLsizei height) {
+  std::vector<GLuint> textures(count);
+  std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+  glGenTextures(count, textures.data());
+  for (size_t texture_idx = 0; texture_idx < count; ++texture_idx) {
+    std::fill(pixels.begin(), pixels.end(),
+              static_cast<uint8_t>(texture_idx * 64));
+    glBindTexture(GL_TEXTURE_2D, textures[texture_idx]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, pixels.data());
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return textures;
+}
+
+void PrintGLCalls(const GLStateCache& gl_state, uint64_t extra_calls) {
+  const auto stats = gl_state.GetStats();
+  std::cout << "Frames: " << stats.frame_count << ", GL calls per frame: "
+            << static_cast<double>(stats.issued_calls + extra_calls) /
+                   stats.frame_count
+            << " (max "
+            << gl_state.GetCallsPerFrame().GetMax() +
+                   extra_calls / stats.frame_count
+            << "), skipped calls: " << stats.skipped_calls << std::endl;
+}
+
+// Draws frames of a single stream like VideoDecoderTrackDataPump does.
+// Returns false if GL objects can't be set up.
+bool RunSingleStream(const Options& options,
+                     GLsizei width,
+                     GLsizei height,
+                     Histogram* frame_time_us) {
+  const auto program = CreateGLObjects();
+  if (!program)
+    return false;
+  const auto textures =
+      CreateTextures(static_cast<size_t>(options.textures), width, height);
+  const auto texcoord_scale_location = glGetUniformLocation(program, "v_scale");
+  if (glGetError() != GL_NO_ERROR)
+    return false;
+
+  const bool use_cache = options.cache != 0.;
+  const auto frame_count = static_cast<uint64_t>(options.frames);
+  GLStateCache gl_state;
+  // The error checks of the old render path are made outside of the cache.
+  uint64_t error_checks = 0;
+  for (uint64_t frame_idx = 0; frame_idx < frame_count; ++frame_idx) {
+    const auto frame_start = Clock::now();
+    if (!use_cache)
+      gl_state.Invalidate();
+    gl_state.UseProgram(program);
+    gl_state.Uniform2f(texcoord_scale_location, 1.0, 1.0);
+    gl_state.ActiveTexture(GL_TEXTURE0);
+    gl_state.BindTexture(GL_TEXTURE_2D, textures[frame_idx % textures.size()]);
+    gl_state.DrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    if (!use_cache) {
+      glGetError();
+      ++error_checks;
+    }
+    gl_state.EndFrame();
+    glFinish();
+    frame_time_us->Record(ToMicroseconds(Clock::now() - frame_start));
+  }
+  PrintGLCalls(gl_state, error_checks);
+  return true;
+}
+
+// Draws frames of options.tiles streams with a MosaicCompositor. Returns false
+// if GL objects can't be set up.
+bool RunMosaic(const Options& options,
+               GLsizei width,
+               GLsizei height,
+               Histogram* frame_time_us) {
+  const auto tile_count = static_cast<size_t>(options.tiles);
+  const auto grid_layout = MosaicCompositor::MakeGridLayout(tile_count);
+  auto mirrored_layout = grid_layout;
+  for (auto& tile : mirrored_layout)
+    tile.x = 1.f - tile.x - tile.width;
+  // One texture more than tiles, so that each tile gets another texture on
+  // every frame, like streams do.
+  const auto textures = CreateTextures(
+      tile_count + 1, static_cast<GLsizei>(width * grid_layout[0].width),
+      static_cast<GLsizei>(height * grid_layout[0].height));
+  MosaicCompositor compositor{GetProgramCache(), GL_TEXTURE_2D,
+                              static_cast<size_t>(options.textures_per_draw)};
+  if (!compositor.IsValid() || glGetError() != GL_NO_ERROR)
+    return false;
+
+  const auto frame_count = static_cast<uint64_t>(options.frames);
+  const auto layout_interval = static_cast<uint64_t>(options.layout_interval);
+  compositor.SetLayout(grid_layout);
+  size_t draw_calls = 0;
+  for (uint64_t frame_idx = 0; frame_idx < frame_count; ++frame_idx) {
+    const auto frame_start = Clock::now();
+    if (layout_interval && frame_idx % layout_interval == 0) {
+      compositor.SetLayout((frame_idx / layout_interval) % 2 ? mirrored_layout
+                                                             : grid_layout);
+    }
+    for (size_t tile_idx = 0; tile_idx < tile_count; ++tile_idx) {
+      compositor.SetTileTexture(
+          tile_idx, textures[(tile_idx + frame_idx) % textures.size()]);
+    }
+    compositor.Draw();
+    draw_calls += compositor.GetDrawCallCount();
+    glFinish();
+    frame_time_us->Record(ToMicroseconds(Clock::now() - frame_start));
+  }
+  PrintGLCalls(compositor.GetGLState(), 0);
+  std::cout << "Tiles: " << tile_count << ", draw calls per frame: "
+            << static_cast<double>(draw_calls) / frame_count << std::endl;
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    std::cout << "Usage: " << argv[0]
+              << " [--frames=N] [--textures=N] [--width=N] [--height=N]"
+                 " [--cache=0|1] [--tiles=N] [--textures-per-draw=N]"
+                 " [--layout-interval=N]"
+              << std::endl;
+    return 1;
+  }
+
+  const auto width = static_cast<GLsizei>(options.width);
+  const auto height = static_cast<GLsizei>(options.height);
+  if (!CreateContext(width, height)) {
+    std::cout << "Cannot create an EGL context" << std::endl;
+    return 1;
+  }
+  std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
+  glViewport(0, 0, width, height);
+
+  Histogram frame_time_us;
+  const bool succeeded =
+      options.tiles >= 1.
+          ? RunMosaic(options, width, height, &frame_time_us)
+          : RunSingleStream(options, width, height, &frame_time_us);
+  if (!succeeded) {
+    std::cout << "Cannot set up GL objects" << std::endl;
+    return 1;
+  }
+  std::cout << "Frame time [us]: p50 " << frame_time_us.GetPercentile(50.)
+            << " p99 " << frame_time_us.GetPercentile(99.) << " max "
+            << frame_time_us.GetMax() << std::endl;
+  return 0;
+}
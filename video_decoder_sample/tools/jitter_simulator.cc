@@ -0,0 +1,219 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//          *** Live Latency Simulator ***
+//
+// Host tool that feeds a simulated live stream through a JitterBuffer (see
+// src/jitter_buffer.h) and reports glass-to-append latency, i.e. time from
+// capturing a frame to handing it over to AppendPacket(), for the given
+// network conditions. Useful for choosing a playout delay for a network.
+//
+// Network delay of every packet is the base delay plus an exponentially
+// distributed jitter, so packets arrive out of order now and then. Packets
+// are taken from the jitter buffer on the schedule TrackDataPump's worker
+// follows at the live edge, where it's always behind its buffering target: at
+// the release time of the next packet held, as computed when the worker last
+// took packets, or every LivePacketSource::kEmptyPollInterval while the
+// buffer is empty. Time is simulated, so a run takes a fraction of a second
+// regardless of the stream duration.
+//
+// Build it with a host compiler, e.g. (Samsung WASM headers are shipped with
+// Emscripten SDK with Samsung extensions):
+//   g++ -std=gnu++14 -I../src -I<path to Samsung WASM headers>
+//       jitter_simulator.cc ../src/jitter_buffer.cc -o jitter_simulator
+//
+// Usage:
+//   jitter_simulator [--jitter-ms=<mean jitter, default 20>]
+//                    [--base-delay-ms=<default 50>]
+//                    [--playout-delay-ms=<default 100>]
+//                    [--max-packets=<default 256>]
+//                    [--fps=<default 60>]
+//                    [--duration-s=<default 600>]
+//                    [--seed=<default 1>]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "jitter_buffer.h"
+
+namespace {
+
+using Clock = JitterBuffer::Clock;
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+struct Options {
+  double jitter_ms = 20.;
+  double base_delay_ms = 50.;
+  double playout_delay_ms = 100.;
+  double max_packets = 256.;
+  double fps = 60.;
+  double duration_s = 600.;
+  double seed = 1.;
+};  // struct Options
+
+struct Arrival {
+  Clock::time_point arrival_time;
+  size_t frame_idx;
+};  // struct Arrival
+
+// Parses --name=value arguments. Returns false on an unknown argument.
+bool ParseOptions(int argc, char* argv[], Options* options) {
+  const struct {
+    const char* name;
+    double* value;
+  } kFlags[] = {
+      {"--jitter-ms=", &options->jitter_ms},
+      {"--base-delay-ms=", &options->base_delay_ms},
+      {"--playout-delay-ms=", &options->playout_delay_ms},
+      {"--max-packets=", &options->max_packets},
+      {"--fps=", &options->fps},
+      {"--duration-s=", &options->duration_s},
+      {"--seed=", &options->seed},
+  };
+  for (int arg_idx = 1; arg_idx < argc; ++arg_idx) {
+    bool parsed = false;
+    for (const auto& flag : kFlags) {
+      const auto name_length = std::strlen(flag.name);
+      if (std::strncmp(argv[arg_idx], flag.name, name_length) == 0) {
+        *flag.value = std::atof(argv[arg_idx] + name_length);
+        parsed = true;
+        break;
+      }
+    }
+    if (!parsed) {
+      std::cout << "Unknown argument: " << argv[arg_idx] << std::endl;
+      return false;
+    }
+  }
+  return options->fps > 0.;
+}
+
+Clock::duration ToClockDuration(Milliseconds duration) {
+  return std::chrono::duration_cast<Clock::duration>(duration);
+}
+
+// Returns the given percentile of sorted values.
+double Percentile(const std::vector<double>& sorted_values, double percentile) {
+  if (sorted_values.empty())
+    return 0.;
+  const auto idx = static_cast<size_t>(percentile / 100. *
+                                       (sorted_values.size() - 1) + 0.5);
+  return sorted_values[idx];
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    std::cout << "Usage: " << argv[0]
+              << " [--jitter-ms=N] [--base-delay-ms=N] [--playout-delay-ms=N]"
+                 " [--max-packets=N] [--fps=N] [--duration-s=N] [--seed=N]"
+              << std::endl;
+    return 1;
+  }
+
+  const auto frame_count =
+      static_cast<size_t>(options.duration_s * options.fps);
+  const auto frame_duration = JitterBuffer::Seconds{1. / options.fps};
+  // Stream starts at 0 on both the sender's and the simulated clock, so
+  // capture (glass) time of a frame equals its dts.
+  auto capture_time = [&](size_t frame_idx) {
+    return Clock::time_point{} +
+           std::chrono::duration_cast<Clock::duration>(frame_duration *
+                                                       frame_idx);
+  };
+
+  std::mt19937 generator{static_cast<std::mt19937::result_type>(options.seed)};
+  std::exponential_distribution<double> jitter_ms{
+      options.jitter_ms > 0. ? 1. / options.jitter_ms : 1.};
+  std::vector<Arrival> arrivals;
+  arrivals.reserve(frame_count);
+  for (size_t frame_idx = 0; frame_idx < frame_count; ++frame_idx) {
+    auto delay = Milliseconds{options.base_delay_ms};
+    if (options.jitter_ms > 0.)
+      delay += Milliseconds{jitter_ms(generator)};
+    arrivals.push_back({capture_time(frame_idx) + ToClockDuration(delay),
+                        frame_idx});
+  }
+  std::stable_sort(arrivals.begin(), arrivals.end(),
+                   [](const Arrival& lhs, const Arrival& rhs) {
+                     return lhs.arrival_time < rhs.arrival_time;
+                   });
+
+  JitterBuffer jitter_buffer{
+      {std::chrono::duration_cast<JitterBuffer::Seconds>(
+           Milliseconds{options.playout_delay_ms}),
+       static_cast<size_t>(options.max_packets)}};
+  std::vector<double> latencies_ms;
+  latencies_ms.reserve(frame_count);
+  size_t out_of_order_count = 0;
+  JitterBuffer::Seconds last_dts{-1.};
+  auto next_arrival = arrivals.cbegin();
+  auto now = Clock::time_point{};
+  while (next_arrival != arrivals.cend() || !jitter_buffer.IsEmpty()) {
+    for (; next_arrival != arrivals.cend() && next_arrival->arrival_time <= now;
+         ++next_arrival) {
+      DemuxedPacket packet;
+      packet.packet.dts = packet.packet.pts =
+          frame_duration * next_arrival->frame_idx;
+      packet.packet.duration = frame_duration;
+      jitter_buffer.Push(std::move(packet), next_arrival->arrival_time);
+    }
+    DemuxedPacket packet;
+    while (jitter_buffer.Pop(now, &packet)) {
+      if (packet.packet.dts <= last_dts)
+        ++out_of_order_count;
+      last_dts = packet.packet.dts;
+      const auto glass_time =
+          Clock::time_point{} +
+          std::chrono::duration_cast<Clock::duration>(packet.packet.dts);
+      latencies_ms.push_back(Milliseconds{now - glass_time}.count());
+    }
+    // Packets arriving until then don't wake the worker up earlier.
+    const auto next_release_time = jitter_buffer.GetNextReleaseTime();
+    now = next_release_time == Clock::time_point::max()
+              ? now + LivePacketSource::kEmptyPollInterval
+              : std::max(next_release_time, now + Clock::duration{1});
+  }
+
+  std::sort(latencies_ms.begin(), latencies_ms.end());
+  const auto stats = jitter_buffer.GetStats();
+  std::cout << "Frames: " << frame_count << ", appended: "
+            << stats.released_count << ", late (dropped): " << stats.late_count
+            << ", reordered: " << stats.reordered_count
+            << ", released early (overflow): " << stats.overflow_count
+            << ", appended out of order: " << out_of_order_count << std::endl;
+  std::cout << "Glass-to-append latency [ms]:"
+            << " p50 " << Percentile(latencies_ms, 50.)
+            << " p90 " << Percentile(latencies_ms, 90.)
+            << " p99 " << Percentile(latencies_ms, 99.)
+            << " p99.9 " << Percentile(latencies_ms, 99.9)
+            << " max " << (latencies_ms.empty() ? 0. : latencies_ms.back())
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,230 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//          *** Keyframe Lookup Benchmark ***
+//
+// Host tool that measures how long finding a keyframe to resume from after
+// a seek takes as content gets longer. It compares KeyframeIndex (see
+// src/packet_pump.h), which is built once when content loads and answers
+// lookups with a binary search, with a reverse linear scan over all packets
+// that seeks used before. Lookup results of both are checked against each
+// other, so a non-zero exit code means that the index is broken.
+//
+// Content is synthetic: frames at a constant frame rate with a keyframe
+// starting every GOP. Content durations start at a minute and grow 4 times
+// up to the given maximum.
+//
+// Build it with a host compiler, e.g. (Samsung WASM headers are shipped with
+// Emscripten SDK with Samsung extensions):
+//   g++ -std=gnu++14 -pthread -I../src -I<path to Samsung WASM headers>
+//       keyframe_lookup_benchmark.cc ../src/packet_pump.cc
+//       ../src/buffer_ahead_controller.cc ../src/futex.cc
+//       ../src/histogram.cc ../src/packet_source.cc
+//       ../src/pump_thread_pool.cc ../src/tracing.cc
+//       -o keyframe_lookup_benchmark
+//
+// Usage:
+//   keyframe_lookup_benchmark [--max-content-h=<default 4>]
+//                             [--fps=<default 30>]
+//                             [--gop=<frames per GOP, default 30>]
+//                             [--seeks=<per content duration, default 1000>]
+//                             [--seed=<default 1>]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "histogram.h"
+#include "packet_pump.h"
+#include "packet_source.h"
+
+namespace {
+
+using Seconds = PacketSource::Seconds;
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  double max_content_h = 4.;
+  double fps = 30.;
+  double gop = 30.;
+  double seeks = 1000.;
+  double seed = 1.;
+};  // struct Options
+
+// Parses --name=value arguments. Returns false on an unknown argument.
+bool ParseOptions(int argc, char* argv[], Options* options) {
+  const struct {
+    const char* name;
+    double* value;
+  } kFlags[] = {
+      {"--max-content-h=", &options->max_content_h},
+      {"--fps=", &options->fps},
+      {"--gop=", &options->gop},
+      {"--seeks=", &options->seeks},
+      {"--seed=", &options->seed},
+  };
+  for (int arg_idx = 1; arg_idx < argc; ++arg_idx) {
+    bool parsed = false;
+    for (const auto& flag : kFlags) {
+      const auto name_length = std::strlen(flag.name);
+      if (std::strncmp(argv[arg_idx], flag.name, name_length) == 0) {
+        *flag.value = std::atof(argv[arg_idx] + name_length);
+        parsed = true;
+        break;
+      }
+    }
+    if (!parsed) {
+      std::cout << "Unknown argument: " << argv[arg_idx] << std::endl;
+      return false;
+    }
+  }
+  return options->max_content_h > 0. && options->fps > 0. &&
+         options->gop >= 1. && options->seeks >= 1.;
+}
+
+// Packets without payloads, held in memory like sample_data::kVideoPackets.
+class SyntheticPacketSource : public PacketSource {
+ public:
+  SyntheticPacketSource(size_t packet_count, double fps, size_t gop)
+      : duration_(packet_count / fps) {
+    packets_.reserve(packet_count);
+    for (size_t packet_idx = 0; packet_idx < packet_count; ++packet_idx) {
+      ElementaryMediaPacket packet{};
+      packet.pts = packet.dts = Seconds{packet_idx / fps};
+      packet.duration = Seconds{1. / fps};
+      packet.is_key_frame = packet_idx % gop == 0;
+      packets_.push_back(packet);
+    }
+  }
+
+  Seconds GetDuration() const override { return duration_; }
+
+  const ElementaryVideoTrackConfig& GetVideoTrackConfig() const override {
+    return video_track_config_;
+  }
+
+  size_t GetPacketCount() const override { return packets_.size(); }
+
+  void FillPacket(size_t index, ElementaryMediaPacket* packet) const override {
+    *packet = packets_[index];
+  }
+
+  // Lookup used by seeks before KeyframeIndex.
+  size_t FindClosestKeyframeLinearly(Seconds time) const {
+    auto keyframe = std::find_if(packets_.crbegin(), packets_.crend(),
+                                 [time](const auto& packet) {
+                                   return packet.is_key_frame &&
+                                          packet.pts < time;
+                                 });
+    if (keyframe == packets_.crend())
+      return 0;
+    return &(*keyframe) - packets_.data();
+  }
+
+ private:
+  Seconds duration_;
+  std::vector<ElementaryMediaPacket> packets_;
+  ElementaryVideoTrackConfig video_track_config_;
+};  // class SyntheticPacketSource
+
+uint64_t GetNanosecondsSince(Clock::time_point start) {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                           start)
+          .count());
+}
+
+void PrintPercentiles(const char* name, const Histogram& histogram) {
+  std::cout << name << " p50 " << histogram.GetPercentile(50.)
+            << " p99 " << histogram.GetPercentile(99.) << " max "
+            << histogram.GetMax();
+}
+
+// Returns false if lookups of the index and of the linear scan differ.
+bool RunLookups(Seconds content_duration,
+                const Options& options,
+                std::mt19937* generator) {
+  const auto packet_count =
+      static_cast<size_t>(content_duration.count() * options.fps);
+  const SyntheticPacketSource source{packet_count, options.fps,
+                                     static_cast<size_t>(options.gop)};
+
+  const auto build_start = Clock::now();
+  const KeyframeIndex keyframe_index{source};
+  const auto build_ns = GetNanosecondsSince(build_start);
+
+  std::uniform_real_distribution<double> seek_time{0.,
+                                                   content_duration.count()};
+  Histogram index_ns;
+  Histogram linear_ns;
+  bool results_match = true;
+  const auto seeks = static_cast<uint64_t>(options.seeks);
+  for (uint64_t seek_idx = 0; seek_idx < seeks; ++seek_idx) {
+    const Seconds time{seek_time(*generator)};
+
+    auto lookup_start = Clock::now();
+    const auto index_result = keyframe_index.GetClosestKeyframeIndex(time);
+    index_ns.Record(GetNanosecondsSince(lookup_start));
+
+    lookup_start = Clock::now();
+    const auto linear_result = source.FindClosestKeyframeLinearly(time);
+    linear_ns.Record(GetNanosecondsSince(lookup_start));
+
+    results_match = results_match && index_result == linear_result;
+  }
+
+  std::cout << content_duration.count() / 60. << " min, " << packet_count
+            << " packets: index built in " << build_ns / 1000000. << "ms";
+  PrintPercentiles(", index lookup [ns]:", index_ns);
+  PrintPercentiles(", linear scan [ns]:", linear_ns);
+  std::cout << std::endl;
+  if (!results_match)
+    std::cout << "Index and linear scan found different keyframes!"
+              << std::endl;
+  return results_match;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    std::cout << "Usage: " << argv[0]
+              << " [--max-content-h=N] [--fps=N] [--gop=N] [--seeks=N]"
+              << " [--seed=N]" << std::endl;
+    return 1;
+  }
+
+  std::mt19937 generator{static_cast<std::mt19937::result_type>(options.seed)};
+  const Seconds max_content_duration{options.max_content_h * 3600.};
+  bool results_match = true;
+  for (Seconds content_duration{60.};
+       content_duration <= max_content_duration; content_duration *= 4.) {
+    results_match =
+        RunLookups(content_duration, options, &generator) && results_match;
+  }
+  return results_match ? 0 : 1;
+}
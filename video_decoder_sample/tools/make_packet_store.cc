@@ -0,0 +1,118 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//          *** Packet Store Conversion Tool ***
+//
+// Host tool that converts packets hardcoded in sample_data.h into a packet
+// store file (see src/packet_store.h), which can be preloaded into the WASM
+// module's file system instead of linking sample data into the module.
+//
+// Build it with a host compiler, e.g. (Samsung WASM headers are shipped with
+// Emscripten SDK with Samsung extensions):
+//   g++ -std=gnu++14 -I../src -I<path to Samsung WASM headers>
+//       make_packet_store.cc ../src/sample_data.cc -o make_packet_store
+//
+// Usage:
+//   make_packet_store <output file>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "packet_store.h"
+#include "sample_data.h"
+
+namespace {
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc != 2) {
+    std::cout << "Usage: " << argv[0] << " <output file>" << std::endl;
+    return 1;
+  }
+
+  const auto& config = sample_data::kVideoTrackConfig;
+  const auto& packets = sample_data::kVideoPackets;
+
+  packet_store::FileHeader header{};
+  if (config.mimeType.size() >= packet_store::kMaxMimeTypeLength) {
+    std::cout << "Mime type is too long: " << config.mimeType << std::endl;
+    return 1;
+  }
+  std::memcpy(header.magic, packet_store::kMagic, sizeof(header.magic));
+  header.version = packet_store::kVersion;
+  header.packet_count = packets.size();
+  header.extradata_size = config.extradata.size();
+  header.duration = sample_data::kStreamDuration.count();
+  std::strncpy(header.mime_type, config.mimeType.c_str(),
+               packet_store::kMaxMimeTypeLength - 1);
+  header.width = config.width;
+  header.height = config.height;
+  header.framerate_num = config.framerate_num;
+  header.framerate_den = config.framerate_den;
+
+  std::vector<packet_store::PacketEntry> table;
+  table.reserve(packets.size());
+  uint64_t payload_size = 0;
+  for (const auto& packet : packets) {
+    packet_store::PacketEntry entry{};
+    entry.pts = packet.pts.count();
+    entry.dts = packet.dts.count();
+    entry.duration = packet.duration.count();
+    entry.payload_offset = payload_size;
+    entry.payload_size = packet.size;
+    entry.flags = packet.is_key_frame ? packet_store::kKeyFrameFlag : 0;
+    table.push_back(entry);
+    payload_size += packet.size;
+  }
+
+  header.packet_table_offset =
+      AlignUp(sizeof(header), alignof(packet_store::PacketEntry));
+  header.extradata_offset =
+      header.packet_table_offset + table.size() * sizeof(table[0]);
+  header.payload_offset = header.extradata_offset + header.extradata_size;
+  header.payload_size = payload_size;
+
+  std::ofstream output{argv[1], std::ios::binary | std::ios::trunc};
+  output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  output.seekp(header.packet_table_offset);
+  output.write(reinterpret_cast<const char*>(table.data()),
+               table.size() * sizeof(table[0]));
+  output.write(reinterpret_cast<const char*>(config.extradata.data()),
+               config.extradata.size());
+  for (const auto& packet : packets)
+    output.write(static_cast<const char*>(packet.data), packet.size);
+
+  if (!output) {
+    std::cout << "Cannot write " << argv[1] << std::endl;
+    return 1;
+  }
+  std::cout << "Wrote " << packets.size() << " packets to " << argv[1]
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,197 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//          *** Start Code Scan Benchmark ***
+//
+// Host tool that measures scan throughput of FindStartCode() (see
+// src/annexb_packetizer.h), which uses SSE2, NEON or WASM SIMD when the build
+// targets them, against its scalar baseline FindStartCodeScalar(). A buffer of
+// slice-like data with a 00 00 01 start code every so often is scanned from
+// start code to start code, like AnnexBPacketizer does. Positions found by
+// both are checked against each other, so a non-zero exit code means that the
+// SIMD search is broken.
+//
+// Build it with a host compiler, e.g. (Samsung WASM headers are shipped with
+// Emscripten SDK with Samsung extensions):
+//   g++ -std=gnu++14 -O2 -I../src -I<path to Samsung WASM headers>
+//       start_code_benchmark.cc ../src/annexb_packetizer.cc
+//       ../src/packet_source.cc -o start_code_benchmark
+//
+// Usage:
+//   start_code_benchmark [--size-mb=<scanned buffer, default 64>]
+//                        [--nal-kb=<average distance between start codes,
+//                                  default 16>]
+//                        [--repeat=<scans per search, default 10>]
+//                        [--seed=<default 1>]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "annexb_packetizer.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  double size_mb = 64.;
+  double nal_kb = 16.;
+  double repeat = 10.;
+  double seed = 1.;
+};  // struct Options
+
+// Parses --name=value arguments. Returns false on an unknown argument.
+bool ParseOptions(int argc, char* argv[], Options* options) {
+  const struct {
+    const char* name;
+    double* value;
+  } kFlags[] = {
+      {"--size-mb=", &options->size_mb},
+      {"--nal-kb=", &options->nal_kb},
+      {"--repeat=", &options->repeat},
+      {"--seed=", &options->seed},
+  };
+  for (int arg_idx = 1; arg_idx < argc; ++arg_idx) {
+    bool parsed = false;
+    for (const auto& flag : kFlags) {
+      const auto name_length = std::strlen(flag.name);
+      if (std::strncmp(argv[arg_idx], flag.name, name_length) == 0) {
+        *flag.value = std::atof(argv[arg_idx] + name_length);
+        parsed = true;
+        break;
+      }
+    }
+    if (!parsed) {
+      std::cout << "Unknown argument: " << argv[arg_idx] << std::endl;
+      return false;
+    }
+  }
+  return options->size_mb > 0. && options->nal_kb > 0. &&
+         options->repeat >= 1.;
+}
+
+const char* GetSimdName() {
+#if defined(__wasm_simd128__)
+  return "WASM SIMD";
+#elif defined(__SSE2__)
+  return "SSE2";
+#elif defined(__ARM_NEON)
+  return "NEON";
+#else
+  return "none, scalar fallback";
+#endif
+}
+
+// Random bytes, as entropy coded slice data looks, with emulation prevention
+// applied (no 00 00 0x with x <= 3) and a start code at random distances.
+std::vector<uint8_t> MakeStream(const Options& options,
+                                std::mt19937* generator) {
+  const auto size = static_cast<size_t>(options.size_mb * 1024. * 1024.);
+  std::uniform_int_distribution<int> byte{0, 255};
+  std::exponential_distribution<double> nal_size{1. /
+                                                 (options.nal_kb * 1024.)};
+  std::vector<uint8_t> stream;
+  stream.reserve(size + 4);
+  while (stream.size() < size) {
+    stream.insert(stream.end(), {0, 0, 1});
+    const auto nal_end =
+        stream.size() + static_cast<size_t>(nal_size(*generator)) + 1;
+    while (stream.size() < nal_end) {
+      auto value = static_cast<uint8_t>(byte(*generator));
+      const auto stream_size = stream.size();
+      if (value <= 3 && stream_size >= 2 && stream[stream_size - 1] == 0 &&
+          stream[stream_size - 2] == 0) {
+        stream.push_back(3);
+      }
+      stream.push_back(value);
+    }
+  }
+  return stream;
+}
+
+// Returns positions of all start codes found by search.
+template <typename Search>
+std::vector<size_t> Scan(const std::vector<uint8_t>& stream, Search search) {
+  std::vector<size_t> positions;
+  const auto* begin = stream.data();
+  const auto* end = begin + stream.size();
+  for (auto* start_code = search(begin, end); start_code != end;
+       start_code = search(start_code + 3, end)) {
+    positions.push_back(static_cast<size_t>(start_code - begin));
+  }
+  return positions;
+}
+
+// Returns false if the search found other start codes than expected.
+template <typename Search>
+bool RunBenchmark(const char* name,
+                  const std::vector<uint8_t>& stream,
+                  const std::vector<size_t>& expected,
+                  const Options& options,
+                  Search search) {
+  auto best_time = Clock::duration::max();
+  bool matches = true;
+  for (int run = 0; run < static_cast<int>(options.repeat); ++run) {
+    const auto start = Clock::now();
+    const auto positions = Scan(stream, search);
+    const auto time = Clock::now() - start;
+    if (time < best_time)
+      best_time = time;
+    matches = matches && positions == expected;
+  }
+  const auto seconds = std::chrono::duration<double>(best_time).count();
+  std::cout << name << ": " << seconds * 1e3 << "ms, "
+            << stream.size() / 1e9 / seconds << " GB/s" << std::endl;
+  if (!matches)
+    std::cout << name << " found other start codes than expected!"
+              << std::endl;
+  return matches;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    std::cout << "Usage: " << argv[0]
+              << " [--size-mb=N] [--nal-kb=N] [--repeat=N] [--seed=N]"
+              << std::endl;
+    return 1;
+  }
+
+  std::mt19937 generator{static_cast<std::mt19937::result_type>(options.seed)};
+  const auto stream = MakeStream(options, &generator);
+  const auto expected = Scan(stream, FindStartCodeScalar);
+  std::cout << stream.size() / 1e6 << " MB, " << expected.size()
+            << " start codes, SIMD: " << GetSimdName() << std::endl;
+
+  bool matches = RunBenchmark("FindStartCodeScalar", stream, expected,
+                              options, FindStartCodeScalar);
+  matches =
+      RunBenchmark("FindStartCode", stream, expected, options, FindStartCode) &&
+      matches;
+  return matches ? 0 : 1;
+}
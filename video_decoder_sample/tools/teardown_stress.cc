@@ -0,0 +1,266 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//          *** Teardown Stress Test ***
+//
+// Host tool that creates and destroys PacketPumps in a loop, in every
+// WorkerMode, and reports how long PacketPump::Terminate() takes and how much
+// CPU time the calling (main) thread spends in it. Channel switching and
+// multi-view layouts tear pumps down while they work, so teardown should be
+// quick and must not burn the main thread.
+//
+// Every pump plays either a complete in-memory stream or a live stream with
+// packets held by a JitterBuffer, so that a wake-up is pending. Pumps are torn
+// down at random points: right after the track opens, after a position
+// update, after a seek or after a random delay, so that races between
+// Terminate() and pool threads running the pump are exercised. Build it with
+// -fsanitize=address or -fsanitize=thread to catch them.
+//
+// Build it with a host compiler, e.g. (Samsung WASM headers are shipped with
+// Emscripten SDK with Samsung extensions):
+//   g++ -std=gnu++14 -pthread -I../src -I<path to Samsung WASM headers>
+//       teardown_stress.cc ../src/packet_pump.cc ../src/jitter_buffer.cc
+//       ../src/simulated_decoder_sink.cc ../src/buffer_ahead_controller.cc
+//       ../src/futex.cc ../src/histogram.cc ../src/packet_source.cc
+//       ../src/pump_thread_pool.cc ../src/tracing.cc -o teardown_stress
+//
+// Usage:
+//   teardown_stress [--iterations=<pumps per worker mode, default 10000>]
+//                   [--pool-threads=<default 2>]
+//                   [--seed=<default 1>]
+
+#include <time.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "histogram.h"
+#include "jitter_buffer.h"
+#include "packet_pump.h"
+#include "pump_thread_pool.h"
+#include "simulated_decoder_sink.h"
+
+namespace {
+
+using Seconds = PacketPump::Seconds;
+using WallClock = std::chrono::steady_clock;
+using WorkerMode = PacketPump::WorkerMode;
+
+constexpr double kFps = 30.;
+constexpr size_t kGop = 30;
+constexpr size_t kFrameCount = 300;
+constexpr size_t kFrameSize = 16 * 1024;
+// Live packets pushed to a pump's source before it's torn down, released
+// over about a second.
+constexpr size_t kLiveFrameCount = 30;
+
+struct Options {
+  double iterations = 10000.;
+  double pool_threads = 2.;
+  double seed = 1.;
+};  // struct Options
+
+// Parses --name=value arguments. Returns false on an unknown argument.
+bool ParseOptions(int argc, char* argv[], Options* options) {
+  const struct {
+    const char* name;
+    double* value;
+  } kFlags[] = {
+      {"--iterations=", &options->iterations},
+      {"--pool-threads=", &options->pool_threads},
+      {"--seed=", &options->seed},
+  };
+  for (int arg_idx = 1; arg_idx < argc; ++arg_idx) {
+    bool parsed = false;
+    for (const auto& flag : kFlags) {
+      const auto name_length = std::strlen(flag.name);
+      if (std::strncmp(argv[arg_idx], flag.name, name_length) == 0) {
+        *flag.value = std::atof(argv[arg_idx] + name_length);
+        parsed = true;
+        break;
+      }
+    }
+    if (!parsed) {
+      std::cout << "Unknown argument: " << argv[arg_idx] << std::endl;
+      return false;
+    }
+  }
+  return options->iterations >= 1. && options->pool_threads >= 1.;
+}
+
+// Complete stream held in memory. All packets share a single payload buffer.
+class InMemoryPacketSource : public PacketSource {
+ public:
+  InMemoryPacketSource() : payload_(kFrameSize) {}
+
+  Seconds GetDuration() const override {
+    return Seconds{kFrameCount / kFps};
+  }
+
+  const ElementaryVideoTrackConfig& GetVideoTrackConfig() const override {
+    return video_track_config_;
+  }
+
+  size_t GetPacketCount() const override { return kFrameCount; }
+
+  void FillPacket(size_t index, ElementaryMediaPacket* packet) const override {
+    *packet = {};
+    packet->pts = packet->dts = Seconds{index / kFps};
+    packet->duration = Seconds{1. / kFps};
+    packet->is_key_frame = index % kGop == 0;
+    packet->size = payload_.size();
+    packet->data = payload_.data();
+  }
+
+ private:
+  std::vector<uint8_t> payload_;
+  ElementaryVideoTrackConfig video_track_config_;
+};  // class InMemoryPacketSource
+
+std::shared_ptr<PacketSource> MakeLiveSource() {
+  auto source = std::make_shared<LivePacketSource>(
+      samsung::wasm::ElementaryVideoTrackConfig{},
+      JitterBuffer::Config{std::chrono::milliseconds{50}, 256});
+  // All packets arrive at once, so they are released at the pace of their
+  // dts and the pump keeps a wake-up scheduled.
+  for (size_t frame_idx = 0; frame_idx < kLiveFrameCount; ++frame_idx) {
+    DemuxedPacket packet;
+    packet.packet.pts = packet.packet.dts = Seconds{frame_idx / kFps};
+    packet.packet.duration = Seconds{1. / kFps};
+    packet.packet.is_key_frame = frame_idx % kGop == 0;
+    packet.data.resize(kFrameSize);
+    packet.packet.size = packet.data.size();
+    source->Push(std::move(packet));
+  }
+  return source;
+}
+
+std::chrono::nanoseconds GetThreadCpuTime() {
+  timespec time{};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+  return std::chrono::seconds{time.tv_sec} +
+         std::chrono::nanoseconds{time.tv_nsec};
+}
+
+const char* GetModeName(WorkerMode worker_mode) {
+  switch (worker_mode) {
+    case WorkerMode::kOwnThread:
+      return "kOwnThread";
+    case WorkerMode::kThreadPool:
+      return "kThreadPool";
+    case WorkerMode::kMainLoop:
+      return "kMainLoop";
+  }
+  return "";
+}
+
+void PrintPercentiles(const char* name, const Histogram& histogram) {
+  std::cout << name << " p50 " << histogram.GetPercentile(50.)
+            << " p99 " << histogram.GetPercentile(99.) << " max "
+            << histogram.GetMax();
+}
+
+void RunStress(WorkerMode worker_mode,
+               const Options& options,
+               PumpThreadPool* thread_pool,
+               std::mt19937* generator) {
+  const auto in_memory_source = std::make_shared<InMemoryPacketSource>();
+  std::uniform_int_distribution<int> action{0, 3};
+  std::uniform_int_distribution<int> delay_us{0, 200};
+  Histogram terminate_us;
+  Histogram terminate_cpu_us;
+
+  const auto start = WallClock::now();
+  const auto iterations = static_cast<uint64_t>(options.iterations);
+  for (uint64_t iteration = 0; iteration < iterations; ++iteration) {
+    std::vector<PacketPump::Track> tracks;
+    tracks.push_back({std::make_unique<SimulatedDecoderSink>(),
+                      iteration % 2 ? MakeLiveSource() : in_memory_source});
+    auto pump = std::make_unique<PacketPump>(
+        std::move(tracks),
+        PacketPump::BufferPolicy{PacketPump::kLowLatencyBufferAhead,
+                                 PacketPump::kMaxBufferedBytes,
+                                 PacketPump::kMaxTrackSkew},
+        worker_mode, thread_pool);
+    pump->OnTrackOpen();
+    switch (action(*generator)) {
+      case 0:
+        break;
+      case 1:
+        pump->UpdateTime(Seconds{1.});
+        break;
+      case 2:
+        pump->OnTrackClosed();
+        pump->OnSeek(Seconds{5.});
+        pump->OnTrackOpen();
+        break;
+      case 3:
+        std::this_thread::sleep_for(
+            std::chrono::microseconds{delay_us(*generator)});
+        break;
+    }
+    if (worker_mode == WorkerMode::kMainLoop)
+      pump->RunSlice(PacketPump::kSliceBudget);
+
+    const auto cpu_start = GetThreadCpuTime();
+    const auto terminate_time = pump->Terminate();
+    terminate_cpu_us.Record(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            GetThreadCpuTime() - cpu_start)
+            .count()));
+    terminate_us.Record(static_cast<uint64_t>(terminate_time.count() * 1e6));
+  }
+  const auto wall_time =
+      std::chrono::duration_cast<Seconds>(WallClock::now() - start);
+
+  std::cout << GetModeName(worker_mode) << ": " << iterations
+            << " pumps in " << wall_time.count() << "s, Terminate() [us]:";
+  PrintPercentiles("", terminate_us);
+  PrintPercentiles(", main thread CPU [us]:", terminate_cpu_us);
+  std::cout << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    std::cout << "Usage: " << argv[0]
+              << " [--iterations=N] [--pool-threads=N] [--seed=N]"
+              << std::endl;
+    return 1;
+  }
+
+  std::mt19937 generator{static_cast<std::mt19937::result_type>(options.seed)};
+  PumpThreadPool thread_pool{static_cast<size_t>(options.pool_threads)};
+  RunStress(WorkerMode::kOwnThread, options, nullptr, &generator);
+  RunStress(WorkerMode::kThreadPool, options, &thread_pool, &generator);
+  RunStress(WorkerMode::kMainLoop, options, nullptr, &generator);
+  return 0;
+}
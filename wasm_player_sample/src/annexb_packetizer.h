@@ -0,0 +1,144 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef WASM_PLAYER_SAMPLE_ANNEXB_PACKETIZER_H
+#define WASM_PLAYER_SAMPLE_ANNEXB_PACKETIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <samsung/wasm/elementary_media_packet.h>
+#include <samsung/wasm/elementary_video_track_config.h>
+
+#include "packet_source.h"
+
+// Returns a pointer to the first byte of the first 00 00 01 start code in
+// [begin, end) or end if there is none.
+//
+// Uses SSE2, NEON or WASM SIMD when available (i.e. when the module is built
+// with -msimd128), otherwise falls back to a scalar search.
+const uint8_t* FindStartCode(const uint8_t* begin, const uint8_t* end);
+
+// Scalar implementation of FindStartCode(), exposed as a baseline.
+const uint8_t* FindStartCodeScalar(const uint8_t* begin, const uint8_t* end);
+
+// Splits an H.264 or HEVC elementary stream in Annex-B format into access
+// units and turns them into Elementary Media Packets.
+//
+// Data can be appended in chunks of any size. Packets are marked as keyframes
+// when they contain an IDR (H.264) or IRAP (HEVC) picture. A raw elementary
+// stream carries no timestamps, so packets are timestamped in decoding order
+// with the frame rate from the track config. Streams that reorder frames need
+// timestamps from a container.
+class AnnexBPacketizer {
+ public:
+  using ElementaryMediaPacket = samsung::wasm::ElementaryMediaPacket;
+  using ElementaryVideoTrackConfig = samsung::wasm::ElementaryVideoTrackConfig;
+  using Seconds = samsung::wasm::Seconds;
+
+  enum class Codec { kH264, kHevc };
+
+  AnnexBPacketizer(Codec codec, const ElementaryVideoTrackConfig& config);
+
+  void Append(const uint8_t* data, size_t size);
+
+  // Packetizes data buffered at the end of a stream.
+  void Flush();
+
+  // Returns false if there are no packets available.
+  bool PopPacket(DemuxedPacket* packet);
+
+  // Drops buffered data and packets, so that data appended next is split as
+  // if it started at the given stream offset, which must be
+  // DemuxedPacket::resume_offset of a packet produced earlier (i.e. the first
+  // NAL unit of a keyframe). pts is pts of that packet.
+  void ResumeAt(uint64_t offset, Seconds pts);
+
+ private:
+  // offset is the stream offset of the NAL unit's start code.
+  void ProcessNalUnit(const uint8_t* nal_unit, size_t size, uint64_t offset);
+  bool StartsAccessUnit(const uint8_t* nal_unit, size_t size) const;
+  bool IsKeyFrame(const uint8_t* nal_unit) const;
+  bool IsVcl(const uint8_t* nal_unit) const;
+  void EmitAccessUnit();
+
+  const Codec codec_;
+  const ElementaryVideoTrackConfig config_;
+  const Seconds frame_duration_;
+
+  // Data appended, but not split into NAL units yet. It always begins with
+  // a start code (unless nothing was found yet). buffer_offset_ is position of
+  // its first byte in the stream.
+  std::vector<uint8_t> buffer_;
+  uint64_t buffer_offset_{0};
+  // Position in buffer_ to continue looking for a start code from.
+  size_t scan_position_{0};
+  bool found_start_code_{false};
+
+  // Access unit being assembled.
+  std::vector<uint8_t> access_unit_;
+  // Stream offset of the first NAL unit of access_unit_.
+  uint64_t access_unit_offset_{0};
+  bool access_unit_has_vcl_{false};
+  bool access_unit_is_key_frame_{false};
+  uint64_t frame_count_{0};
+
+  std::deque<DemuxedPacket> packets_;
+};  // class AnnexBPacketizer
+
+// Serves packets packetized from a local H.264 or HEVC elementary stream file.
+// Since raw elementary streams carry no container metadata, track config must
+// be provided by the application.
+class AnnexBFileSource : public StreamingFileSource {
+ public:
+  using Codec = AnnexBPacketizer::Codec;
+
+  // Returns nullptr if the file can't be opened.
+  static std::unique_ptr<AnnexBFileSource> Open(
+      const std::string& path,
+      Codec codec,
+      const ElementaryVideoTrackConfig& config,
+      Seconds duration);
+
+  Seconds GetDuration() const override;
+  const ElementaryVideoTrackConfig& GetVideoTrackConfig() const override;
+
+ protected:
+  bool ProcessChunk(const uint8_t* data, size_t size) override;
+  void ResumeAt(uint64_t offset,
+                const ElementaryMediaPacket& first_packet) override;
+
+ private:
+  AnnexBFileSource(std::FILE* file,
+                   Codec codec,
+                   const ElementaryVideoTrackConfig& config,
+                   Seconds duration);
+
+  AnnexBPacketizer packetizer_;
+  const ElementaryVideoTrackConfig config_;
+  const Seconds duration_;
+};  // class AnnexBFileSource
+
+#endif  // WASM_PLAYER_SAMPLE_ANNEXB_PACKETIZER_H
@@ -24,49 +24,78 @@
 // This file contains sample implementation of a simple WASM module that plays
 // media content with Tizen WASM Player using HTMLMediaElement with
 // ElementaryMediaStreamSource as a data source. The sample uses hardcoded data
-// (see sample_data.h).
+// (see sample_data.h) or a packet store file (see packet_store.h).
 
 #ifndef WASM_PLAYER_SAMPLE_EMSS_SDF_SAMPLE_H
 #define WASM_PLAYER_SAMPLE_EMSS_SDF_SAMPLE_H
 
-#include <condition_variable>
+#include <chrono>
 #include <memory>
-#include <mutex>
-#include <queue>
-#include <thread>
+#include <vector>
 
 #include <samsung/html/html_media_element.h>
 #include <samsung/html/html_media_element_listener.h>
+#include <samsung/wasm/elementary_media_packet.h>
 #include <samsung/wasm/elementary_media_stream_source.h>
 #include <samsung/wasm/elementary_media_stream_source_listener.h>
 #include <samsung/wasm/elementary_media_track.h>
 #include <samsung/wasm/elementary_media_track_listener.h>
 
+#include "packet_pump.h"
+#include "packet_source.h"
+#include "pump_thread_pool.h"
+
+// Appends packets to an ElementaryMediaTrack it owns.
+class ElementaryMediaTrackSink : public PacketSink {
+ public:
+  using ElementaryMediaTrack = samsung::wasm::ElementaryMediaTrack;
+
+  explicit ElementaryMediaTrackSink(ElementaryMediaTrack track);
+
+  void AppendPacket(const ElementaryMediaPacket& packet) override;
+  void AppendEndOfTrack(SessionId session_id) override;
+
+  ElementaryMediaTrack& GetTrack();
+
+ private:
+  ElementaryMediaTrack track_;
+};  // class ElementaryMediaTrackSink
+
 // This class is responsible for sending elementary media data to Elementary
-// Media Stream Source via ElementaryMediaTrack object.
-class TrackDataPump : public samsung::wasm::ElementaryMediaTrackListener {
+// Media Stream Source via ElementaryMediaTrack objects.
+//
+// Buffering is done by PacketPump, which appends packets to tracks through
+// ElementaryMediaTrackSinks; this class forwards track events to it.
+class TrackDataPump : public PacketPump,
+                      public samsung::wasm::ElementaryMediaTrackListener {
  public:
   using ElementaryMediaTrack = samsung::wasm::ElementaryMediaTrack;
   using Seconds = samsung::wasm::Seconds;
   using SessionId = samsung::wasm::SessionId;
 
-  // Controls how many packets should be buffered ahead of a current playback
-  // position.
-  static constexpr Seconds kBufferAhead = Seconds{3.};
+  // A track fed by the pump along with a source of its packets.
+  struct Track {
+    ElementaryMediaTrack track;
+    std::shared_ptr<PacketSource> packet_source;
+  };  // struct Track
 
-  // Worker thread will be notified about advancing playback position every
-  // kWorkerUpdateThreshold.
-  static constexpr Seconds kWorkerUpdateThreshold = Seconds{0.5};
+  TrackDataPump(ElementaryMediaTrack video_track,
+                std::shared_ptr<PacketSource> packet_source);
 
-  explicit TrackDataPump(ElementaryMediaTrack video_track);
+  TrackDataPump(ElementaryMediaTrack video_track,
+                std::shared_ptr<PacketSource> packet_source,
+                BufferPolicy buffer_policy);
 
-  ~TrackDataPump() override;
+  // The first track is expected to be the video track. thread_pool is used
+  // only in WorkerMode::kThreadPool and must outlive the pump.
+  TrackDataPump(std::vector<Track> tracks,
+                BufferPolicy buffer_policy,
+                WorkerMode worker_mode = kDefaultWorkerMode,
+                PumpThreadPool* thread_pool = nullptr);
 
-  // Notify pump about stream running time, so that elementary media data can be
-  // buffered up to (new_time + kBufferAhead).
-  void UpdateTime(Seconds new_time);
+  ~TrackDataPump() override = default;
 
-  // samsung::wasm::ElementaryMediaStreamSourceListener interface //////////////
+  // samsung::wasm::ElementaryMediaTrackListener interface ////////////////////
 
   // Indicates ElementaryMediaTrack is ready to accept data.
   void OnTrackOpen() override;
@@ -74,67 +103,19 @@ class TrackDataPump : public samsung::wasm::ElementaryMediaTrackListener {
   // Indicates ElementaryMediaTrack can't accept data.
   void OnTrackClosed(ElementaryMediaTrack::CloseReason) override;
 
-  // Track is being seeked.
-  //
-  // This happens only when track is closed. When it will open data provider
-  // should send elementary media data starting from a keyframe closest to the
-  // new_time.
+  // Track is being seeked (see PacketPump::OnSeek()).
   void OnSeek(Seconds new_time) override;
 
   // Session id changed: stamp packets with a new session id from now on.
   void OnSessionIdChanged(SessionId session_id) override;
 
  protected:
-  ElementaryMediaTrack video_track_;
+  // Can be used on the main thread, e.g. to request decoded video frames.
+  ElementaryMediaTrack& GetVideoTrack();
 
  private:
-  // Naive implementation of main thread -> worker thread message queue:
-  class WorkerMessageQueue {
-   public:
-    struct Message {
-      enum class Type { kSetBufferToPts, kSeekTo, kTerminate };
-
-      Message(Type type, Seconds time, SessionId session_id);
-
-      Type type;
-      Seconds time;
-      SessionId session_id;
-    };  // struct Message
-
-    void Flush();
-    Message Pop();
-    void PushBufferToPts(Seconds time, SessionId session_id);
-    void PushSeekTo(Seconds time);
-    void PushTerminate();
-
-   private:
-    void FlushWhileLocked();
-
-    std::queue<Message> message_queue_;
-    std::condition_variable messages_changed_;
-    std::mutex messages_mutex_;
-  };  // class WorkerMessageQueue
-
-  WorkerMessageQueue messages_;
-
-  std::thread pump_worker_;
-
-  Seconds last_reported_running_time_;
-  SessionId session_id_;
-
-  // A first frame after Seek must always be a keyframe. This method finds a
-  // closest keyframe preceeding the given time in sample_data.
-  static size_t GetClosestKeyframeIndex(Seconds time);
-
-  // Sends packets to Source. Executes on a worker thread.
-  //
-  // This sample uses a simple, hard-coded media content. However, for a typical
-  // media application data processing will be more complicated and time
-  // consuming (e.g. it includes downloading data, demuxing containers, etc).
-  // Therefore processing of elementary media data on a side thread is advised,
-  // as it frees main thread (JS thread) and does not hinder application
-  // responsiveness.
-  void PumpPackets();
+  // Tracks owned by sinks of the pump, the video track comes first.
+  std::vector<ElementaryMediaTrack*> tracks_;
 };  // class TrackDataPump
 
 class SamplePlayer : public samsung::wasm::ElementaryMediaStreamSourceListener,
@@ -146,10 +127,62 @@ class SamplePlayer : public samsung::wasm::ElementaryMediaStreamSourceListener,
   using HTMLMediaElement = samsung::html::HTMLMediaElement;
   using Seconds = samsung::wasm::Seconds;
 
+  // Startup phases in the order they happen, as time since SetUp() was called
+  // measured with a monotonic clock. Phases that didn't happen yet are
+  // negative.
+  struct StartupTimes {
+    // OnSourceClosed(): source was attached to the media element.
+    Seconds source_closed;
+    // ElementaryMediaStreamSource::Open() completed.
+    Seconds source_open;
+    // The track opened, so the pump started buffering.
+    Seconds track_open;
+    // The first packet was appended.
+    Seconds first_append;
+    // OnCanPlay(): enough data was buffered to start playback.
+    Seconds can_play;
+    // OnPlaying(): playback started after HTMLMediaElement::Play().
+    Seconds playing;
+  };  // struct StartupTimes
+
   SamplePlayer() = default;
 
+  // Makes pumps append the first GOP before anything else (see
+  // TrackDataPump::SetFastStart()). Must be called before SetUp().
+  void SetFastStart(bool fast_start);
+
+  // Plays content from kPacketStorePath if such file exists. Otherwise falls
+  // back to packets hardcoded in sample_data.h.
   void SetUp(ElementaryMediaStreamSource::RenderingMode);
 
+  // Plays content of the given packet source. Live content (e.g. received by
+  // a LivePacketSource) should be played in kLowLatency mode, where buffering
+  // ahead is limited to a fraction of a second.
+  void SetUp(ElementaryMediaStreamSource::RenderingMode,
+             ElementaryMediaStreamSource::LatencyMode,
+             std::shared_ptr<PacketSource> packet_source);
+
+  // Runs TrackDataPump in WorkerMode::kMainLoop. Called on every iteration of
+  // the Emscripten main loop.
+  void OnMainLoopIteration();
+
+  // Prepares a standby channel for a fast switch (e.g. the next likely
+  // channel): its source is created and attached to a hidden media element
+  // and the first GOP of the given content is buffered by a second pump.
+  // Replaces a previously prepared standby channel.
+  void PrepareStandby(std::shared_ptr<PacketSource> packet_source);
+
+  // Tears the playing channel down and starts the standby one in its place.
+  // Returns false if no standby channel was prepared.
+  bool SwitchToStandby();
+
+  // Time between the most recent SwitchToStandby() and the first frame of the
+  // new channel being played. Zero until the first switch completes.
+  Seconds GetLastSwitchLatency() const;
+
+  // Describes startup of the content played by SetUp().
+  StartupTimes GetStartupTimes() const;
+
   // samsung::wasm::ElementaryMediaStreamSourceListener interface //
 
   // This event will be fired when ElementaryMediaStreamSource enters kClosed
@@ -165,16 +198,84 @@ class SamplePlayer : public samsung::wasm::ElementaryMediaStreamSourceListener,
   // playback.
   void OnCanPlay() override;
 
+  // Playback started, i.e. the first frame is being shown.
+  void OnPlaying() override;
+
  protected:
   virtual std::unique_ptr<TrackDataPump> CreateTrackDataPump(
-      ElementaryMediaTrack&& video_track);
+      ElementaryMediaTrack&& video_track,
+      std::shared_ptr<PacketSource> packet_source);
 
+  // Requests media_element_ to play. Called when the element is paused and
+  // enough data is buffered.
+  virtual void StartPlayback();
+
+  // Buffer policy of pumps matching the latency mode.
+  TrackDataPump::BufferPolicy GetBufferPolicy() const;
+
+  // Adds a video track of the content to a source in kClosed state and
+  // requests the source to open. Returns a pump feeding the track or nullptr
+  // on failure.
+  std::unique_ptr<TrackDataPump> OpenSource(
+      ElementaryMediaStreamSource* source,
+      std::shared_ptr<PacketSource> packet_source,
+      bool standby);
+
+  std::shared_ptr<PacketSource> packet_source_;
   std::unique_ptr<HTMLMediaElement> media_element_;
   std::unique_ptr<TrackDataPump> track_data_pump_;
 
   // Make sure source_ outlives media_element_ when they are associated with
   // HTMLMediaElement::SetSrc().
   std::unique_ptr<ElementaryMediaStreamSource> source_;
+
+ private:
+  // Channel prepared by PrepareStandby(). Handles events of its element and
+  // source until SwitchToStandby() hands them over to the player.
+  class StandbyChannel
+      : public samsung::wasm::ElementaryMediaStreamSourceListener,
+        public samsung::html::HTMLMediaElementListener {
+   public:
+    StandbyChannel(SamplePlayer* player,
+                   const char* video_tag_id,
+                   std::shared_ptr<PacketSource> packet_source);
+
+    void OnSourceClosed() override;
+    void OnCanPlay() override;
+
+    SamplePlayer* const player;
+    const char* const video_tag_id;
+    std::shared_ptr<PacketSource> packet_source;
+    std::unique_ptr<HTMLMediaElement> media_element;
+    std::unique_ptr<TrackDataPump> track_data_pump;
+    std::unique_ptr<ElementaryMediaStreamSource> source;
+    // Set once the first GOP is buffered.
+    bool can_play{false};
+  };  // class StandbyChannel
+
+  ElementaryMediaStreamSource::RenderingMode rendering_mode_;
+  ElementaryMediaStreamSource::LatencyMode latency_mode_;
+  // Id of the video tag media_element_ is bound to. Channels take turns using
+  // two video tags.
+  const char* video_tag_id_{nullptr};
+  std::unique_ptr<StandbyChannel> standby_;
+
+  bool fast_start_{false};
+
+  // Startup phases (see StartupTimes). Track phases are copied from the pump
+  // once playback starts, so that they outlive it.
+  std::chrono::steady_clock::time_point set_up_time_;
+  std::chrono::steady_clock::time_point source_closed_time_;
+  std::chrono::steady_clock::time_point source_open_time_;
+  std::chrono::steady_clock::time_point track_open_time_;
+  std::chrono::steady_clock::time_point first_append_time_;
+  std::chrono::steady_clock::time_point can_play_time_;
+  std::chrono::steady_clock::time_point playing_time_;
+
+  std::chrono::steady_clock::time_point switch_time_;
+  // Set while the first frame after a switch is yet to be shown.
+  bool switch_pending_{false};
+  Seconds last_switch_latency_{0};
 };  // class SimplePlayer
 
 #endif  // WASM_PLAYER_SAMPLE_EMSS_SDF_SAMPLE_H
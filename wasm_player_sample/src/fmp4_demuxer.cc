@@ -0,0 +1,697 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "fmp4_demuxer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+using ElementaryMediaPacket = samsung::wasm::ElementaryMediaPacket;
+using ElementaryVideoTrackConfig = samsung::wasm::ElementaryVideoTrackConfig;
+using Seconds = samsung::wasm::Seconds;
+
+namespace {
+
+// Boxes larger than this are considered malformed, as the demuxer has to
+// buffer whole top-level boxes.
+constexpr uint64_t kMaxBoxSize = 256 * 1024 * 1024;
+
+// Fragments hold seconds of media, i.e. hundreds of samples. Larger sample
+// counts are considered malformed, so that a tiny trun can't make the demuxer
+// allocate and iterate over billions of samples.
+constexpr uint32_t kMaxFragmentSampleCount = 64 * 1024;
+
+// Fields of tfhd and trun boxes.
+constexpr uint32_t kTfhdBaseDataOffsetPresent = 0x000001;
+constexpr uint32_t kTfhdSampleDescriptionIndexPresent = 0x000002;
+constexpr uint32_t kTfhdDefaultSampleDurationPresent = 0x000008;
+constexpr uint32_t kTfhdDefaultSampleSizePresent = 0x000010;
+constexpr uint32_t kTfhdDefaultSampleFlagsPresent = 0x000020;
+constexpr uint32_t kTrunDataOffsetPresent = 0x000001;
+constexpr uint32_t kTrunFirstSampleFlagsPresent = 0x000004;
+constexpr uint32_t kTrunSampleDurationPresent = 0x000100;
+constexpr uint32_t kTrunSampleSizePresent = 0x000200;
+constexpr uint32_t kTrunSampleFlagsPresent = 0x000400;
+constexpr uint32_t kTrunSampleCompositionTimeOffsetPresent = 0x000800;
+
+constexpr uint32_t kSampleIsNonSyncSample = 0x00010000;
+
+constexpr uint32_t FourCC(const char (&code)[5]) {
+  return (static_cast<uint32_t>(code[0]) << 24) |
+         (static_cast<uint32_t>(code[1]) << 16) |
+         (static_cast<uint32_t>(code[2]) << 8) | static_cast<uint32_t>(code[3]);
+}
+
+std::string FourCCToString(uint32_t fourcc) {
+  return {static_cast<char>(fourcc >> 24), static_cast<char>(fourcc >> 16),
+          static_cast<char>(fourcc >> 8), static_cast<char>(fourcc)};
+}
+
+// Reads big-endian values. Reading past the end of data sets ok() to false
+// and yields zeros.
+class BoxReader {
+ public:
+  BoxReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+  bool ok() const { return ok_; }
+  size_t position() const { return position_; }
+
+  uint64_t Read(size_t bytes) {
+    if (!ok_ || size_ - position_ < bytes) {
+      ok_ = false;
+      return 0;
+    }
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; ++i)
+      value = (value << 8) | data_[position_++];
+    return value;
+  }
+
+  uint8_t U8() { return Read(1); }
+  uint16_t U16() { return Read(2); }
+  uint32_t U24() { return Read(3); }
+  uint32_t U32() { return Read(4); }
+  uint64_t U64() { return Read(8); }
+
+  void Skip(size_t bytes) {
+    if (!ok_ || size_ - position_ < bytes) {
+      ok_ = false;
+      return;
+    }
+    position_ += bytes;
+  }
+
+ private:
+  const uint8_t* data_;
+  size_t size_;
+  size_t position_{0};
+  bool ok_{true};
+};  // class BoxReader
+
+// Reads box header at the beginning of data. Box size 0 means the box extends
+// to the end of the enclosing box (or the file). Returns false if the header
+// is not complete.
+bool ReadBoxHeader(const uint8_t* data,
+                   size_t size,
+                   uint64_t* box_size,
+                   uint32_t* type,
+                   size_t* header_size) {
+  BoxReader reader{data, size};
+  *box_size = reader.U32();
+  *type = reader.U32();
+  *header_size = 8;
+  if (*box_size == 1) {
+    *box_size = reader.U64();
+    *header_size = 16;
+  }
+  return reader.ok();
+}
+
+std::string MakeAvcCodecString(uint32_t fourcc,
+                               const std::vector<uint8_t>& avcc) {
+  if (avcc.size() < 4)
+    return FourCCToString(fourcc);
+  char profile_level[8];
+  std::snprintf(profile_level, sizeof(profile_level), ".%02X%02X%02X", avcc[1],
+                avcc[2], avcc[3]);
+  return FourCCToString(fourcc) + profile_level;
+}
+
+// See ISO/IEC 14496-15, Annex E.
+std::string MakeHevcCodecString(uint32_t fourcc,
+                                const std::vector<uint8_t>& hvcc) {
+  if (hvcc.size() < 13)
+    return FourCCToString(fourcc);
+  BoxReader reader{hvcc.data() + 1, hvcc.size() - 1};
+  auto profile = reader.U8();
+  auto compatibility_flags = reader.U32();
+  auto constraint_flags = reader.Read(6);
+  auto level = reader.U8();
+
+  uint32_t reversed_flags = 0;
+  for (int bit = 0; bit < 32; ++bit) {
+    reversed_flags |= ((compatibility_flags >> bit) & 1) << (31 - bit);
+  }
+
+  static const char* kProfileSpaces[] = {"", "A", "B", "C"};
+  char buffer[64];
+  std::snprintf(buffer, sizeof(buffer), ".%s%u.%X.%c%u",
+                kProfileSpaces[profile >> 6], profile & 0x1F, reversed_flags,
+                (profile & 0x20) ? 'H' : 'L', level);
+  auto result = FourCCToString(fourcc) + buffer;
+
+  // Trailing zero bytes of constraint flags are omitted.
+  int constraint_bytes = 6;
+  while (constraint_bytes > 0 &&
+         ((constraint_flags >> (8 * (6 - constraint_bytes))) & 0xFF) == 0) {
+    --constraint_bytes;
+  }
+  for (int byte = 0; byte < constraint_bytes; ++byte) {
+    std::snprintf(buffer, sizeof(buffer), ".%X",
+                  static_cast<unsigned>(
+                      (constraint_flags >> (8 * (5 - byte))) & 0xFF));
+    result += buffer;
+  }
+  return result;
+}
+
+}  // namespace
+
+struct Fmp4Demuxer::Box {
+  uint32_t type;
+  // Position of the box in the stream.
+  uint64_t offset;
+  // Box payload (without header).
+  const uint8_t* data;
+  size_t size;
+  size_t header_size;
+};  // struct Fmp4Demuxer::Box
+
+bool Fmp4Demuxer::Append(const uint8_t* data, size_t size) {
+  if (failed_)
+    return false;
+
+  buffer_.insert(buffer_.end(), data, data + size);
+
+  size_t position = 0;
+  while (buffer_.size() - position >= 8) {
+    uint64_t box_size;
+    uint32_t type;
+    size_t header_size;
+    if (!ReadBoxHeader(buffer_.data() + position, buffer_.size() - position,
+                       &box_size, &type, &header_size)) {
+      break;
+    }
+    // Top-level boxes must declare their size, as the stream may not be
+    // complete yet.
+    if (box_size < header_size || box_size > kMaxBoxSize) {
+      failed_ = true;
+      return false;
+    }
+    if (buffer_.size() - position < box_size)
+      break;
+
+    Box box{type, buffer_offset_ + position,
+            buffer_.data() + position + header_size,
+            static_cast<size_t>(box_size - header_size), header_size};
+    if (!ParseBox(box)) {
+      failed_ = true;
+      return false;
+    }
+    position += box_size;
+  }
+
+  buffer_.erase(buffer_.begin(), buffer_.begin() + position);
+  buffer_offset_ += position;
+  return true;
+}
+
+bool Fmp4Demuxer::PopPacket(DemuxedPacket* packet) {
+  if (packets_.empty())
+    return false;
+  *packet = std::move(packets_.front());
+  packets_.pop_front();
+  return true;
+}
+
+void Fmp4Demuxer::ResumeAt(uint64_t offset, Seconds decode_time) {
+  failed_ = false;
+  buffer_.clear();
+  buffer_offset_ = offset;
+  moof_offset_ = offset;
+  traf_ = {};
+  next_decode_time_ =
+      static_cast<uint64_t>(std::llround(decode_time.count() * timescale_));
+  samples_.clear();
+  packets_.clear();
+}
+
+bool Fmp4Demuxer::ParseBox(const Box& box) {
+  switch (box.type) {
+    case FourCC("moov"):
+      return ParseChildren(box) && OnMoovEnd();
+    case FourCC("trak"):
+      trak_ = {};
+      if (!ParseChildren(box))
+        return false;
+      OnTrakEnd();
+      return true;
+    case FourCC("mdia"):
+    case FourCC("minf"):
+    case FourCC("stbl"):
+    case FourCC("mvex"):
+      return ParseChildren(box);
+    case FourCC("moof"):
+      moof_offset_ = box.offset;
+      samples_.clear();
+      return ParseChildren(box);
+    case FourCC("traf"):
+      traf_ = {};
+      traf_.base_data_offset = moof_offset_;
+      traf_.default_sample_duration = default_sample_duration_;
+      traf_.default_sample_size = default_sample_size_;
+      traf_.default_sample_flags = default_sample_flags_;
+      return ParseChildren(box);
+    case FourCC("mvhd"):
+      return ParseMvhd(box.data, box.size);
+    case FourCC("mehd"):
+      return ParseMehd(box.data, box.size);
+    case FourCC("trex"):
+      return ParseTrex(box.data, box.size);
+    case FourCC("tkhd"):
+      return ParseTkhd(box.data, box.size);
+    case FourCC("mdhd"):
+      return ParseMdhd(box.data, box.size);
+    case FourCC("hdlr"):
+      return ParseHdlr(box.data, box.size);
+    case FourCC("stsd"):
+      return ParseStsd(box.data, box.size);
+    case FourCC("tfhd"):
+      return ParseTfhd(box.data, box.size);
+    case FourCC("tfdt"):
+      return ParseTfdt(box.data, box.size);
+    case FourCC("trun"):
+      return ParseTrun(box.data, box.size);
+    case FourCC("mdat"):
+      return ParseMdat(box);
+    default:
+      // ftyp, styp, sidx, free, etc. carry nothing the demuxer needs.
+      return true;
+  }
+}
+
+bool Fmp4Demuxer::ParseChildren(const Box& box) {
+  size_t position = 0;
+  while (position < box.size) {
+    uint64_t child_size;
+    uint32_t type;
+    size_t header_size;
+    if (!ReadBoxHeader(box.data + position, box.size - position, &child_size,
+                       &type, &header_size)) {
+      return false;
+    }
+    if (child_size == 0)
+      child_size = box.size - position;
+    if (child_size < header_size || child_size > box.size - position)
+      return false;
+    Box child{type, box.offset + box.header_size + position,
+              box.data + position + header_size,
+              static_cast<size_t>(child_size - header_size), header_size};
+    if (!ParseBox(child))
+      return false;
+    position += child_size;
+  }
+  return true;
+}
+
+bool Fmp4Demuxer::OnMoovEnd() {
+  if (!track_id_)
+    return false;
+
+  for (const auto& track_extends : track_extends_) {
+    if (track_extends.track_id != track_id_)
+      continue;
+    default_sample_duration_ = track_extends.default_sample_duration;
+    default_sample_size_ = track_extends.default_sample_size;
+    default_sample_flags_ = track_extends.default_sample_flags;
+  }
+  if (default_sample_duration_) {
+    config_.framerate_num = timescale_;
+    config_.framerate_den = default_sample_duration_;
+  }
+  has_config_ = true;
+  return true;
+}
+
+void Fmp4Demuxer::OnTrakEnd() {
+  // Only the first video track is demuxed.
+  if (track_id_ || !trak_.is_video || !trak_.has_sample_entry ||
+      !trak_.timescale) {
+    return;
+  }
+  track_id_ = trak_.id;
+  timescale_ = trak_.timescale;
+  config_ = trak_.config;
+  if (!config_.width || !config_.height) {
+    config_.width = trak_.width;
+    config_.height = trak_.height;
+  }
+}
+
+bool Fmp4Demuxer::ParseMvhd(const uint8_t* data, size_t size) {
+  BoxReader reader{data, size};
+  auto version = reader.U8();
+  reader.Skip(3);  // flags
+  reader.Skip(version == 1 ? 16 : 8);  // creation and modification time
+  movie_timescale_ = reader.U32();
+  auto duration = version == 1 ? reader.U64() : reader.U32();
+  // Duration declared in mehd takes precedence.
+  if (movie_timescale_ && duration_ == Seconds{0})
+    duration_ = Seconds{static_cast<double>(duration) / movie_timescale_};
+  return reader.ok();
+}
+
+bool Fmp4Demuxer::ParseMehd(const uint8_t* data, size_t size) {
+  BoxReader reader{data, size};
+  auto version = reader.U8();
+  reader.Skip(3);  // flags
+  auto fragment_duration = version == 1 ? reader.U64() : reader.U32();
+  if (movie_timescale_ && fragment_duration) {
+    duration_ =
+        Seconds{static_cast<double>(fragment_duration) / movie_timescale_};
+  }
+  return reader.ok();
+}
+
+bool Fmp4Demuxer::ParseTrex(const uint8_t* data, size_t size) {
+  BoxReader reader{data, size};
+  reader.Skip(4);  // version and flags
+  TrackExtends track_extends;
+  track_extends.track_id = reader.U32();
+  reader.Skip(4);  // default_sample_description_index
+  track_extends.default_sample_duration = reader.U32();
+  track_extends.default_sample_size = reader.U32();
+  track_extends.default_sample_flags = reader.U32();
+  track_extends_.push_back(track_extends);
+  return reader.ok();
+}
+
+bool Fmp4Demuxer::ParseTkhd(const uint8_t* data, size_t size) {
+  BoxReader reader{data, size};
+  auto version = reader.U8();
+  reader.Skip(3);  // flags
+  reader.Skip(version == 1 ? 16 : 8);  // creation and modification time
+  trak_.id = reader.U32();
+  reader.Skip(4);  // reserved
+  reader.Skip(version == 1 ? 8 : 4);  // duration
+  // reserved, layer, alternate_group, volume, reserved and matrix
+  reader.Skip(8 + 2 + 2 + 2 + 2 + 36);
+  // 16.16 fixed point values.
+  trak_.width = reader.U32() >> 16;
+  trak_.height = reader.U32() >> 16;
+  return reader.ok();
+}
+
+bool Fmp4Demuxer::ParseMdhd(const uint8_t* data, size_t size) {
+  BoxReader reader{data, size};
+  auto version = reader.U8();
+  reader.Skip(3);  // flags
+  reader.Skip(version == 1 ? 16 : 8);  // creation and modification time
+  trak_.timescale = reader.U32();
+  return reader.ok();
+}
+
+bool Fmp4Demuxer::ParseHdlr(const uint8_t* data, size_t size) {
+  BoxReader reader{data, size};
+  reader.Skip(4);  // version and flags
+  reader.Skip(4);  // pre_defined
+  trak_.is_video = (reader.U32() == FourCC("vide"));
+  return reader.ok();
+}
+
+bool Fmp4Demuxer::ParseStsd(const uint8_t* data, size_t size) {
+  BoxReader reader{data, size};
+  reader.Skip(4);  // version and flags
+  if (!reader.U32())  // entry_count
+    return reader.ok();
+
+  // Only the first sample entry is used.
+  uint64_t entry_size;
+  uint32_t format;
+  size_t header_size;
+  const auto* entry = data + reader.position();
+  const auto entry_limit = size - reader.position();
+  if (!ReadBoxHeader(entry, entry_limit, &entry_size, &format, &header_size) ||
+      entry_size < header_size || entry_size > entry_limit) {
+    return false;
+  }
+
+  bool is_avc = (format == FourCC("avc1") || format == FourCC("avc3"));
+  bool is_hevc = (format == FourCC("hvc1") || format == FourCC("hev1"));
+  if (!is_avc && !is_hevc)
+    return true;
+
+  // VisualSampleEntry fields preceding width and height.
+  constexpr size_t kWidthOffset = 6 + 2 + 2 + 2 + 12;
+  // Size of all VisualSampleEntry fields.
+  constexpr size_t kVisualSampleEntrySize = 78;
+  BoxReader entry_reader{entry + header_size, entry_size - header_size};
+  entry_reader.Skip(kWidthOffset);
+  trak_.config.width = entry_reader.U16();
+  trak_.config.height = entry_reader.U16();
+  entry_reader.Skip(kVisualSampleEntrySize - kWidthOffset - 4);
+  if (!entry_reader.ok())
+    return false;
+
+  // Look for the decoder configuration record among child boxes.
+  const auto configuration_type = is_avc ? FourCC("avcC") : FourCC("hvcC");
+  auto position = header_size + entry_reader.position();
+  while (position < entry_size) {
+    uint64_t child_size;
+    uint32_t type;
+    size_t child_header_size;
+    if (!ReadBoxHeader(entry + position, entry_size - position, &child_size,
+                       &type, &child_header_size) ||
+        child_size < child_header_size || child_size > entry_size - position) {
+      return false;
+    }
+    if (type == configuration_type) {
+      const auto* record = entry + position + child_header_size;
+      trak_.config.extradata.assign(record,
+                                    record + child_size - child_header_size);
+      break;
+    }
+    position += child_size;
+  }
+
+  auto codec = is_avc ? MakeAvcCodecString(format, trak_.config.extradata)
+                      : MakeHevcCodecString(format, trak_.config.extradata);
+  trak_.config.mimeType = "video/mp4; codecs=\"" + codec + "\"";
+  trak_.has_sample_entry = true;
+  return true;
+}
+
+bool Fmp4Demuxer::ParseTfhd(const uint8_t* data, size_t size) {
+  BoxReader reader{data, size};
+  reader.Skip(1);  // version
+  auto flags = reader.U24();
+  traf_.is_our_track = (reader.U32() == track_id_);
+  if (flags & kTfhdBaseDataOffsetPresent)
+    traf_.base_data_offset = reader.U64();
+  if (flags & kTfhdSampleDescriptionIndexPresent)
+    reader.Skip(4);
+  if (flags & kTfhdDefaultSampleDurationPresent)
+    traf_.default_sample_duration = reader.U32();
+  if (flags & kTfhdDefaultSampleSizePresent)
+    traf_.default_sample_size = reader.U32();
+  if (flags & kTfhdDefaultSampleFlagsPresent)
+    traf_.default_sample_flags = reader.U32();
+  traf_.next_data_offset = traf_.base_data_offset;
+  return reader.ok();
+}
+
+bool Fmp4Demuxer::ParseTfdt(const uint8_t* data, size_t size) {
+  BoxReader reader{data, size};
+  auto version = reader.U8();
+  reader.Skip(3);  // flags
+  auto base_media_decode_time = version == 1 ? reader.U64() : reader.U32();
+  if (traf_.is_our_track)
+    next_decode_time_ = base_media_decode_time;
+  return reader.ok();
+}
+
+bool Fmp4Demuxer::ParseTrun(const uint8_t* data, size_t size) {
+  if (!traf_.is_our_track)
+    return true;
+
+  BoxReader reader{data, size};
+  auto version = reader.U8();
+  auto flags = reader.U24();
+  auto sample_count = reader.U32();
+  auto offset = traf_.next_data_offset;
+  if (flags & kTrunDataOffsetPresent) {
+    const auto data_offset =
+        static_cast<int64_t>(static_cast<int32_t>(reader.U32()));
+    const auto distance =
+        static_cast<uint64_t>(data_offset < 0 ? -data_offset : data_offset);
+    // Samples can't lie outside of the stream.
+    if (data_offset < 0 ? traf_.base_data_offset < distance
+                        : traf_.base_data_offset >
+                              std::numeric_limits<uint64_t>::max() - distance) {
+      return false;
+    }
+    offset = data_offset < 0 ? traf_.base_data_offset - distance
+                             : traf_.base_data_offset + distance;
+  }
+  auto first_sample_flags = traf_.default_sample_flags;
+  if (flags & kTrunFirstSampleFlagsPresent)
+    first_sample_flags = reader.U32();
+  if (!reader.ok())
+    return false;
+
+  // A malformed sample count must not make the demuxer allocate or iterate
+  // more than the fragment can describe: fields of all samples have to fit in
+  // the rest of the box and samples without their own size need a default one
+  // that makes them fit in an mdat.
+  if (sample_count > kMaxFragmentSampleCount - samples_.size())
+    return false;
+  size_t sample_fields_size = 0;
+  for (auto field : {kTrunSampleDurationPresent, kTrunSampleSizePresent,
+                     kTrunSampleFlagsPresent,
+                     kTrunSampleCompositionTimeOffsetPresent}) {
+    if (flags & field)
+      sample_fields_size += 4;
+  }
+  if (sample_fields_size &&
+      sample_count > (size - reader.position()) / sample_fields_size) {
+    return false;
+  }
+  if (!(flags & kTrunSampleSizePresent) && sample_count &&
+      (traf_.default_sample_size == 0 ||
+       sample_count > kMaxBoxSize / traf_.default_sample_size)) {
+    return false;
+  }
+  samples_.reserve(samples_.size() + sample_count);
+
+  for (uint32_t sample_idx = 0; sample_idx < sample_count && reader.ok();
+       ++sample_idx) {
+    Sample sample;
+    sample.offset = offset;
+    sample.decode_time = next_decode_time_;
+    sample.duration = (flags & kTrunSampleDurationPresent)
+                          ? reader.U32()
+                          : traf_.default_sample_duration;
+    sample.size = (flags & kTrunSampleSizePresent)
+                      ? reader.U32()
+                      : traf_.default_sample_size;
+    auto sample_flags = (sample_idx == 0) ? first_sample_flags
+                                          : traf_.default_sample_flags;
+    if (flags & kTrunSampleFlagsPresent)
+      sample_flags = reader.U32();
+    sample.composition_offset = 0;
+    if (flags & kTrunSampleCompositionTimeOffsetPresent) {
+      auto composition_offset = reader.U32();
+      sample.composition_offset =
+          version == 0 ? static_cast<int64_t>(composition_offset)
+                       : static_cast<int32_t>(composition_offset);
+    }
+    sample.is_key_frame = !(sample_flags & kSampleIsNonSyncSample);
+    // Parsing the fragment again produces its samples, so it can be resumed
+    // from if it begins with a keyframe.
+    sample.resume_offset = (samples_.empty() && sample.is_key_frame)
+                               ? moof_offset_
+                               : DemuxedPacket::kNoResumeOffset;
+    if (offset > std::numeric_limits<uint64_t>::max() - sample.size)
+      return false;
+    samples_.push_back(sample);
+
+    offset += sample.size;
+    next_decode_time_ += sample.duration;
+  }
+  traf_.next_data_offset = offset;
+  return reader.ok();
+}
+
+bool Fmp4Demuxer::ParseMdat(const Box& box) {
+  if (!has_config_)
+    return true;
+
+  const auto data_begin = box.offset + box.header_size;
+  const auto data_end = data_begin + box.size;
+  auto in_this_mdat = [data_begin, data_end](const Sample& sample) {
+    return sample.offset >= data_begin && sample.offset <= data_end &&
+           sample.size <= data_end - sample.offset;
+  };
+
+  for (const auto& sample : samples_) {
+    if (!in_this_mdat(sample))
+      continue;
+    DemuxedPacket packet;
+    packet.packet = {};
+    packet.packet.pts = Seconds{
+        static_cast<double>(static_cast<int64_t>(sample.decode_time) +
+                            sample.composition_offset) /
+        timescale_};
+    packet.packet.dts =
+        Seconds{static_cast<double>(sample.decode_time) / timescale_};
+    packet.packet.duration =
+        Seconds{static_cast<double>(sample.duration) / timescale_};
+    packet.packet.is_key_frame = sample.is_key_frame;
+    packet.packet.size = sample.size;
+    packet.packet.width = config_.width;
+    packet.packet.height = config_.height;
+    packet.packet.framerate_num = config_.framerate_num;
+    packet.packet.framerate_den = config_.framerate_den;
+    const auto* sample_data = box.data + (sample.offset - data_begin);
+    packet.data.assign(sample_data, sample_data + sample.size);
+    packet.resume_offset = sample.resume_offset;
+    packets_.push_back(std::move(packet));
+  }
+
+  // Samples stored in other mdat boxes are kept until those arrive.
+  samples_.erase(
+      std::remove_if(samples_.begin(), samples_.end(), in_this_mdat),
+      samples_.end());
+  return true;
+}
+
+// static
+std::unique_ptr<Fmp4FileSource> Fmp4FileSource::Open(const std::string& path) {
+  auto* file = std::fopen(path.c_str(), "rb");
+  if (!file)
+    return nullptr;
+
+  std::unique_ptr<Fmp4FileSource> source{new Fmp4FileSource(file)};
+  while (!source->demuxer_.HasConfig()) {
+    if (!source->ReadChunk()) {
+      std::cout << "No supported video track in " << path << std::endl;
+      return nullptr;
+    }
+  }
+  return source;
+}
+
+Fmp4FileSource::Fmp4FileSource(std::FILE* file) : StreamingFileSource(file) {}
+
+Seconds Fmp4FileSource::GetDuration() const {
+  return demuxer_.GetDuration();
+}
+
+const ElementaryVideoTrackConfig& Fmp4FileSource::GetVideoTrackConfig() const {
+  return demuxer_.GetVideoTrackConfig();
+}
+
+bool Fmp4FileSource::ProcessChunk(const uint8_t* data, size_t size) {
+  if (!demuxer_.Append(data, size))
+    return false;
+
+  DemuxedPacket packet;
+  while (demuxer_.PopPacket(&packet))
+    AddPacket(std::move(packet));
+  return true;
+}
+
+void Fmp4FileSource::ResumeAt(uint64_t offset,
+                              const ElementaryMediaPacket& first_packet) {
+  demuxer_.ResumeAt(offset, first_packet.dts);
+}
@@ -0,0 +1,178 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef WASM_PLAYER_SAMPLE_FMP4_DEMUXER_H
+#define WASM_PLAYER_SAMPLE_FMP4_DEMUXER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <samsung/wasm/elementary_media_packet.h>
+#include <samsung/wasm/elementary_video_track_config.h>
+
+#include "packet_source.h"
+
+// Streaming demuxer of fragmented MP4 (ISO BMFF) content.
+//
+// Data can be appended in chunks of any size as it arrives (e.g. read from
+// a file or downloaded). The demuxer parses the initialization segment (moov)
+// to get the video track config and then turns moof + mdat pairs into
+// Elementary Media Packets of the first H.264 or HEVC video track. Other tracks
+// and edit lists are ignored.
+class Fmp4Demuxer {
+ public:
+  using ElementaryMediaPacket = samsung::wasm::ElementaryMediaPacket;
+  using ElementaryVideoTrackConfig = samsung::wasm::ElementaryVideoTrackConfig;
+  using Seconds = samsung::wasm::Seconds;
+
+  // Returns false if data is malformed. Demuxer can't be used after an error.
+  bool Append(const uint8_t* data, size_t size);
+
+  // Returns true once the video track config has been parsed.
+  bool HasConfig() const { return has_config_; }
+  const ElementaryVideoTrackConfig& GetVideoTrackConfig() const {
+    return config_;
+  }
+  // Duration declared in the initialization segment, 0 if not known.
+  Seconds GetDuration() const { return duration_; }
+
+  // Returns false if there are no demuxed packets available.
+  bool PopPacket(DemuxedPacket* packet);
+
+  // Drops buffered data and packets, so that data appended next is parsed as
+  // if it started at the given stream offset, which must be
+  // DemuxedPacket::resume_offset of a packet demuxed earlier (i.e. the moof
+  // of a fragment beginning with a keyframe). decode_time is dts of that
+  // packet, used if the fragment doesn't declare it in tfdt.
+  void ResumeAt(uint64_t offset, Seconds decode_time);
+
+ private:
+  struct Box;
+  struct Sample {
+    uint64_t offset;
+    uint32_t size;
+    uint64_t decode_time;
+    uint32_t duration;
+    int64_t composition_offset;
+    bool is_key_frame;
+    uint64_t resume_offset;
+  };  // struct Sample
+
+  struct TrackExtends {
+    uint32_t track_id;
+    uint32_t default_sample_duration;
+    uint32_t default_sample_size;
+    uint32_t default_sample_flags;
+  };  // struct TrackExtends
+
+  bool ParseBox(const Box& box);
+  // Parses all children of a container box.
+  bool ParseChildren(const Box& box);
+  bool OnMoovEnd();
+  bool ParseMvhd(const uint8_t* data, size_t size);
+  bool ParseMehd(const uint8_t* data, size_t size);
+  bool ParseTrex(const uint8_t* data, size_t size);
+  bool ParseTkhd(const uint8_t* data, size_t size);
+  bool ParseMdhd(const uint8_t* data, size_t size);
+  bool ParseHdlr(const uint8_t* data, size_t size);
+  bool ParseStsd(const uint8_t* data, size_t size);
+  bool ParseTfhd(const uint8_t* data, size_t size);
+  bool ParseTfdt(const uint8_t* data, size_t size);
+  bool ParseTrun(const uint8_t* data, size_t size);
+  bool ParseMdat(const Box& box);
+  void OnTrakEnd();
+
+  bool failed_{false};
+
+  // Data appended, but not parsed yet. buffer_offset_ is position of its
+  // first byte in the stream.
+  std::vector<uint8_t> buffer_;
+  uint64_t buffer_offset_{0};
+
+  // Initialization segment.
+  bool has_config_{false};
+  ElementaryVideoTrackConfig config_{};
+  Seconds duration_{0};
+  uint32_t movie_timescale_{0};
+  uint32_t track_id_{0};
+  uint32_t timescale_{0};
+  uint32_t default_sample_duration_{0};
+  uint32_t default_sample_size_{0};
+  uint32_t default_sample_flags_{0};
+  std::vector<TrackExtends> track_extends_;
+
+  // Trak being parsed.
+  struct {
+    uint32_t id;
+    uint32_t timescale;
+    uint32_t width;
+    uint32_t height;
+    bool is_video;
+    bool has_sample_entry;
+    ElementaryVideoTrackConfig config;
+  } trak_{};
+
+  // Fragment being parsed.
+  uint64_t moof_offset_{0};
+  struct {
+    bool is_our_track;
+    uint64_t base_data_offset;
+    uint32_t default_sample_duration;
+    uint32_t default_sample_size;
+    uint32_t default_sample_flags;
+    uint64_t next_data_offset;
+  } traf_{};
+  uint64_t next_decode_time_{0};
+
+  // Samples of the current fragment waiting for their mdat.
+  std::vector<Sample> samples_;
+  std::deque<DemuxedPacket> packets_;
+};  // class Fmp4Demuxer
+
+// Serves packets demuxed from a local fragmented MP4 file.
+//
+// Only the initialization segment is read upfront, the rest of the file is
+// demuxed on the worker thread as playback progresses.
+class Fmp4FileSource : public StreamingFileSource {
+ public:
+  // Reads the file until the video track config is known. Returns nullptr if
+  // the file can't be read or doesn't contain a supported video track.
+  static std::unique_ptr<Fmp4FileSource> Open(const std::string& path);
+
+  Seconds GetDuration() const override;
+  const ElementaryVideoTrackConfig& GetVideoTrackConfig() const override;
+
+ protected:
+  bool ProcessChunk(const uint8_t* data, size_t size) override;
+  void ResumeAt(uint64_t offset,
+                const ElementaryMediaPacket& first_packet) override;
+
+ private:
+  explicit Fmp4FileSource(std::FILE* file);
+
+  Fmp4Demuxer demuxer_;
+};  // class Fmp4FileSource
+
+#endif  // WASM_PLAYER_SAMPLE_FMP4_DEMUXER_H
@@ -0,0 +1,83 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "futex.h"
+
+#ifdef __EMSCRIPTEN__
+#include <cmath>
+
+#include <emscripten/threading.h>
+#else
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif  // __EMSCRIPTEN__
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "Futex word must be a plain 32-bit integer");
+
+void FutexWait(std::atomic<uint32_t>* address, uint32_t expected) {
+#ifdef __EMSCRIPTEN__
+  emscripten_futex_wait(address, expected, INFINITY);
+#else
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(address), FUTEX_WAIT_PRIVATE,
+          expected, nullptr, nullptr, 0);
+#endif  // __EMSCRIPTEN__
+}
+
+void FutexWait(std::atomic<uint32_t>* address,
+               uint32_t expected,
+               std::chrono::steady_clock::time_point deadline) {
+  using Clock = std::chrono::steady_clock;
+  if (deadline == Clock::time_point::max()) {
+    FutexWait(address, expected);
+    return;
+  }
+  const auto timeout = deadline - Clock::now();
+  if (timeout <= Clock::duration::zero())
+    return;
+#ifdef __EMSCRIPTEN__
+  emscripten_futex_wait(
+      address, expected,
+      std::chrono::duration<double, std::milli>(timeout).count());
+#else
+  // FUTEX_WAIT takes a timeout relative to the call.
+  const auto seconds =
+      std::chrono::duration_cast<std::chrono::seconds>(timeout);
+  timespec relative_timeout{};
+  relative_timeout.tv_sec = static_cast<time_t>(seconds.count());
+  relative_timeout.tv_nsec = static_cast<long>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(timeout - seconds)
+          .count());
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(address), FUTEX_WAIT_PRIVATE,
+          expected, &relative_timeout, nullptr, 0);
+#endif  // __EMSCRIPTEN__
+}
+
+void FutexWake(std::atomic<uint32_t>* address, int count) {
+#ifdef __EMSCRIPTEN__
+  emscripten_futex_wake(address, count);
+#else
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(address), FUTEX_WAKE_PRIVATE,
+          count, nullptr, nullptr, 0);
+#endif  // __EMSCRIPTEN__
+}
@@ -0,0 +1,48 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef WASM_PLAYER_SAMPLE_FUTEX_H
+#define WASM_PLAYER_SAMPLE_FUTEX_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Futex wait and wake used by lock-free queues to put idle threads to sleep.
+//
+// The module uses Emscripten's futex API, while host builds (e.g. tools
+// driving TrackDataPump's core with a simulated sink) use the Linux futex
+// system call.
+
+// Sleeps until *address is woken up, unless its value differs from expected
+// already.
+void FutexWait(std::atomic<uint32_t>* address, uint32_t expected);
+
+// Like above, but returns at the deadline at the latest. Waits indefinitely if
+// the deadline is time_point::max().
+void FutexWait(std::atomic<uint32_t>* address,
+               uint32_t expected,
+               std::chrono::steady_clock::time_point deadline);
+
+// Wakes up to count threads waiting on *address.
+void FutexWake(std::atomic<uint32_t>* address, int count);
+
+#endif  // WASM_PLAYER_SAMPLE_FUTEX_H
@@ -0,0 +1,159 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef WASM_PLAYER_SAMPLE_JITTER_BUFFER_H
+#define WASM_PLAYER_SAMPLE_JITTER_BUFFER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include <samsung/wasm/elementary_media_packet.h>
+#include <samsung/wasm/elementary_video_track_config.h>
+
+#include "packet_source.h"
+
+// Sits between network arrival and appending packets of a live stream: puts
+// packets back in decoding order and releases them at the pace of their dts.
+//
+// Network delivers packets with a variable delay (jitter) and occasionally out
+// of order. Every packet is held until
+//   dts + (delay of the fastest packet seen so far) + playout delay,
+// so packets delayed by less than the playout delay more than the fastest one
+// are released in order and evenly spaced. Tracking the fastest packet keeps a
+// slow first packet from adding to latency for the rest of the stream. Sender
+// and receiver clocks are assumed not to drift.
+//
+// A packet arriving after a packet with a later dts was released is dropped,
+// since appending it would break decoding order.
+//
+// Time is passed in by the caller, so that the buffer can be driven by
+// a simulated clock on the host (see tools/jitter_simulator.cc).
+class JitterBuffer {
+ public:
+  using Clock = std::chrono::steady_clock;
+  // Same representation as samsung::wasm::Seconds.
+  using Seconds = std::chrono::duration<double>;
+
+  struct Config {
+    // Added to latency of every packet. Should cover the expected jitter.
+    Seconds playout_delay;
+    // When more packets are held, the earliest ones are released right away
+    // instead of growing the buffer.
+    size_t max_packets;
+  };  // struct Config
+
+  struct Stats {
+    uint64_t pushed_count;
+    uint64_t released_count;
+    // Packets that arrived after a packet with a later dts, but in time to be
+    // put back in order.
+    uint64_t reordered_count;
+    // Packets that arrived too late to be put back in order.
+    uint64_t late_count;
+    // Packets released early because max_packets was exceeded.
+    uint64_t overflow_count;
+  };  // struct Stats
+
+  explicit JitterBuffer(const Config& config);
+
+  // Can be called on any thread, e.g. a thread receiving data from a network.
+  void Push(DemuxedPacket packet, Clock::time_point arrival_time);
+
+  // Pops the packet with the lowest dts into *packet if it's due at the given
+  // time. Returns false otherwise.
+  bool Pop(Clock::time_point now, DemuxedPacket* packet);
+
+  // Returns time the next packet is due at or time_point::max() if there is
+  // no packet held.
+  Clock::time_point GetNextReleaseTime() const;
+
+  bool IsEmpty() const;
+
+  Stats GetStats() const;
+
+ private:
+  struct Entry {
+    DemuxedPacket packet;
+    Clock::time_point arrival_time;
+  };  // struct Entry
+
+  Clock::time_point GetReleaseTime(const Entry& entry) const;
+
+  const Config config_;
+
+  mutable std::mutex mutex_;
+  // Min-heap by dts.
+  std::vector<Entry> heap_;
+  // Smallest difference between arrival time and dts seen so far.
+  Clock::duration min_offset_{Clock::duration::max()};
+  Seconds highest_pushed_dts_{0};
+  Seconds last_released_dts_{0};
+  bool has_released_{false};
+  Stats stats_{};
+};  // class JitterBuffer
+
+// Serves packets of a live stream received from a network.
+//
+// Unlike other sources, packets are not available upfront: a network thread
+// pushes them as they arrive and they become available to TrackDataPump's
+// worker once released by a JitterBuffer. Released packets are kept in memory
+// like in StreamingFileSource. The stream has no known duration.
+class LivePacketSource : public PacketSource {
+ public:
+  // Packets can arrive at any time while the jitter buffer is empty, so
+  // GetNextPacketTime() asks to poll it this often.
+  static constexpr std::chrono::milliseconds kEmptyPollInterval{10};
+
+  LivePacketSource(const ElementaryVideoTrackConfig& config,
+                   const JitterBuffer::Config& jitter_buffer_config);
+
+  // Methods below can be called on any thread.
+  void Push(DemuxedPacket packet);
+  // No packets will be pushed anymore.
+  void PushEndOfStream();
+  JitterBuffer::Stats GetJitterBufferStats() const;
+
+  Seconds GetDuration() const override;
+  const ElementaryVideoTrackConfig& GetVideoTrackConfig() const override;
+  size_t GetPacketCount() const override;
+  void FillPacket(size_t index, ElementaryMediaPacket* packet) const override;
+  // Takes packets that are due from the jitter buffer. Packets can't be read
+  // ahead of the network, so the time is ignored.
+  void ReadUntil(Seconds time) override;
+  bool IsComplete() const override;
+  // Time the jitter buffer releases the next packet at.
+  std::chrono::steady_clock::time_point GetNextPacketTime() const override;
+
+ private:
+  const ElementaryVideoTrackConfig config_;
+  JitterBuffer jitter_buffer_;
+  std::atomic<bool> end_of_stream_{false};
+  // Accessed only on the worker thread.
+  std::deque<DemuxedPacket> packets_;
+  bool is_complete_{false};
+};  // class LivePacketSource
+
+#endif  // WASM_PLAYER_SAMPLE_JITTER_BUFFER_H
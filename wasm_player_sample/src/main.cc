@@ -26,10 +26,43 @@
 
 #include <emscripten/emscripten.h>
 
+#include <string>
+
 #include "emss_sdf_sample.h"
+#include "tracing.h"
 
 static SamplePlayer kSamplePlayerInstance;
 
+// Tracing controls (see tracing.h) called from JS, e.g. in the Web Inspector
+// console:
+//   Module._SetTracingEnabled(1);
+//   // Reproduce the issue.
+//   Module._SetTracingEnabled(0);
+//   Module._SaveChromeTrace();
+extern "C" {
+
+EMSCRIPTEN_KEEPALIVE void SetTracingEnabled(int enabled) {
+  tracing::SetEnabled(enabled);
+}
+
+// Saves recent events as trace.json, to be opened in chrome://tracing or
+// Perfetto.
+EMSCRIPTEN_KEEPALIVE void SaveChromeTrace() {
+  const std::string json = tracing::ExportChromeTraceJson();
+  EM_ASM(
+      {
+        const link = document.createElement('a');
+        link.href = URL.createObjectURL(
+            new Blob([UTF8ToString($0)], {type: 'application/json'}));
+        link.download = 'trace.json';
+        link.click();
+        setTimeout(() => URL.revokeObjectURL(link.href), 0);
+      },
+      json.c_str());
+}
+
+}  // extern "C"
+
 int main() {
   // WASM module execution will not terminate when main exits.
   EM_ASM(noExitRuntime = true);
@@ -0,0 +1,567 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef WASM_PLAYER_SAMPLE_PACKET_PUMP_H
+#define WASM_PLAYER_SAMPLE_PACKET_PUMP_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <samsung/wasm/elementary_media_packet.h>
+
+#include "buffer_ahead_controller.h"
+#include "histogram.h"
+#include "packet_sink.h"
+#include "packet_source.h"
+#include "pump_thread_pool.h"
+
+// Keyframes of a packet sequence sorted by pts.
+//
+// A first frame after Seek must always be a keyframe. The index is built once
+// when content is loaded, so that a keyframe preceding a seek target is found
+// with a binary search instead of scanning every packet of the content.
+class KeyframeIndex {
+ public:
+  using Seconds = samsung::wasm::Seconds;
+
+  explicit KeyframeIndex(const PacketSource& packet_source);
+
+  // Indexes packets added to a source since the last update.
+  void Update(const PacketSource& packet_source);
+
+  // Returns index of a closest keyframe preceding the given time or 0 if there
+  // is no such keyframe.
+  size_t GetClosestKeyframeIndex(Seconds time) const;
+
+  // Returns pts of a keyframe ending the GOP that contains the given time or
+  // infinity if there is no such keyframe (yet).
+  Seconds GetGopEnd(Seconds time) const;
+
+ private:
+  struct Entry {
+    Seconds pts;
+    size_t packet_index;
+  };  // struct Entry
+
+  std::vector<Entry> entries_;
+  size_t indexed_packet_count_{0};
+};  // class KeyframeIndex
+
+// Buffers packets of PacketSources into PacketSinks ahead of a playback
+// position. This is the core of TrackDataPump, which feeds ElementaryMediaTrack
+// objects with it. The core has no dependencies on Tizen WASM Player beyond
+// plain data types, so that it can be built for the host and driven with
+// a simulated sink (see SimulatedDecoderSink).
+//
+// All tracks (e.g. audio and video) are fed by a single worker thread. Since
+// starving any of the tracks stalls playback, packets of all tracks are
+// appended in decoding time order, so that a track buffered the least is always
+// served first.
+//
+// Buffering is driven by playback position updates. When a source can't
+// provide packets up to the buffering target yet, but will provide them at
+// a known time (e.g. a live stream released by a JitterBuffer), the worker
+// wakes itself up then and retries, so that e.g. live playback starts before
+// any position update arrives.
+//
+// As playback progresses, the pump tells sources which payloads it no longer
+// needs (see PacketSource::DiscardPayloadsBefore()), so that sources reading
+// content on demand keep only the GOP being played and the buffered packets
+// in memory.
+//
+// By default the pump runs its own worker thread. Pumps of many players can
+// share a PumpThreadPool instead, and builds without threads run the worker in
+// slices on the main thread (see WorkerMode).
+class PacketPump : private PumpThreadPool::Task {
+ public:
+  using Seconds = samsung::wasm::Seconds;
+  using SessionId = samsung::wasm::SessionId;
+
+  // Controls how many packets should be buffered ahead of a current playback
+  // position initially. The value is adjusted at runtime between
+  // kMinBufferAhead and kMaxBufferAhead depending on how healthy the pipeline
+  // is (see BufferAheadController).
+  static constexpr Seconds kBufferAhead = Seconds{3.};
+  static constexpr Seconds kMinBufferAhead = Seconds{1.};
+  static constexpr Seconds kMaxBufferAhead = Seconds{10.};
+
+  // Initial buffer ahead for live content played in kLowLatency mode, where
+  // everything buffered adds to latency. Buffer is never shrunk below the
+  // initial value.
+  static constexpr Seconds kLowLatencyBufferAhead = Seconds{0.5};
+
+  // Controls how much data (in bytes) can be appended ahead of a current
+  // playback position. Keeps memory usage bounded for high bitrate content.
+  static constexpr size_t kMaxBufferedBytes = 8 * 1024 * 1024;
+
+  // Worker thread will be notified about advancing playback position at most
+  // every kWorkerUpdateThreshold. The interval is shortened down to
+  // kMinWorkerUpdateThreshold when the pump starves.
+  static constexpr Seconds kWorkerUpdateThreshold = Seconds{0.5};
+  static constexpr Seconds kMinWorkerUpdateThreshold = Seconds{0.1};
+
+  // Playback position closer than this to the end of buffered data is
+  // considered an underrun.
+  static constexpr Seconds kUnderrunMargin = Seconds{0.5};
+
+  // Controls how far ahead of the track buffered the least other tracks can
+  // be buffered, e.g. when packets of one track are not available yet.
+  static constexpr Seconds kMaxTrackSkew = Seconds{1.};
+
+  // Limits buffering ahead of a current playback position. Pump stops
+  // buffering as soon as any of the limits is reached.
+  struct BufferPolicy {
+    // Initial value, adjusted at runtime.
+    Seconds buffer_ahead;
+    // Size of packets that were appended, but not played yet (all tracks in
+    // total).
+    size_t max_buffered_bytes;
+    // Maximum difference between buffered pts of tracks.
+    Seconds max_track_skew;
+  };  // struct BufferPolicy
+
+  // Tells where the pump's worker runs.
+  enum class WorkerMode {
+    // A thread owned by the pump.
+    kOwnThread,
+    // Threads of a PumpThreadPool shared with other pumps.
+    kThreadPool,
+    // Time-boxed slices run on the main thread with RunSlice(), e.g. from the
+    // Emscripten main loop. Doesn't use threads at all, so it's the only mode
+    // available in builds without pthreads.
+    kMainLoop,
+  };
+
+#ifdef __EMSCRIPTEN_PTHREADS__
+  static constexpr WorkerMode kDefaultWorkerMode = WorkerMode::kOwnThread;
+#else
+  static constexpr WorkerMode kDefaultWorkerMode = WorkerMode::kMainLoop;
+#endif  // __EMSCRIPTEN_PTHREADS__
+
+  // Main thread time a single RunSlice() is meant to take, a fraction of
+  // a 60 FPS frame.
+  static constexpr Seconds kSliceBudget = Seconds{0.004};
+
+  // A sink fed by the pump along with a source of its packets.
+  struct Track {
+    std::unique_ptr<PacketSink> sink;
+    std::shared_ptr<PacketSource> packet_source;
+  };  // struct Track
+
+  // Packets due for a buffering request are gathered into a batch and then
+  // appended together in a tight loop.
+  struct BatchStats {
+    uint64_t batch_count;
+    uint64_t packet_count;
+    uint32_t largest_batch_size;
+  };  // struct BatchStats
+
+  // The first track is expected to be the video track. thread_pool is used
+  // only in WorkerMode::kThreadPool and must outlive the pump.
+  PacketPump(std::vector<Track> tracks,
+             BufferPolicy buffer_policy,
+             WorkerMode worker_mode = kDefaultWorkerMode,
+             PumpThreadPool* thread_pool = nullptr);
+
+  ~PacketPump() override;
+
+  PacketPump(const PacketPump&) = delete;
+  PacketPump& operator=(const PacketPump&) = delete;
+
+  // Notify pump about stream running time, so that elementary media data can be
+  // buffered up to (new_time + current buffer ahead).
+  void UpdateTime(Seconds new_time);
+
+  // Runs the worker on the calling (main) thread for about the given time.
+  // Must be called periodically in WorkerMode::kMainLoop. Appending that
+  // doesn't fit in the budget is resumed in the next slice.
+  void RunSlice(Seconds budget);
+
+  WorkerMode GetWorkerMode() const;
+
+  // A standby pump buffers only the first GOP when its track opens, so that
+  // playback can start right away without holding more data than needed
+  // (e.g. for a channel prepared ahead of a switch). Leaving standby resumes
+  // buffering up to the current buffer ahead. Must be called on the main
+  // thread.
+  void SetStandby(bool standby);
+
+  // With fast start, whenever the track opens (at startup and after a seek)
+  // the first GOP is appended on its own with a buffer target reduced to
+  // kMinBufferAhead, before buffering up to the current buffer ahead
+  // continues. The track can then start decoding without waiting for the
+  // whole buffer, e.g. for a streaming source to demux it. Must be called
+  // on the main thread before the track opens.
+  void SetFastStart(bool fast_start);
+
+  // Stops the worker and waits until it's done. Buffering is cancelled
+  // between packets, so in WorkerMode::kOwnThread this takes at most as long
+  // as appending a single packet. In WorkerMode::kThreadPool a pump idle in
+  // the pool is stopped right away, while a pump queued or running in the pool
+  // is stopped once a pool thread gets to it, i.e. after pumps queued ahead of
+  // it handle a message each. The main thread of a browser can't sleep, so
+  // waiting spins there. Returns time it took, so that teardown latency can be
+  // monitored (e.g. when switching channels). Called by the destructor unless
+  // it was called earlier. Must be called on the main thread.
+  Seconds Terminate();
+
+  // Track events, mirroring samsung::wasm::ElementaryMediaTrackListener. Must
+  // be called on the main thread.
+
+  // Sinks are ready to accept data.
+  void OnTrackOpen();
+
+  // Sinks can't accept data.
+  void OnTrackClosed();
+
+  // Track is being seeked.
+  //
+  // This happens only when track is closed. When it will open data provider
+  // should send elementary media data starting from a keyframe closest to the
+  // new_time.
+  void OnSeek(Seconds new_time);
+
+  // Session id changed: stamp packets with a new session id from now on.
+  void OnSessionIdChanged(SessionId session_id);
+
+  // Time between the most recent OnSeek() and the first packet appended after
+  // it. Can be called on any thread.
+  Seconds GetLastSeekLatency() const;
+
+  // Can be called on any thread.
+  BatchStats GetBatchStats() const;
+
+  // Returns histograms of the pump's internals as a JSON object:
+  //  - queue_wait_us: time messages wait in the queue, by message type,
+  //  - append_packet_us: time a single AppendPacket() takes,
+  //  - window_packets and window_bytes: packets and bytes appended per
+  //    kSetBufferToPts,
+  //  - keyframe_lookup_us: time it takes to find keyframes to resume from
+  //    after a seek,
+  //  - buffer_ahead_margin_ms: data buffered ahead of a playback position at
+  //    every UpdateTime().
+  // Can be called on any thread.
+  std::string GetMetricsJson() const;
+
+  // Time the track first opened or a default constructed time_point if it
+  // didn't open yet. Must be called on the main thread.
+  std::chrono::steady_clock::time_point GetFirstTrackOpenTime() const;
+
+  // Time the first packet was appended or a default constructed time_point
+  // if none was appended yet. Can be called on any thread.
+  std::chrono::steady_clock::time_point GetFirstAppendTime() const;
+
+  // Must be called on the main thread.
+  const BufferAheadController& GetBufferAheadController() const;
+
+ protected:
+  size_t GetTrackCount() const;
+
+  // The pump appends to sinks on its worker thread.
+  PacketSink* GetSink(size_t track_idx);
+
+ private:
+  // Compares WorkerMessageQueue with the mutex guarded queue it replaced, see
+  // tools/message_queue_benchmark.cc.
+  friend class MessageQueueBenchmark;
+
+  // Tracks fed by the pump, the video track comes first.
+  std::vector<Track> tracks_;
+
+  // Main thread -> worker thread message queue.
+  //
+  // This is a bounded, lock-free single-producer/single-consumer ring: main
+  // (JS) thread is the only producer and the worker thread is the only
+  // consumer. Main thread never takes a lock nor waits for the worker, while an
+  // idle worker sleeps on a futex until a new message arrives.
+  class WorkerMessageQueue {
+   public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Message {
+      enum class Type { kSetBufferToPts, kSeekTo, kTerminate };
+
+      Message() = default;
+      Message(Type type,
+              Seconds time,
+              SessionId session_id,
+              Seconds playback_time = Seconds{0},
+              bool gop_only = false);
+
+      Type type;
+      Seconds time;
+      SessionId session_id;
+      // Used only by kSetBufferToPts: packets preceding this time were
+      // already played.
+      Seconds playback_time;
+      // Used only by kSetBufferToPts: buffering stops at the end of a GOP
+      // containing playback_time, even if time is further.
+      bool gop_only;
+      // Set when the message is pushed to the queue.
+      Clock::time_point push_time;
+    };  // struct Message
+
+    // Maximum number of pending messages. kSetBufferToPts messages are
+    // throttled with kWorkerUpdateThreshold and a seek flushes the queue, so
+    // only a handful of messages are pending at any time. Must be a power of 2.
+    static constexpr uint32_t kCapacity = 64;
+
+    // Methods below must be called on the producer (main) thread only.
+    void Flush();
+    void PushBufferToPts(Seconds time,
+                         SessionId session_id,
+                         Seconds playback_time,
+                         bool gop_only = false);
+    void PushSeekTo(Seconds time);
+    void PushTerminate();
+
+    // Methods below must be called on the consumer (worker) thread only.
+
+    // Blocks until a message is available or the deadline passes. Returns
+    // false if the deadline passed.
+    bool Pop(Clock::time_point deadline, Message* message);
+
+    // Returns false if there is no message waiting.
+    bool TryPop(Message* message);
+
+    // Skips messages flushed by the producer, freeing their slots.
+    void DropFlushed();
+
+    bool HasPending() const;
+
+    // Returns a value that changes whenever the producer flushes the queue.
+    uint32_t GetFlushIndex() const;
+
+    // Pops the next message into *message if it's a kSetBufferToPts one.
+    // Returns false if there is no such message waiting.
+    bool PopPendingBufferToPts(Message* message);
+
+    // Returns true if a kSeekTo or kTerminate message is waiting to be popped.
+    // Long running operations should check it periodically and return early,
+    // since their results are about to be discarded anyway.
+    bool IsPreempted() const;
+
+   private:
+    static_assert((kCapacity & (kCapacity - 1)) == 0,
+                  "kCapacity must be a power of 2");
+
+    // Returns false if the ring is full.
+    bool TryPush(Message message);
+
+    std::array<Message, kCapacity> ring_;
+
+    // Indices grow monotonically and wrap around at 2^32, which is a multiple
+    // of kCapacity. write_index_ is written only by the producer and
+    // read_index_ only by the consumer.
+    std::atomic<uint32_t> write_index_{0};
+    std::atomic<uint32_t> read_index_{0};
+
+    // Messages below this index were flushed by the producer and will be
+    // skipped by the consumer.
+    std::atomic<uint32_t> flush_index_{0};
+
+    // Index one past the most recent kSeekTo or kTerminate message.
+    std::atomic<uint32_t> preempt_index_{0};
+
+    // Set while the consumer sleeps on write_index_, so that the producer
+    // issues futex wake-ups only when they are needed.
+    std::atomic<uint32_t> consumer_waiting_{0};
+  };  // class WorkerMessageQueue
+
+  // State of a track used only by the worker.
+  struct TrackState {
+    explicit TrackState(const Track& track);
+
+    // Updated when the packet source produces new packets.
+    KeyframeIndex keyframe_index;
+    // Packets in [played_packet_idx, packet_idx) were appended, but not
+    // played yet.
+    size_t packet_idx{0};
+    size_t played_packet_idx{0};
+    // Packets of this track staged in append_batch_.
+    size_t staged_begin{0};
+    size_t staged_end{0};
+    // End of the last appended packet.
+    Seconds buffered_until{0};
+    bool ended{false};
+  };  // struct TrackState
+
+  // A packet staged for appending to tracks_[track_idx].
+  struct StagedPacket {
+    size_t track_idx;
+    samsung::wasm::ElementaryMediaPacket packet;
+  };  // struct StagedPacket
+
+  // Worker state shared by all tracks.
+  struct WorkerState {
+    SessionId session_id{0};
+    // Size of packets of all tracks that were appended, but not played yet.
+    size_t buffered_bytes{0};
+    // Set while the first packet after a seek is yet to be appended.
+    bool seek_pending{false};
+    std::chrono::steady_clock::time_point seek_time;
+
+    // Set while packets staged for a kSetBufferToPts are being appended.
+    // In WorkerMode::kMainLoop appending can span several slices.
+    bool appending{false};
+    std::chrono::steady_clock::time_point append_start;
+    Seconds appended_duration{0};
+    uint32_t appended_count{0};
+    size_t appended_bytes{0};
+    // Set when appending stopped at max_buffered_bytes.
+    bool byte_limited{false};
+
+    bool has_appended{false};
+
+    // The most recent kSetBufferToPts and the time it buffers up to. Retried
+    // at wake_up_time if sources couldn't provide packets up to that time
+    // yet, unless the queue was flushed (e.g. the track closed) since.
+    WorkerMessageQueue::Message buffer_target;
+    Seconds buffer_target_time{0};
+    uint32_t buffer_target_flush_index{0};
+    std::chrono::steady_clock::time_point wake_up_time{
+        std::chrono::steady_clock::time_point::max()};
+    // Wake-up last scheduled with the thread pool in WorkerMode::kThreadPool.
+    std::chrono::steady_clock::time_point scheduled_wake_up_time{
+        std::chrono::steady_clock::time_point::max()};
+  };  // struct WorkerState
+
+  WorkerMessageQueue messages_;
+
+  const WorkerMode worker_mode_;
+  PumpThreadPool* const thread_pool_;
+  // Number of NotifyWorker() calls since the pump was last idle in the pool.
+  // The pump is posted to the pool only when it goes up from 0.
+  std::atomic<uint32_t> notification_count_{0};
+  // Set to 1 by the pool thread once kTerminate is handled. The main thread
+  // sleeps on it in Terminate().
+  std::atomic<uint32_t> terminated_{0};
+
+  // Must be initialized before pump_worker_ starts.
+  const BufferPolicy buffer_policy_;
+  WorkerState worker_state_;
+  std::vector<TrackState> track_states_;
+
+  // Written by the worker, stored as Seconds::rep so that they are lock-free.
+  std::atomic<Seconds::rep> last_seek_latency_{0};
+  // End of the last appended packet of the track buffered the least.
+  std::atomic<Seconds::rep> buffered_until_{0};
+  // Seconds of content appended per second of wall time, measured over the
+  // most recent kSetBufferToPts.
+  std::atomic<double> append_rate_{0};
+  // Set when the most recent kSetBufferToPts stopped at max_buffered_bytes.
+  std::atomic<bool> byte_limited_{false};
+  std::atomic<uint64_t> batch_count_{0};
+  std::atomic<uint64_t> batched_packet_count_{0};
+  std::atomic<uint32_t> largest_batch_size_{0};
+  std::atomic<std::chrono::steady_clock::rep> first_append_time_{0};
+
+  // Histograms dumped by GetMetricsJson(). queue_wait_us_ is indexed by
+  // WorkerMessageQueue::Message::Type.
+  std::array<Histogram, 3> queue_wait_us_;
+  Histogram append_packet_us_;
+  Histogram window_packets_;
+  Histogram window_bytes_;
+  Histogram keyframe_lookup_us_;
+  Histogram buffer_ahead_margin_ms_;
+
+  // Staging area for packets appended by a single kSetBufferToPts, grouped by
+  // track. Used only by the worker; kept as a member to reuse its storage.
+  std::vector<StagedPacket> append_batch_;
+
+  std::thread pump_worker_;
+
+  Seconds last_reported_running_time_;
+  SessionId session_id_{0};
+  // Every track reports the same seek, but it's handled only once.
+  bool seek_in_progress_{false};
+  // Set once Terminate() stops the worker.
+  bool stopped_{false};
+  bool standby_{false};
+  bool fast_start_{false};
+  bool track_open_{false};
+  std::chrono::steady_clock::time_point first_track_open_time_;
+
+  BufferAheadController buffer_ahead_controller_;
+
+  // Sends packets to Source. Executes on a worker thread.
+  //
+  // This sample uses a simple, already packetized media content. However, for
+  // a typical media application data processing will be more complicated and
+  // time consuming (e.g. it includes downloading data, demuxing containers,
+  // etc).
+  // Therefore processing of elementary media data on a side thread is advised,
+  // as it frees main thread (JS thread) and does not hinder application
+  // responsiveness.
+  void PumpPackets();
+
+  // PumpThreadPool::Task implementation, handles a single message or
+  // a wake-up.
+  void Run() override;
+  void OnWakeUp() override;
+
+  // Handles a message on the worker thread. Returns false if the worker
+  // should terminate. Appending packets stops at the deadline and is resumed
+  // by RunSlice().
+  bool HandleMessage(WorkerMessageQueue::Message message,
+                     WorkerMessageQueue::Clock::time_point deadline);
+
+  // Records time the message spent in the queue. Called on the worker thread.
+  void RecordQueueWait(const WorkerMessageQueue::Message& message);
+
+  // Stages packets due for a kSetBufferToPts for appending.
+  void StartAppending(const WorkerMessageQueue::Message& message);
+
+  // Appends staged packets until done or the deadline passes. Returns false if
+  // there is more to append.
+  bool ContinueAppending(WorkerMessageQueue::Clock::time_point deadline);
+
+  // Updates statistics and ends tracks once all their packets were appended.
+  void FinishAppending();
+
+  // Buffers up to the most recent target again once worker_state_.wake_up_time
+  // passes. Appending stops at the deadline and is resumed by RunSlice().
+  void RetryBuffering(WorkerMessageQueue::Clock::time_point deadline);
+
+  // Returns when buffering should be retried without waiting for a message,
+  // i.e. when a source lagging behind the buffering target expects more
+  // packets, or time_point::max() if there is no need to.
+  WorkerMessageQueue::Clock::time_point GetWakeUpTime() const;
+
+  // Wakes the worker up after a message is pushed. Called on the main thread.
+  void NotifyWorker();
+
+  // Stages packets of all tracks due up to the given time in append_batch_.
+  // Called on the worker thread.
+  void StagePackets(Seconds time, SessionId session_id);
+
+  // Returns the end of buffered data of the track buffered the least.
+  // Called on the worker thread.
+  Seconds GetBufferedUntil() const;
+};  // class PacketPump
+
+#endif  // WASM_PLAYER_SAMPLE_PACKET_PUMP_H
@@ -0,0 +1,158 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "packet_source.h"
+
+#include <sys/types.h>
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+namespace {
+
+// Files are read in chunks of this size.
+constexpr size_t kReadChunkSize = 64 * 1024;
+
+}  // namespace
+
+using ElementaryMediaPacket = samsung::wasm::ElementaryMediaPacket;
+using ElementaryVideoTrackConfig = samsung::wasm::ElementaryVideoTrackConfig;
+using Seconds = samsung::wasm::Seconds;
+
+ElementaryMediaPacket PacketSource::GetPacket(size_t index) const {
+  ElementaryMediaPacket packet;
+  FillPacket(index, &packet);
+  return packet;
+}
+
+ElementaryMediaPacket PacketSource::GetPacketInfo(size_t index) const {
+  ElementaryMediaPacket packet;
+  FillPacketInfo(index, &packet);
+  return packet;
+}
+
+StreamingFileSource::StreamingFileSource(std::FILE* file)
+    : file_(file), read_buffer_(kReadChunkSize) {}
+
+StreamingFileSource::~StreamingFileSource() {
+  std::fclose(file_);
+}
+
+size_t StreamingFileSource::GetPacketCount() const {
+  return packets_.size();
+}
+
+void StreamingFileSource::FillPacket(size_t index,
+                                     ElementaryMediaPacket* packet) const {
+  const auto& demuxed_packet = packets_[index];
+  // Payloads are produced again by ReadUntil() after seeking back.
+  assert(demuxed_packet.data.size() == demuxed_packet.packet.size);
+  *packet = demuxed_packet.packet;
+  packet->data = demuxed_packet.data.data();
+}
+
+void StreamingFileSource::FillPacketInfo(size_t index,
+                                         ElementaryMediaPacket* packet) const {
+  *packet = packets_[index].packet;
+}
+
+void StreamingFileSource::DiscardPayloadsBefore(size_t index) {
+  if (index < first_payload_idx_) {
+    // Seeking back: payloads from the first resume point up to
+    // first_payload_idx_ were freed, so they need to be produced again.
+    const bool freed = !resume_points_.empty() &&
+                       first_payload_idx_ > resume_points_.front().packet_idx;
+    first_payload_idx_ = index;
+    if (freed)
+      Resume(index);
+    return;
+  }
+  // Packets preceding the first resume point can't be produced again.
+  const auto discard_begin =
+      resume_points_.empty()
+          ? packets_.size()
+          : std::max(first_payload_idx_, resume_points_.front().packet_idx);
+  const auto discard_end = std::min(index, packets_.size());
+  for (auto packet_idx = discard_begin; packet_idx < discard_end;
+       ++packet_idx) {
+    // Swapping frees the memory, unlike clear().
+    std::vector<uint8_t>().swap(packets_[packet_idx].data);
+  }
+  first_payload_idx_ = index;
+}
+
+void StreamingFileSource::ReadUntil(Seconds time) {
+  while (!is_complete_ && (next_packet_idx_ == 0 ||
+                           packets_[next_packet_idx_ - 1].packet.dts < time)) {
+    if (!ReadChunk())
+      is_complete_ = true;
+  }
+}
+
+bool StreamingFileSource::IsComplete() const {
+  return is_complete_;
+}
+
+bool StreamingFileSource::ReadChunk() {
+  auto size = std::fread(read_buffer_.data(), 1, read_buffer_.size(), file_);
+  if (!size) {
+    ProcessChunk(nullptr, 0);
+    return false;
+  }
+  return ProcessChunk(read_buffer_.data(), size);
+}
+
+void StreamingFileSource::AddPacket(DemuxedPacket packet) {
+  const auto packet_idx = next_packet_idx_++;
+  if (packet_idx < packets_.size()) {
+    // Produced again after seeking back: only the payload is missing.
+    if (packet_idx >= first_payload_idx_)
+      packets_[packet_idx].data = std::move(packet.data);
+    return;
+  }
+  if (packet.resume_offset != DemuxedPacket::kNoResumeOffset)
+    resume_points_.push_back({packet_idx, packet.resume_offset});
+  if (packet_idx < first_payload_idx_ && !resume_points_.empty())
+    packet.data = {};
+  packets_.push_back(std::move(packet));
+}
+
+void StreamingFileSource::Resume(size_t packet_idx) {
+  // Packets that weren't produced yet will be produced anyway.
+  if (packet_idx >= next_packet_idx_)
+    return;
+  auto resume_point = std::upper_bound(
+      resume_points_.cbegin(), resume_points_.cend(), packet_idx,
+      [](size_t packet_idx, const ResumePoint& resume_point) {
+        return packet_idx < resume_point.packet_idx;
+      });
+  // Packets preceding the first resume point still have their payloads.
+  if (resume_point != resume_points_.cbegin())
+    --resume_point;
+  if (fseeko(file_, static_cast<off_t>(resume_point->offset), SEEK_SET) != 0) {
+    std::cout << "Cannot seek back in a file." << std::endl;
+    return;
+  }
+  ResumeAt(resume_point->offset, packets_[resume_point->packet_idx].packet);
+  next_packet_idx_ = resume_point->packet_idx;
+  is_complete_ = false;
+}
@@ -0,0 +1,194 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef WASM_PLAYER_SAMPLE_PACKET_SOURCE_H
+#define WASM_PLAYER_SAMPLE_PACKET_SOURCE_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <limits>
+#include <vector>
+
+#include <samsung/wasm/elementary_media_packet.h>
+#include <samsung/wasm/elementary_video_track_config.h>
+
+// Random access source of Elementary Media Packets of a video track.
+//
+// GetDuration() and GetVideoTrackConfig() are called on the main thread, while
+// packets are accessed by TrackDataPump's worker thread.
+class PacketSource {
+ public:
+  using ElementaryMediaPacket = samsung::wasm::ElementaryMediaPacket;
+  using ElementaryVideoTrackConfig = samsung::wasm::ElementaryVideoTrackConfig;
+  using Seconds = samsung::wasm::Seconds;
+
+  virtual ~PacketSource() = default;
+
+  virtual Seconds GetDuration() const = 0;
+  virtual const ElementaryVideoTrackConfig& GetVideoTrackConfig() const = 0;
+
+  virtual size_t GetPacketCount() const = 0;
+
+  // Fills *packet with a descriptor of a packet at the given index (in decoding
+  // order). Payload stays owned by the source and is never copied by it.
+  // Filling a descriptor in place lets the caller stamp it with a session id
+  // and append it without making any intermediate copies. It's valid until
+  // DiscardPayloadsBefore() is called with a larger index.
+  virtual void FillPacket(size_t index,
+                          ElementaryMediaPacket* packet) const = 0;
+
+  // Like FillPacket(), but data of the descriptor may be left unset. Used when
+  // only timestamps, flags or sizes of packets are needed, so that sources
+  // which read payloads on demand don't read them.
+  virtual void FillPacketInfo(size_t index,
+                              ElementaryMediaPacket* packet) const {
+    FillPacket(index, packet);
+  }
+
+  // Convenience wrappers for FillPacket() and FillPacketInfo().
+  ElementaryMediaPacket GetPacket(size_t index) const;
+  ElementaryMediaPacket GetPacketInfo(size_t index) const;
+
+  // Tells the source that payloads of packets before the given index won't be
+  // needed (e.g. as they were played), so that it can free them. FillPacket()
+  // is then called only for packets from that index on, until this is called
+  // with a smaller index (e.g. after seeking back), in which case the source
+  // must be able to fill them again, e.g. by reading them again in
+  // ReadUntil(). FillPacketInfo() works for any packet. Sources that keep all
+  // payloads in memory anyway don't need to override it.
+  virtual void DiscardPayloadsBefore(size_t /* index */) {}
+
+  // Sources that produce packets incrementally (e.g. by demuxing a stream)
+  // should make packets up to the given time available. Sources that have all
+  // packets available upfront don't need to override it.
+  virtual void ReadUntil(Seconds /* time */) {}
+
+  // Returns false if GetPacketCount() can still grow after ReadUntil().
+  virtual bool IsComplete() const { return true; }
+
+  // Sources that produce packets as time passes (e.g. received from
+  // a network) return when ReadUntil() can make more packets available, so
+  // that buffering can be retried then instead of waiting for playback to
+  // progress. time_point::max() means that more packets become available only
+  // by reading further.
+  virtual std::chrono::steady_clock::time_point GetNextPacketTime() const {
+    return std::chrono::steady_clock::time_point::max();
+  }
+};  // class PacketSource
+
+// A packet produced by a demuxer or a packetizer. packet.data is not set, as
+// payload is owned by data.
+struct DemuxedPacket {
+  static constexpr uint64_t kNoResumeOffset =
+      std::numeric_limits<uint64_t>::max();
+
+  samsung::wasm::ElementaryMediaPacket packet;
+  std::vector<uint8_t> data;
+  // Stream offset that the demuxer can be restarted from to produce this
+  // packet first (e.g. a fragment beginning with a keyframe) or
+  // kNoResumeOffset.
+  uint64_t resume_offset{kNoResumeOffset};
+};  // struct DemuxedPacket
+
+// Base class of sources that read a local file in chunks and turn it into
+// packets incrementally.
+//
+// The file is read on the worker thread as playback progresses. Descriptors
+// of produced packets are kept, but payloads are freed once the pump discards
+// them (see DiscardPayloadsBefore()), so memory use doesn't grow with
+// the content length. Seeking back before the discarded packets restarts
+// demuxing from the closest packet that it can be restarted from, i.e. from
+// the stream offset of a keyframe recorded when it was first produced.
+class StreamingFileSource : public PacketSource {
+ public:
+  ~StreamingFileSource() override;
+
+  StreamingFileSource(const StreamingFileSource&) = delete;
+  StreamingFileSource& operator=(const StreamingFileSource&) = delete;
+
+  size_t GetPacketCount() const override;
+  void FillPacket(size_t index, ElementaryMediaPacket* packet) const override;
+  void FillPacketInfo(size_t index,
+                      ElementaryMediaPacket* packet) const override;
+  void DiscardPayloadsBefore(size_t index) override;
+  void ReadUntil(Seconds time) override;
+  bool IsComplete() const override;
+
+ protected:
+  // Takes ownership of the file.
+  explicit StreamingFileSource(std::FILE* file);
+
+  // Reads the next chunk of the file and passes it to ProcessChunk(). Returns
+  // false at the end of file or on error.
+  bool ReadChunk();
+
+  // Processes a chunk of the file and adds produced packets with AddPacket().
+  // Returns false if data is malformed. Called with an empty chunk at the end
+  // of file, so that buffered data can be flushed.
+  virtual bool ProcessChunk(const uint8_t* data, size_t size) = 0;
+
+  // Drops any data buffered by ProcessChunk(), so that chunks passed to it
+  // next, read from the given stream offset on, produce the given packet
+  // first. offset is DemuxedPacket::resume_offset of that packet.
+  virtual void ResumeAt(uint64_t offset,
+                        const ElementaryMediaPacket& first_packet) = 0;
+
+  void AddPacket(DemuxedPacket packet);
+
+ private:
+  // A packet demuxing can be restarted from.
+  struct ResumePoint {
+    size_t packet_idx;
+    uint64_t offset;
+  };  // struct ResumePoint
+
+  // Restarts demuxing from the closest resume point preceding the given
+  // packet.
+  void Resume(size_t packet_idx);
+
+  std::FILE* file_;
+  std::vector<uint8_t> read_buffer_;
+  // All packets produced so far. Payloads are kept only for packets from
+  // first_payload_idx_ on and for packets preceding the first resume point,
+  // which can't be produced again.
+  std::deque<DemuxedPacket> packets_;
+  size_t first_payload_idx_{0};
+  // Index of the next packet produced, lower than packets_.size() while
+  // packets are produced again after seeking back.
+  size_t next_packet_idx_{0};
+  // Sorted by packet_idx.
+  std::vector<ResumePoint> resume_points_;
+  bool is_complete_{false};
+};  // class StreamingFileSource
+
+// Serves packets hardcoded in sample_data.h.
+class SampleDataPacketSource : public PacketSource {
+ public:
+  Seconds GetDuration() const override;
+  const ElementaryVideoTrackConfig& GetVideoTrackConfig() const override;
+  size_t GetPacketCount() const override;
+  void FillPacket(size_t index, ElementaryMediaPacket* packet) const override;
+};  // class SampleDataPacketSource
+
+#endif  // WASM_PLAYER_SAMPLE_PACKET_SOURCE_H
@@ -0,0 +1,177 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "pump_thread_pool.h"
+
+#include <algorithm>
+
+#include "futex.h"
+#include "tracing.h"
+
+PumpThreadPool::PumpThreadPool(size_t thread_count) {
+  for (uint32_t idx = 0; idx < kCapacity; ++idx)
+    ring_[idx].sequence.store(idx, std::memory_order_relaxed);
+  threads_.reserve(thread_count);
+  for (size_t idx = 0; idx < thread_count; ++idx)
+    threads_.emplace_back([this]() { this->RunWorker(); });
+}
+
+PumpThreadPool::~PumpThreadPool() {
+  terminating_.store(true);
+  post_count_.fetch_add(1);
+  FutexWake(&post_count_, INT32_MAX);
+  for (auto& thread : threads_)
+    thread.join();
+}
+
+void PumpThreadPool::Post(Task* task) {
+  // The ring holds more tasks than there are pumps using the pool, so this
+  // only spins if the pool is misused.
+  while (!TryPush(task))
+    std::this_thread::yield();
+  post_count_.fetch_add(1);
+  if (sleeping_count_.load())
+    FutexWake(&post_count_, 1);
+}
+
+void PumpThreadPool::ScheduleWakeUp(Task* task, Clock::time_point time) {
+  Clock::rep next_wake_up_time;
+  {
+    std::lock_guard<std::mutex> lock{wake_up_mutex_};
+    next_wake_up_time = next_wake_up_time_.load();
+    auto wake_up = std::find_if(
+        wake_ups_.begin(), wake_ups_.end(),
+        [task](const WakeUp& wake_up) { return wake_up.task == task; });
+    if (wake_up == wake_ups_.end())
+      wake_ups_.push_back({time, task});
+    else
+      wake_up->time = time;
+    UpdateNextWakeUpTime();
+  }
+  if (time.time_since_epoch().count() >= next_wake_up_time)
+    return;
+  // Sleeping threads wait for a later wake-up, so make one of them recalculate
+  // its timeout.
+  post_count_.fetch_add(1);
+  if (sleeping_count_.load())
+    FutexWake(&post_count_, 1);
+}
+
+void PumpThreadPool::CancelWakeUp(Task* task) {
+  std::lock_guard<std::mutex> lock{wake_up_mutex_};
+  wake_ups_.erase(
+      std::remove_if(
+          wake_ups_.begin(), wake_ups_.end(),
+          [task](const WakeUp& wake_up) { return wake_up.task == task; }),
+      wake_ups_.end());
+  UpdateNextWakeUpTime();
+}
+
+bool PumpThreadPool::TryPush(Task* task) {
+  auto index = push_index_.load(std::memory_order_relaxed);
+  while (true) {
+    auto& cell = ring_[index % kCapacity];
+    auto sequence = cell.sequence.load(std::memory_order_acquire);
+    auto difference = static_cast<int32_t>(sequence - index);
+    if (difference == 0) {
+      if (push_index_.compare_exchange_weak(index, index + 1,
+                                            std::memory_order_relaxed)) {
+        cell.task = task;
+        cell.sequence.store(index + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (difference < 0) {
+      // The cell wasn't read in the previous lap yet: the ring is full.
+      return false;
+    } else {
+      index = push_index_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+bool PumpThreadPool::TryPop(Task** task) {
+  auto index = pop_index_.load(std::memory_order_relaxed);
+  while (true) {
+    auto& cell = ring_[index % kCapacity];
+    auto sequence = cell.sequence.load(std::memory_order_acquire);
+    auto difference = static_cast<int32_t>(sequence - (index + 1));
+    if (difference == 0) {
+      if (pop_index_.compare_exchange_weak(index, index + 1,
+                                           std::memory_order_relaxed)) {
+        *task = cell.task;
+        cell.sequence.store(index + kCapacity, std::memory_order_release);
+        return true;
+      }
+    } else if (difference < 0) {
+      // Nothing was written to the cell in this lap yet: the ring is empty.
+      return false;
+    } else {
+      index = pop_index_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+void PumpThreadPool::RunDueWakeUps() {
+  if (Clock::now().time_since_epoch().count() < next_wake_up_time_.load())
+    return;
+  std::lock_guard<std::mutex> lock{wake_up_mutex_};
+  const auto now = Clock::now();
+  for (size_t idx = 0; idx < wake_ups_.size();) {
+    if (wake_ups_[idx].time > now) {
+      ++idx;
+      continue;
+    }
+    auto* task = wake_ups_[idx].task;
+    wake_ups_[idx] = wake_ups_.back();
+    wake_ups_.pop_back();
+    task->OnWakeUp();
+  }
+  UpdateNextWakeUpTime();
+}
+
+void PumpThreadPool::UpdateNextWakeUpTime() {
+  auto next_wake_up_time = Clock::time_point::max();
+  for (const auto& wake_up : wake_ups_)
+    next_wake_up_time = std::min(next_wake_up_time, wake_up.time);
+  next_wake_up_time_.store(next_wake_up_time.time_since_epoch().count());
+}
+
+void PumpThreadPool::RunWorker() {
+  tracing::SetThreadName("PumpThreadPool");
+  while (true) {
+    RunDueWakeUps();
+    Task* task = nullptr;
+    auto post_count = post_count_.load();
+    if (TryPop(&task)) {
+      task->Run();
+      continue;
+    }
+    if (terminating_.load())
+      return;
+
+    sleeping_count_.fetch_add(1);
+    // If a task was posted or a wake-up was scheduled after post_count was
+    // read, futex wait returns immediately.
+    FutexWait(&post_count_, post_count,
+              Clock::time_point{Clock::duration{next_wake_up_time_.load()}});
+    sleeping_count_.fetch_sub(1);
+  }
+}
@@ -0,0 +1,139 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef WASM_PLAYER_SAMPLE_PUMP_THREAD_POOL_H
+#define WASM_PLAYER_SAMPLE_PUMP_THREAD_POOL_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed number of worker threads shared by many TrackDataPumps.
+//
+// Running a thread per pump doesn't scale when many players run at once
+// (e.g. a mosaic or a preview grid): every thread has to be preallocated in
+// the module's pthread pool and most of them sleep most of the time. Instead,
+// a pump posts itself to the pool whenever it has messages to handle.
+//
+// Posted tasks are kept in a single lock-free FIFO run queue, so that the main
+// (JS) thread never blocks when posting and pumps are served in the order they
+// became ready. A task handles a bounded amount of work per run and posts
+// itself again if there is more, so a busy pump can't starve the others.
+//
+// A task waiting for something that happens at a known time (e.g. a live
+// source releasing its next packet) schedules a wake-up instead of holding
+// a thread. Idle threads sleep until the earliest wake-up is due.
+class PumpThreadPool {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  class Task {
+   public:
+    virtual ~Task() = default;
+
+    // Called on one of the pool's threads. A task posted once is run once.
+    virtual void Run() = 0;
+
+    // Called on one of the pool's threads once a wake-up scheduled with
+    // ScheduleWakeUp() is due. Called with the pool's wake-up lock held, so it
+    // should just post the task and must not schedule or cancel wake-ups.
+    virtual void OnWakeUp() {}
+  };  // class Task
+
+  // Maximum number of tasks waiting to be run. A task should be posted again
+  // only after it starts running, so this limits the number of tasks using the
+  // pool. Must be a power of 2.
+  static constexpr uint32_t kCapacity = 256;
+
+  explicit PumpThreadPool(size_t thread_count);
+
+  // All tasks must be done using the pool before it's destroyed.
+  ~PumpThreadPool();
+
+  PumpThreadPool(const PumpThreadPool&) = delete;
+  PumpThreadPool& operator=(const PumpThreadPool&) = delete;
+
+  // Can be called on any thread.
+  void Post(Task* task);
+
+  // Calls task->OnWakeUp() at about the given time, replacing a wake-up
+  // scheduled for the task earlier. Can be called on any thread.
+  void ScheduleWakeUp(Task* task, Clock::time_point time);
+
+  // Once this returns, OnWakeUp() of the task is neither running nor going to
+  // be called. Takes a lock shared with the pool's threads, which is held only
+  // briefly. Can be called on any thread.
+  void CancelWakeUp(Task* task);
+
+ private:
+  static_assert((kCapacity & (kCapacity - 1)) == 0,
+                "kCapacity must be a power of 2");
+
+  // A cell of a bounded multi-producer/multi-consumer ring. sequence tells
+  // whether the cell is ready to be written or read in the current lap.
+  struct Cell {
+    std::atomic<uint32_t> sequence;
+    Task* task;
+  };  // struct Cell
+
+  struct WakeUp {
+    Clock::time_point time;
+    Task* task;
+  };  // struct WakeUp
+
+  bool TryPush(Task* task);
+  bool TryPop(Task** task);
+
+  // Calls OnWakeUp() of tasks whose wake-up is due.
+  void RunDueWakeUps();
+
+  // Updates next_wake_up_time_. Must be called with wake_up_mutex_ held.
+  void UpdateNextWakeUpTime();
+
+  void RunWorker();
+
+  std::array<Cell, kCapacity> ring_;
+  std::atomic<uint32_t> push_index_{0};
+  std::atomic<uint32_t> pop_index_{0};
+
+  // Incremented on every Post(). Idle threads sleep on it.
+  std::atomic<uint32_t> post_count_{0};
+  std::atomic<uint32_t> sleeping_count_{0};
+  std::atomic<bool> terminating_{false};
+
+  // At most one wake-up per task and only a handful of tasks use the pool, so
+  // a plain vector is scanned.
+  std::mutex wake_up_mutex_;
+  std::vector<WakeUp> wake_ups_;
+  // Time of the earliest wake-up as Clock::rep, so that threads can check
+  // it without taking the lock.
+  std::atomic<Clock::rep> next_wake_up_time_{Clock::time_point::max()
+                                                 .time_since_epoch()
+                                                 .count()};
+
+  std::vector<std::thread> threads_;
+};  // class PumpThreadPool
+
+#endif  // WASM_PLAYER_SAMPLE_PUMP_THREAD_POOL_H
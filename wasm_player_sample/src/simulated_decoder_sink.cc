@@ -0,0 +1,98 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "simulated_decoder_sink.h"
+
+#include <algorithm>
+
+void SimulatedDecoderSink::AppendPacket(const ElementaryMediaPacket& packet) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  const auto end = packet.pts + packet.duration;
+  packets_.push_back({end, packet.size});
+  buffered_bytes_ += packet.size;
+  buffered_until_ = std::max(buffered_until_, end);
+  ++stats_.appended_packets;
+  stats_.appended_bytes += packet.size;
+  stats_.max_buffered_bytes =
+      std::max(stats_.max_buffered_bytes, buffered_bytes_);
+  stats_.max_buffered_duration =
+      std::max(stats_.max_buffered_duration, buffered_until_ - position_);
+}
+
+void SimulatedDecoderSink::AppendEndOfTrack(SessionId) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  end_of_track_ = true;
+}
+
+SimulatedDecoderSink::Seconds SimulatedDecoderSink::Advance(Seconds elapsed) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  if (buffered_until_ > position_)
+    started_ = true;
+  auto target = position_ + elapsed;
+  if (target > buffered_until_) {
+    // Playback can't go past appended data: either the track ended or it
+    // waits for more.
+    const auto playable_until = std::max(position_, buffered_until_);
+    if (!end_of_track_ && started_) {
+      if (!stalled_)
+        ++stats_.underrun_count;
+      stalled_ = true;
+      stats_.stall_time += target - playable_until;
+    }
+    target = playable_until;
+  } else {
+    stalled_ = false;
+  }
+  position_ = target;
+
+  while (!packets_.empty() && packets_.front().end <= position_) {
+    buffered_bytes_ -= packets_.front().size;
+    packets_.pop_front();
+    ++stats_.decoded_packets;
+  }
+  return position_;
+}
+
+void SimulatedDecoderSink::Seek(Seconds time) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  packets_.clear();
+  buffered_bytes_ = 0;
+  buffered_until_ = time;
+  end_of_track_ = false;
+  position_ = time;
+  started_ = false;
+  stalled_ = false;
+}
+
+bool SimulatedDecoderSink::HasEnded() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return end_of_track_ && position_ >= buffered_until_;
+}
+
+bool SimulatedDecoderSink::IsWaiting() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return !end_of_track_ && position_ >= buffered_until_;
+}
+
+SimulatedDecoderSink::Stats SimulatedDecoderSink::GetStats() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return stats_;
+}
@@ -0,0 +1,110 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef WASM_PLAYER_SAMPLE_SIMULATED_DECODER_SINK_H
+#define WASM_PLAYER_SAMPLE_SIMULATED_DECODER_SINK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+#include "packet_sink.h"
+
+// PacketSink that models a decoder consuming appended packets as a virtual
+// playback clock advances, so that PacketPump can be run off-device (see
+// tools/pump_simulator.cc).
+//
+// Like a media element, playback stalls when the clock reaches the end of
+// appended data before the track ends (an underrun) and resumes once more data
+// is appended. A packet is decoded, i.e. released from the buffer, once
+// playback passes its end. A driver advances the clock and reports playback
+// position to the pump with PacketPump::UpdateTime(), as SamplePlayer does on
+// OnPlaybackPositionChanged().
+//
+// AppendPacket() and AppendEndOfTrack() are called on the pump's worker thread
+// and the remaining methods on the driver's thread.
+class SimulatedDecoderSink : public PacketSink {
+ public:
+  using Seconds = samsung::wasm::Seconds;
+
+  struct Stats {
+    uint64_t appended_packets;
+    uint64_t appended_bytes;
+    uint64_t decoded_packets;
+    // Number of times playback stalled after it started. Waiting for data
+    // after a seek is not an underrun.
+    uint32_t underrun_count;
+    // Total time playback was stalled by underruns.
+    Seconds stall_time;
+    // Peak amount of data appended, but not decoded yet.
+    size_t max_buffered_bytes;
+    Seconds max_buffered_duration;
+  };  // struct Stats
+
+  SimulatedDecoderSink() = default;
+
+  SimulatedDecoderSink(const SimulatedDecoderSink&) = delete;
+  SimulatedDecoderSink& operator=(const SimulatedDecoderSink&) = delete;
+
+  void AppendPacket(const ElementaryMediaPacket& packet) override;
+  void AppendEndOfTrack(SessionId session_id) override;
+
+  // Advances the virtual clock and returns the new playback position, which
+  // moves by less than elapsed when playback stalls or reaches the end.
+  Seconds Advance(Seconds elapsed);
+
+  // Drops appended packets and moves playback to the given time, like
+  // a track does when it's seeked.
+  void Seek(Seconds time);
+
+  // Returns true once playback reached the end of the track.
+  bool HasEnded() const;
+
+  // Returns true while playback waits for data.
+  bool IsWaiting() const;
+
+  Stats GetStats() const;
+
+ private:
+  struct BufferedPacket {
+    Seconds end;
+    size_t size;
+  };  // struct BufferedPacket
+
+  mutable std::mutex mutex_;
+
+  // Packets appended, but not decoded yet, in decoding order.
+  std::deque<BufferedPacket> packets_;
+  size_t buffered_bytes_{0};
+  // End of the latest appended packet.
+  Seconds buffered_until_{0};
+  bool end_of_track_{false};
+
+  Seconds position_{0};
+  // Set once playback starts after the most recent seek.
+  bool started_{false};
+  bool stalled_{false};
+
+  Stats stats_{};
+};  // class SimulatedDecoderSink
+
+#endif  // WASM_PLAYER_SAMPLE_SIMULATED_DECODER_SINK_H
@@ -0,0 +1,204 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "tracing.h"
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace tracing {
+
+namespace internal {
+std::atomic<bool> g_enabled{false};
+}  // namespace internal
+
+namespace {
+
+// Events kept per thread.
+constexpr uint32_t kRingCapacity = 4096;
+
+static_assert((kRingCapacity & (kRingCapacity - 1)) == 0,
+              "kRingCapacity must be a power of 2");
+
+using Clock = std::chrono::steady_clock;
+
+// Fields are atomic so that an export can read them while the owning thread
+// records. Relaxed stores compile to plain stores.
+struct Event {
+  std::atomic<const char*> name{nullptr};
+  std::atomic<int64_t> start_us{0};
+  std::atomic<int64_t> duration_us{0};
+};  // struct Event
+
+struct ThreadBuffer {
+  explicit ThreadBuffer(uint32_t thread_id) : thread_id(thread_id) {}
+
+  const uint32_t thread_id;
+  std::atomic<const char*> thread_name{nullptr};
+  // Cleared when the owning thread exits, so that the buffer can be reused
+  // by another thread (e.g. a worker of a pump created after the previous
+  // one was destroyed). Events of both threads end up on the same timeline
+  // row, under the name of the newer one.
+  std::atomic<bool> in_use{true};
+  // Written only by the owning thread.
+  std::atomic<uint32_t> write_index{0};
+  std::array<Event, kRingCapacity> events;
+};  // struct ThreadBuffer
+
+// Buffers are never freed, so that events of threads that already exited
+// can be exported.
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+};  // struct Registry
+
+Registry& GetRegistry() {
+  static Registry registry;
+  return registry;
+}
+
+const Clock::time_point& GetEpoch() {
+  static const auto epoch = Clock::now();
+  return epoch;
+}
+
+int64_t ToMicroseconds(Clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(duration)
+      .count();
+}
+
+// Releases the calling thread's buffer when the thread exits.
+class ThreadState {
+ public:
+  ~ThreadState() {
+    if (buffer_)
+      buffer_->in_use.store(false);
+  }
+
+  ThreadBuffer* GetBuffer() {
+    if (!buffer_)
+      buffer_ = AcquireBuffer();
+    return buffer_;
+  }
+
+  ThreadBuffer* GetBufferIfAny() const { return buffer_; }
+
+  const char* thread_name{nullptr};
+
+ private:
+  ThreadBuffer* AcquireBuffer() {
+    auto& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock{registry.mutex};
+    ThreadBuffer* buffer = nullptr;
+    for (auto& free_buffer : registry.buffers) {
+      if (!free_buffer->in_use.load()) {
+        buffer = free_buffer.get();
+        buffer->in_use.store(true);
+        break;
+      }
+    }
+    if (!buffer) {
+      registry.buffers.push_back(std::make_unique<ThreadBuffer>(
+          static_cast<uint32_t>(registry.buffers.size() + 1)));
+      buffer = registry.buffers.back().get();
+    }
+    buffer->thread_name.store(thread_name);
+    return buffer;
+  }
+
+  ThreadBuffer* buffer_{nullptr};
+};  // class ThreadState
+
+thread_local ThreadState g_thread_state;
+
+}  // namespace
+
+void SetEnabled(bool enabled) {
+  // Timestamps are relative to the first time tracing is enabled.
+  GetEpoch();
+  internal::g_enabled.store(enabled);
+}
+
+void SetThreadName(const char* name) {
+  g_thread_state.thread_name = name;
+  if (auto* buffer = g_thread_state.GetBufferIfAny())
+    buffer->thread_name.store(name);
+}
+
+std::string ExportChromeTraceJson() {
+  auto& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock{registry.mutex};
+  std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  auto begin_event = [&]() {
+    if (!first)
+      json += ',';
+    first = false;
+  };
+  for (const auto& buffer : registry.buffers) {
+    const auto tid = std::to_string(buffer->thread_id);
+    if (const auto* thread_name = buffer->thread_name.load()) {
+      begin_event();
+      json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" +
+              tid + ",\"args\":{\"name\":\"" + thread_name + "\"}}";
+    }
+    const auto write_index =
+        buffer->write_index.load(std::memory_order_acquire);
+    const auto event_count = std::min(write_index, kRingCapacity);
+    for (auto idx = write_index - event_count; idx != write_index; ++idx) {
+      const auto& event = buffer->events[idx % kRingCapacity];
+      const auto* name = event.name.load(std::memory_order_relaxed);
+      if (!name)
+        continue;
+      begin_event();
+      json += "{\"name\":\"" + std::string{name} +
+              "\",\"ph\":\"X\",\"pid\":1,\"tid\":" + tid + ",\"ts\":" +
+              std::to_string(event.start_us.load(std::memory_order_relaxed)) +
+              ",\"dur\":" +
+              std::to_string(
+                  event.duration_us.load(std::memory_order_relaxed)) +
+              '}';
+    }
+  }
+  json += "]}";
+  return json;
+}
+
+// static
+void ScopedEvent::Record(const char* name,
+                         Clock::time_point start,
+                         Clock::time_point end) {
+  auto* buffer = g_thread_state.GetBuffer();
+  const auto write_index =
+      buffer->write_index.load(std::memory_order_relaxed);
+  auto& event = buffer->events[write_index % kRingCapacity];
+  event.name.store(name, std::memory_order_relaxed);
+  event.start_us.store(ToMicroseconds(start - GetEpoch()),
+                       std::memory_order_relaxed);
+  event.duration_us.store(ToMicroseconds(end - start),
+                          std::memory_order_relaxed);
+  buffer->write_index.store(write_index + 1, std::memory_order_release);
+}
+
+}  // namespace tracing
@@ -0,0 +1,90 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef WASM_PLAYER_SAMPLE_TRACING_H
+#define WASM_PLAYER_SAMPLE_TRACING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Optional tracing of scoped events, exported in Chrome trace event format
+// (viewable in chrome://tracing or Perfetto), so that the main (JS) thread,
+// pump workers and the render loop can be seen on a single timeline.
+//
+// Every thread records events into its own fixed size ring buffer, so
+// recording never takes a lock and only the most recent events are kept.
+// When tracing is disabled, an event costs a single branch on a relaxed
+// atomic load.
+namespace tracing {
+
+// Tracing is disabled by default.
+void SetEnabled(bool enabled);
+
+inline bool IsEnabled();
+
+// Names the calling thread in exported traces. name must outlive tracing
+// (e.g. be a string literal).
+void SetThreadName(const char* name);
+
+// Returns events currently held in all ring buffers as Chrome trace JSON.
+// Events being recorded concurrently may be missing or overwritten, so
+// tracing should be disabled first to get a consistent dump.
+std::string ExportChromeTraceJson();
+
+// Records an event spanning the lifetime of the object. name must outlive
+// tracing (e.g. be a string literal) and must not need escaping in JSON.
+class ScopedEvent {
+ public:
+  explicit ScopedEvent(const char* name)
+      : name_(IsEnabled() ? name : nullptr),
+        start_(name_ ? std::chrono::steady_clock::now()
+                     : std::chrono::steady_clock::time_point{}) {}
+
+  ~ScopedEvent() {
+    if (name_)
+      Record(name_, start_, std::chrono::steady_clock::now());
+  }
+
+  ScopedEvent(const ScopedEvent&) = delete;
+  ScopedEvent& operator=(const ScopedEvent&) = delete;
+
+ private:
+  static void Record(const char* name,
+                     std::chrono::steady_clock::time_point start,
+                     std::chrono::steady_clock::time_point end);
+
+  const char* const name_;
+  const std::chrono::steady_clock::time_point start_;
+};  // class ScopedEvent
+
+namespace internal {
+extern std::atomic<bool> g_enabled;
+}  // namespace internal
+
+inline bool IsEnabled() {
+  return internal::g_enabled.load(std::memory_order_relaxed);
+}
+
+}  // namespace tracing
+
+#endif  // WASM_PLAYER_SAMPLE_TRACING_H
@@ -0,0 +1,269 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//          *** Multi-Track Test ***
+//
+// Checks how PacketPump feeds more than one track (e.g. video and audio):
+//  - packets of all tracks are appended in decoding time order, so tracks are
+//    interleaved and none of them is buffered further than another by more
+//    than a packet,
+//  - a track whose source didn't produce packets yet holds the other tracks
+//    back: none of them is buffered more than max_track_skew past the data
+//    available for that track.
+// The pump runs in WorkerMode::kMainLoop, so the test is deterministic.
+//
+// Built and run by ctest, see CMakeLists.txt.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "packet_pump.h"
+#include "packet_sink.h"
+#include "packet_source.h"
+
+namespace {
+
+using Seconds = PacketPump::Seconds;
+
+constexpr double kVideoFps = 30.;
+// AAC frames of 1024 samples at 48 kHz.
+constexpr double kAudioFps = 48000. / 1024.;
+constexpr Seconds kContentDuration = Seconds{60.};
+constexpr Seconds kMaxTrackSkew = Seconds{1.};
+// Far enough for buffering to be limited by the data available instead.
+constexpr Seconds kBufferAhead = Seconds{10.};
+// Tolerance of comparisons of packet times.
+constexpr double kEpsilon = 1e-6;
+
+// Packets of a constant frame rate stream. Only packets up to the available
+// duration exist; the source is complete once all of them are available.
+class SyntheticPacketSource : public PacketSource {
+ public:
+  SyntheticPacketSource(double fps, bool is_video, Seconds available_duration)
+      : fps_(fps), is_video_(is_video), payload_(is_video ? 4000 : 300) {
+    SetAvailableDuration(available_duration);
+  }
+
+  void SetAvailableDuration(Seconds duration) {
+    packet_count_ = static_cast<size_t>(
+        std::min(duration, kContentDuration).count() * fps_);
+  }
+
+  // End of the last available packet.
+  Seconds GetAvailableUntil() const { return Seconds{packet_count_ / fps_}; }
+
+  Seconds GetDuration() const override { return kContentDuration; }
+
+  const ElementaryVideoTrackConfig& GetVideoTrackConfig() const override {
+    return video_track_config_;
+  }
+
+  size_t GetPacketCount() const override { return packet_count_; }
+
+  void FillPacket(size_t index, ElementaryMediaPacket* packet) const override {
+    *packet = {};
+    packet->pts = packet->dts = Seconds{index / fps_};
+    packet->duration = Seconds{1. / fps_};
+    packet->is_key_frame = !is_video_ || index % 30 == 0;
+    packet->size = payload_.size();
+    packet->data = payload_.data();
+  }
+
+  bool IsComplete() const override {
+    return packet_count_ ==
+           static_cast<size_t>(kContentDuration.count() * fps_);
+  }
+
+ private:
+  double fps_;
+  bool is_video_;
+  size_t packet_count_;
+  std::vector<uint8_t> payload_;
+  ElementaryVideoTrackConfig video_track_config_;
+};  // class SyntheticPacketSource
+
+struct AppendedPacket {
+  size_t track_idx;
+  Seconds dts;
+  Seconds pts;
+  Seconds end;
+};  // struct AppendedPacket
+
+// Logs packets appended to all tracks in order.
+class RecordingSink : public PacketSink {
+ public:
+  RecordingSink(size_t track_idx, std::vector<AppendedPacket>* log)
+      : track_idx_(track_idx), log_(log) {}
+
+  void AppendPacket(const ElementaryMediaPacket& packet) override {
+    log_->push_back({track_idx_, packet.dts, packet.pts,
+                     packet.pts + packet.duration});
+  }
+
+  void AppendEndOfTrack(SessionId) override {}
+
+ private:
+  size_t track_idx_;
+  std::vector<AppendedPacket>* log_;
+};  // class RecordingSink
+
+std::unique_ptr<PacketPump> MakePump(
+    std::shared_ptr<PacketSource> video_source,
+    std::shared_ptr<PacketSource> audio_source,
+    std::vector<AppendedPacket>* log) {
+  std::vector<PacketPump::Track> tracks;
+  tracks.push_back({std::make_unique<RecordingSink>(0, log),
+                    std::move(video_source)});
+  tracks.push_back({std::make_unique<RecordingSink>(1, log),
+                    std::move(audio_source)});
+  auto pump = std::make_unique<PacketPump>(
+      std::move(tracks),
+      PacketPump::BufferPolicy{kBufferAhead, PacketPump::kMaxBufferedBytes,
+                               kMaxTrackSkew},
+      PacketPump::WorkerMode::kMainLoop);
+  pump->OnTrackOpen();
+  return pump;
+}
+
+// Runs the worker until it handled everything queued.
+void RunWorker(PacketPump* pump) {
+  for (int slice_idx = 0; slice_idx < 100; ++slice_idx)
+    pump->RunSlice(PacketPump::kSliceBudget);
+}
+
+// Plays two complete tracks and checks that appends interleave.
+bool TestInterleaving() {
+  std::cout << "Interleaving: ";
+  std::vector<AppendedPacket> log;
+  auto pump = MakePump(
+      std::make_shared<SyntheticPacketSource>(kVideoFps, true,
+                                              kContentDuration),
+      std::make_shared<SyntheticPacketSource>(kAudioFps, false,
+                                              kContentDuration),
+      &log);
+  auto position = Seconds{0};
+  for (; position < Seconds{20.}; position += Seconds{0.25}) {
+    pump->UpdateTime(position);
+    RunWorker(pump.get());
+  }
+  const auto buffer_ahead = pump->GetBufferAheadController().GetBufferAhead();
+  pump->Terminate();
+
+  const Seconds max_packet_duration{1. / std::min(kVideoFps, kAudioFps)};
+  Seconds ends[2] = {Seconds{0}, Seconds{0}};
+  size_t counts[2] = {0, 0};
+  for (size_t log_idx = 0; log_idx < log.size(); ++log_idx) {
+    const auto& packet = log[log_idx];
+    if (log_idx > 0 && packet.dts < log[log_idx - 1].dts) {
+      std::cout << "FAILED, packet " << log_idx << " appended out of dts order"
+                << std::endl;
+      return false;
+    }
+    ends[packet.track_idx] = packet.end;
+    ++counts[packet.track_idx];
+    if (counts[0] && counts[1] &&
+        std::abs((ends[0] - ends[1]).count()) >
+            max_packet_duration.count() + kEpsilon) {
+      std::cout << "FAILED, tracks buffered until " << ends[0].count()
+                << "s and " << ends[1].count() << "s after packet " << log_idx
+                << std::endl;
+      return false;
+    }
+  }
+  // The last position update may have been throttled.
+  const auto expected_end = position - PacketPump::kWorkerUpdateThreshold -
+                            Seconds{0.25} + buffer_ahead - max_packet_duration;
+  if (!counts[0] || !counts[1] || ends[0] < expected_end ||
+      ends[1] < expected_end) {
+    std::cout << "FAILED, " << counts[0] << " video and " << counts[1]
+              << " audio packets buffered until " << ends[0].count() << "s"
+              << std::endl;
+    return false;
+  }
+  std::cout << "passed, " << counts[0] << " video and " << counts[1]
+            << " audio packets" << std::endl;
+  return true;
+}
+
+// Makes audio available in steps and checks that video never gets further
+// ahead of it than kMaxTrackSkew.
+bool TestTrackSkew() {
+  std::cout << "Track skew: ";
+  std::vector<AppendedPacket> log;
+  auto audio_source =
+      std::make_shared<SyntheticPacketSource>(kAudioFps, false, Seconds{0});
+  auto pump = MakePump(std::make_shared<SyntheticPacketSource>(
+                           kVideoFps, true, kContentDuration),
+                       audio_source, &log);
+  Seconds video_pts{0};
+  Seconds video_end{0};
+  Seconds position{0};
+  for (int step = 0; step < 8; ++step) {
+    audio_source->SetAvailableDuration(Seconds{1. * step});
+    // Positions far enough apart to make every update reach the worker.
+    position = Seconds{0.6 * step};
+    pump->UpdateTime(position);
+    RunWorker(pump.get());
+    for (const auto& packet : log) {
+      if (packet.track_idx != 0) continue;
+      video_pts = std::max(video_pts, packet.pts);
+      video_end = std::max(video_end, packet.end);
+    }
+    // Packets starting before the limit are staged.
+    const auto limit = audio_source->GetAvailableUntil() + kMaxTrackSkew;
+    if (video_pts.count() >= limit.count() - kEpsilon) {
+      std::cout << "FAILED, video buffered until " << video_end.count()
+                << "s with audio available until "
+                << audio_source->GetAvailableUntil().count() << "s"
+                << std::endl;
+      return false;
+    }
+  }
+  const auto buffer_ahead = pump->GetBufferAheadController().GetBufferAhead();
+  pump->Terminate();
+
+  // Video follows audio up to the skew.
+  const auto expected_end =
+      std::min(audio_source->GetAvailableUntil() + kMaxTrackSkew,
+               position + buffer_ahead);
+  if (video_end.count() < expected_end.count() - kEpsilon) {
+    std::cout << "FAILED, video buffered until " << video_end.count()
+              << "s, expected " << expected_end.count() << "s" << std::endl;
+    return false;
+  }
+  std::cout << "passed, video buffered until " << video_end.count()
+            << "s with audio available until "
+            << audio_source->GetAvailableUntil().count() << "s" << std::endl;
+  return true;
+}
+
+}  // namespace
+
+int main() {
+  bool passed = TestInterleaving();
+  passed &= TestTrackSkew();
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
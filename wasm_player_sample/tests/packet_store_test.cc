@@ -0,0 +1,159 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//          *** Packet Store Test ***
+//
+// Writes a small packet store file and checks that PacketStore reads payloads
+// correctly, and that a payload which can't be read in full (here because the
+// file was truncated under the store) is zeroed rather than left partial and
+// is read again once the file is readable.
+//
+// Built and run by ctest, see CMakeLists.txt.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "packet_store.h"
+
+namespace {
+
+constexpr uint32_t kPacketCount = 3;
+constexpr uint32_t kPayloadSize = 1000;
+constexpr double kFrameDuration = 1. / 30.;
+
+uint8_t GetPayloadByte(size_t packet_idx, size_t byte_idx) {
+  return static_cast<uint8_t>(packet_idx * 31 + byte_idx * 7 + 1);
+}
+
+template <typename T>
+void AppendStruct(const T& value, std::vector<uint8_t>* data) {
+  const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+  data->insert(data->end(), bytes, bytes + sizeof(value));
+}
+
+std::vector<uint8_t> MakePacketStore() {
+  const std::vector<uint8_t> extradata = {1, 2, 3, 4};
+  packet_store::FileHeader header{};
+  std::memcpy(header.magic, packet_store::kMagic, sizeof(header.magic));
+  header.version = packet_store::kVersion;
+  header.packet_count = kPacketCount;
+  header.extradata_size = extradata.size();
+  header.duration = kPacketCount * kFrameDuration;
+  std::strncpy(header.mime_type, "video/mp4; codecs=\"avc1.640028\"",
+               sizeof(header.mime_type) - 1);
+  header.width = 1920;
+  header.height = 1080;
+  header.framerate_num = 30;
+  header.framerate_den = 1;
+  header.packet_table_offset = sizeof(header);
+  header.extradata_offset = header.packet_table_offset +
+                            kPacketCount * sizeof(packet_store::PacketEntry);
+  header.payload_offset = header.extradata_offset + header.extradata_size;
+  header.payload_size = uint64_t{kPacketCount} * kPayloadSize;
+
+  std::vector<uint8_t> data;
+  AppendStruct(header, &data);
+  for (uint32_t packet_idx = 0; packet_idx < kPacketCount; ++packet_idx) {
+    packet_store::PacketEntry entry{};
+    entry.pts = entry.dts = packet_idx * kFrameDuration;
+    entry.duration = kFrameDuration;
+    entry.payload_offset = uint64_t{packet_idx} * kPayloadSize;
+    entry.payload_size = kPayloadSize;
+    entry.flags = packet_idx == 0 ? packet_store::kKeyFrameFlag : 0;
+    AppendStruct(entry, &data);
+  }
+  data.insert(data.end(), extradata.begin(), extradata.end());
+  for (size_t packet_idx = 0; packet_idx < kPacketCount; ++packet_idx) {
+    for (size_t byte_idx = 0; byte_idx < kPayloadSize; ++byte_idx)
+      data.push_back(GetPayloadByte(packet_idx, byte_idx));
+  }
+  return data;
+}
+
+// Overwrites the file in place, so that an open store sees the new content.
+bool WriteFile(const std::string& path,
+               const std::vector<uint8_t>& data,
+               size_t size) {
+  auto* file = std::fopen(path.c_str(), "wb");
+  if (!file)
+    return false;
+  const bool written = std::fwrite(data.data(), 1, size, file) == size;
+  return std::fclose(file) == 0 && written;
+}
+
+// Returns true if the payload of the packet is the expected one or, if
+// zeroed is set, all zeros.
+bool CheckPayload(const PacketStore& store, size_t packet_idx, bool zeroed) {
+  const auto packet = store.GetPacket(packet_idx);
+  if (packet.size != kPayloadSize)
+    return false;
+  const auto* data = static_cast<const uint8_t*>(packet.data);
+  for (size_t byte_idx = 0; byte_idx < kPayloadSize; ++byte_idx) {
+    if (data[byte_idx] != (zeroed ? 0 : GetPayloadByte(packet_idx, byte_idx)))
+      return false;
+  }
+  return true;
+}
+
+bool TestFailedRead(const std::string& path) {
+  std::cout << "PacketStore with a failed read: ";
+  const auto data = MakePacketStore();
+  if (!WriteFile(path, data, data.size())) {
+    std::cout << "FAILED, cannot write " << path << std::endl;
+    return false;
+  }
+  auto store = PacketStore::Open(path);
+  if (!store || store->GetPacketCount() != kPacketCount ||
+      !CheckPayload(*store, 0, false)) {
+    std::cout << "FAILED to open" << std::endl;
+    return false;
+  }
+  // Cut the file in the middle of the last packet.
+  if (!WriteFile(path, data, data.size() - kPayloadSize / 2)) {
+    std::cout << "FAILED, cannot truncate " << path << std::endl;
+    return false;
+  }
+  if (!CheckPayload(*store, 1, false) ||
+      !CheckPayload(*store, kPacketCount - 1, true)) {
+    std::cout << "FAILED, partial payload of a truncated file" << std::endl;
+    return false;
+  }
+  if (!WriteFile(path, data, data.size()) ||
+      !CheckPayload(*store, kPacketCount - 1, false)) {
+    std::cout << "FAILED, payload not read again" << std::endl;
+    return false;
+  }
+  std::cout << "passed" << std::endl;
+  return true;
+}
+
+}  // namespace
+
+int main() {
+  const std::string path = "packet_store_test.emps";
+  const bool passed = TestFailedRead(path);
+  std::remove(path.c_str());
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
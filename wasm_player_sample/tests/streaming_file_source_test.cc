@@ -0,0 +1,448 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//          *** Streaming File Source Test ***
+//
+// Checks that StreamingFileSource frees payloads the pump discards and
+// produces them again after seeking back. A fragmented MP4 file and an H.264
+// Annex-B file are generated, played forward while payloads behind the
+// playback position are discarded, and then seeked back: packets produced
+// again must match the ones produced the first time. Also checks that
+// Fmp4Demuxer rejects fragments whose samples lie outside of the stream or
+// whose sample count is out of bounds. Build it with -fsanitize=address to
+// catch reads outside of the demuxer's buffer.
+//
+// Built and run by ctest, see CMakeLists.txt.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "annexb_packetizer.h"
+#include "fmp4_demuxer.h"
+
+namespace {
+
+using Seconds = samsung::wasm::Seconds;
+
+constexpr uint32_t kTimescale = 90000;
+constexpr uint32_t kFps = 30;
+constexpr uint32_t kFramesPerGop = 15;
+constexpr uint32_t kGopCount = 20;
+constexpr uint32_t kFrameCount = kFramesPerGop * kGopCount;
+
+// Payload bytes of a frame, never 0, so that they don't emulate start codes.
+uint8_t GetPayloadByte(uint32_t frame_idx, size_t byte_idx) {
+  return static_cast<uint8_t>(2 + (frame_idx * 7 + byte_idx) % 250);
+}
+
+size_t GetPayloadSize(uint32_t frame_idx) {
+  return 2000 + frame_idx % 100;
+}
+
+void AppendU8(std::vector<uint8_t>* out, uint8_t value) {
+  out->push_back(value);
+}
+
+void AppendU16(std::vector<uint8_t>* out, uint16_t value) {
+  AppendU8(out, value >> 8);
+  AppendU8(out, value & 0xFF);
+}
+
+void AppendU32(std::vector<uint8_t>* out, uint32_t value) {
+  AppendU16(out, value >> 16);
+  AppendU16(out, value & 0xFFFF);
+}
+
+void AppendU64(std::vector<uint8_t>* out, uint64_t value) {
+  AppendU32(out, static_cast<uint32_t>(value >> 32));
+  AppendU32(out, static_cast<uint32_t>(value & 0xFFFFFFFF));
+}
+
+void AppendZeros(std::vector<uint8_t>* out, size_t count) {
+  out->insert(out->end(), count, 0);
+}
+
+// Appends a box whose payload is written by fill.
+void AppendBox(std::vector<uint8_t>* out,
+               const char (&type)[5],
+               const std::function<void(std::vector<uint8_t>*)>& fill) {
+  std::vector<uint8_t> payload;
+  fill(&payload);
+  AppendU32(out, static_cast<uint32_t>(8 + payload.size()));
+  out->insert(out->end(), type, type + 4);
+  out->insert(out->end(), payload.begin(), payload.end());
+}
+
+// An initialization segment with a single H.264 track followed by a fragment
+// per GOP.
+std::vector<uint8_t> MakeFmp4() {
+  std::vector<uint8_t> file;
+  AppendBox(&file, "ftyp", [](std::vector<uint8_t>* box) {
+    box->insert(box->end(), {'i', 's', 'o', '6', 0, 0, 0, 0});
+  });
+  AppendBox(&file, "moov", [](std::vector<uint8_t>* moov) {
+    AppendBox(moov, "mvhd", [](std::vector<uint8_t>* box) {
+      AppendZeros(box, 4 + 8);
+      AppendU32(box, kTimescale);
+      AppendU32(box, kFrameCount * (kTimescale / kFps));
+      AppendZeros(box, 80);
+    });
+    AppendBox(moov, "trak", [](std::vector<uint8_t>* trak) {
+      AppendBox(trak, "tkhd", [](std::vector<uint8_t>* box) {
+        AppendZeros(box, 4 + 8);
+        AppendU32(box, 1);  // track_ID
+        AppendZeros(box, 4 + 4 + 8 + 2 + 2 + 2 + 2 + 36);
+        AppendU32(box, 640 << 16);
+        AppendU32(box, 360 << 16);
+      });
+      AppendBox(trak, "mdia", [](std::vector<uint8_t>* mdia) {
+        AppendBox(mdia, "mdhd", [](std::vector<uint8_t>* box) {
+          AppendZeros(box, 4 + 8);
+          AppendU32(box, kTimescale);
+          AppendZeros(box, 8);
+        });
+        AppendBox(mdia, "hdlr", [](std::vector<uint8_t>* box) {
+          AppendZeros(box, 8);
+          box->insert(box->end(), {'v', 'i', 'd', 'e'});
+          AppendZeros(box, 13);
+        });
+        AppendBox(mdia, "minf", [](std::vector<uint8_t>* minf) {
+          AppendBox(minf, "stbl", [](std::vector<uint8_t>* stbl) {
+            AppendBox(stbl, "stsd", [](std::vector<uint8_t>* stsd) {
+              AppendZeros(stsd, 4);
+              AppendU32(stsd, 1);  // entry_count
+              AppendBox(stsd, "avc1", [](std::vector<uint8_t>* entry) {
+                AppendZeros(entry, 6 + 2 + 2 + 2 + 12);
+                AppendU16(entry, 640);
+                AppendU16(entry, 360);
+                AppendZeros(entry, 78 - 6 - 2 - 2 - 2 - 12 - 4);
+                AppendBox(entry, "avcC", [](std::vector<uint8_t>* box) {
+                  box->insert(box->end(), {1, 0x64, 0, 0x1F, 0xFF, 0xE0, 0});
+                });
+              });
+            });
+          });
+        });
+      });
+    });
+    AppendBox(moov, "mvex", [](std::vector<uint8_t>* mvex) {
+      AppendBox(mvex, "trex", [](std::vector<uint8_t>* box) {
+        AppendZeros(box, 4);
+        AppendU32(box, 1);  // track_ID
+        AppendU32(box, 1);  // default_sample_description_index
+        AppendU32(box, kTimescale / kFps);
+        AppendU32(box, 0);
+        AppendU32(box, 0x00010000);  // Non-sync by default.
+      });
+    });
+  });
+
+  for (uint32_t gop_idx = 0; gop_idx < kGopCount; ++gop_idx) {
+    const auto first_frame = gop_idx * kFramesPerGop;
+    // moof is followed by mdat, whose payload begins after its 8-byte header.
+    std::vector<uint8_t> moof;
+    AppendBox(&moof, "moof", [first_frame](std::vector<uint8_t>* moof_box) {
+      AppendBox(moof_box, "traf", [first_frame](std::vector<uint8_t>* traf) {
+        AppendBox(traf, "tfhd", [](std::vector<uint8_t>* box) {
+          AppendZeros(box, 4);
+          AppendU32(box, 1);  // track_ID
+        });
+        AppendBox(traf, "tfdt", [first_frame](std::vector<uint8_t>* box) {
+          AppendZeros(box, 4);
+          AppendU32(box, first_frame * (kTimescale / kFps));
+        });
+        AppendBox(traf, "trun", [first_frame](std::vector<uint8_t>* box) {
+          // data_offset, first_sample_flags and sample_size present.
+          AppendU32(box, 0x000205);
+          AppendU32(box, kFramesPerGop);
+          AppendU32(box, 0);  // data_offset, patched below.
+          AppendU32(box, 0);  // Sync sample.
+          for (uint32_t frame_idx = first_frame;
+               frame_idx < first_frame + kFramesPerGop; ++frame_idx) {
+            AppendU32(box, static_cast<uint32_t>(GetPayloadSize(frame_idx)));
+          }
+        });
+      });
+    });
+    // data_offset is relative to the moof: moof, traf, tfhd (16 bytes), tfdt
+    // (16 bytes) and trun headers precede it.
+    const size_t data_offset_position = 8 + 8 + 16 + 16 + 8 + 8;
+    const auto data_offset = static_cast<uint32_t>(moof.size() + 8);
+    for (size_t byte_idx = 0; byte_idx < 4; ++byte_idx) {
+      moof[data_offset_position + byte_idx] =
+          static_cast<uint8_t>(data_offset >> (24 - 8 * byte_idx));
+    }
+    file.insert(file.end(), moof.begin(), moof.end());
+    AppendBox(&file, "mdat", [first_frame](std::vector<uint8_t>* mdat) {
+      for (uint32_t frame_idx = first_frame;
+           frame_idx < first_frame + kFramesPerGop; ++frame_idx) {
+        for (size_t byte_idx = 0; byte_idx < GetPayloadSize(frame_idx);
+             ++byte_idx) {
+          AppendU8(mdat, GetPayloadByte(frame_idx, byte_idx));
+        }
+      }
+    });
+  }
+  return file;
+}
+
+// Access units made of an access unit delimiter and a single slice, which is
+// an IDR slice at the beginning of every GOP.
+std::vector<uint8_t> MakeAnnexB() {
+  std::vector<uint8_t> file;
+  for (uint32_t frame_idx = 0; frame_idx < kFrameCount; ++frame_idx) {
+    file.insert(file.end(), {0, 0, 0, 1, 0x09, 0xF0});
+    // IDR or non-IDR slice with first_mb_in_slice == 0.
+    const uint8_t nal_header = (frame_idx % kFramesPerGop == 0) ? 0x65 : 0x41;
+    file.insert(file.end(), {0, 0, 1, nal_header, 0x80});
+    for (size_t byte_idx = 0; byte_idx < GetPayloadSize(frame_idx);
+         ++byte_idx) {
+      file.push_back(GetPayloadByte(frame_idx, byte_idx));
+    }
+  }
+  return file;
+}
+
+// Returns the ftyp and moov boxes a file begins with.
+std::vector<uint8_t> GetInitSegment(const std::vector<uint8_t>& file) {
+  size_t size = 0;
+  for (int box_idx = 0; box_idx < 2; ++box_idx) {
+    size += (uint32_t{file[size]} << 24) | (uint32_t{file[size + 1]} << 16) |
+            (uint32_t{file[size + 2]} << 8) | file[size + 3];
+  }
+  return {file.begin(), file.begin() + size};
+}
+
+// A fragment with a single traf made of the given tfhd and trun payloads,
+// followed by an mdat with mdat_size bytes of payload.
+std::vector<uint8_t> MakeFragment(const std::vector<uint8_t>& tfhd,
+                                  const std::vector<uint8_t>& trun,
+                                  size_t mdat_size) {
+  std::vector<uint8_t> fragment;
+  AppendBox(&fragment, "moof", [&](std::vector<uint8_t>* moof) {
+    AppendBox(moof, "traf", [&](std::vector<uint8_t>* traf) {
+      AppendBox(traf, "tfhd", [&](std::vector<uint8_t>* box) {
+        box->insert(box->end(), tfhd.begin(), tfhd.end());
+      });
+      AppendBox(traf, "trun", [&](std::vector<uint8_t>* box) {
+        box->insert(box->end(), trun.begin(), trun.end());
+      });
+    });
+  });
+  AppendBox(&fragment, "mdat", [mdat_size](std::vector<uint8_t>* mdat) {
+    mdat->insert(mdat->end(), mdat_size, 1);
+  });
+  return fragment;
+}
+
+// Appends malformed fragments after a valid initialization segment. Each of
+// them must make the demuxer fail without producing packets.
+bool TestMalformedFmp4(const std::vector<uint8_t>& init_segment) {
+  struct MalformedFragment {
+    const char* name;
+    std::vector<uint8_t> fragment;
+  };
+  std::vector<MalformedFragment> fragments;
+  auto make_tfhd = [](uint32_t flags, uint64_t base_data_offset,
+                      uint32_t default_sample_size) {
+    std::vector<uint8_t> tfhd;
+    AppendU32(&tfhd, flags);
+    AppendU32(&tfhd, 1);  // track_ID
+    if (flags & 0x000001)
+      AppendU64(&tfhd, base_data_offset);
+    if (flags & 0x000010)
+      AppendU32(&tfhd, default_sample_size);
+    return tfhd;
+  };
+  auto make_trun = [](uint32_t flags, uint32_t sample_count,
+                      int32_t data_offset, uint32_t sample_size) {
+    std::vector<uint8_t> trun;
+    AppendU32(&trun, flags);
+    AppendU32(&trun, sample_count);
+    if (flags & 0x000001)
+      AppendU32(&trun, static_cast<uint32_t>(data_offset));
+    if (flags & 0x000200)
+      AppendU32(&trun, sample_size);
+    return trun;
+  };
+  // base_data_offset and data_offset present, one sample with its size.
+  fragments.push_back(
+      {"sample data wrapping around the stream end",
+       MakeFragment(make_tfhd(0x000001, ~uint64_t{0} - 7, 0),
+                    make_trun(0x000201, 1, 0, 16), 64)});
+  fragments.push_back(
+      {"data offset wrapping around the stream end",
+       MakeFragment(make_tfhd(0x000001, ~uint64_t{0} - 7, 0),
+                    make_trun(0x000201, 1, 16, 16), 64)});
+  // No per-sample fields, so only the count bounds the samples.
+  fragments.push_back({"huge sample count",
+                       MakeFragment(make_tfhd(0x000010, 0, 1),
+                                    make_trun(0, 0xFFFFFFF0, 0, 0), 64)});
+  // trex of the init segment declares no default sample size.
+  fragments.push_back({"zero sample size",
+                       MakeFragment(make_tfhd(0, 0, 0),
+                                    make_trun(0, 1000, 0, 0), 64)});
+
+  std::cout << "Fmp4Demuxer with malformed fragments: ";
+  for (const auto& fragment : fragments) {
+    Fmp4Demuxer demuxer;
+    DemuxedPacket packet;
+    if (!demuxer.Append(init_segment.data(), init_segment.size()) ||
+        demuxer.Append(fragment.fragment.data(), fragment.fragment.size()) ||
+        demuxer.PopPacket(&packet)) {
+      std::cout << "FAILED, " << fragment.name << " accepted" << std::endl;
+      return false;
+    }
+  }
+  std::cout << "passed" << std::endl;
+  return true;
+}
+
+bool WriteFile(const std::string& path, const std::vector<uint8_t>& data) {
+  auto* file = std::fopen(path.c_str(), "wb");
+  if (!file)
+    return false;
+  const bool written =
+      std::fwrite(data.data(), 1, data.size(), file) == data.size();
+  return std::fclose(file) == 0 && written;
+}
+
+uint64_t HashPayload(const samsung::wasm::ElementaryMediaPacket& packet) {
+  // FNV-1a.
+  uint64_t hash = 14695981039346656037ull;
+  const auto* data = static_cast<const uint8_t*>(packet.data);
+  for (size_t byte_idx = 0; byte_idx < packet.size; ++byte_idx)
+    hash = (hash ^ data[byte_idx]) * 1099511628211ull;
+  return hash;
+}
+
+size_t GetKeyframeIndex(const PacketSource& source, Seconds time) {
+  size_t keyframe_idx = 0;
+  for (size_t packet_idx = 0; packet_idx < source.GetPacketCount();
+       ++packet_idx) {
+    const auto packet = source.GetPacketInfo(packet_idx);
+    if (packet.pts > time)
+      break;
+    if (packet.is_key_frame)
+      keyframe_idx = packet_idx;
+  }
+  return keyframe_idx;
+}
+
+// Checks that packets from the keyframe preceding seek_time up to end_time
+// match the hashes recorded on the first read.
+bool CheckSeekBack(PacketSource* source,
+                   const std::vector<uint64_t>& hashes,
+                   Seconds seek_time,
+                   Seconds end_time) {
+  const auto keyframe_idx = GetKeyframeIndex(*source, seek_time);
+  source->DiscardPayloadsBefore(keyframe_idx);
+  source->ReadUntil(end_time);
+  for (auto packet_idx = keyframe_idx; packet_idx < source->GetPacketCount();
+       ++packet_idx) {
+    const auto packet = source->GetPacketInfo(packet_idx);
+    if (packet.pts >= end_time)
+      break;
+    if (HashPayload(source->GetPacket(packet_idx)) != hashes[packet_idx]) {
+      std::cout << "packet " << packet_idx << " differs after seeking back to "
+                << seek_time.count() << "s";
+      return false;
+    }
+  }
+  return true;
+}
+
+// Plays the source to its end, discarding payloads behind the playback
+// position like PacketPump does, and seeks back.
+bool TestSource(const char* name, PacketSource* source) {
+  std::cout << name << ": ";
+  std::vector<uint64_t> hashes;
+  const auto frame_duration = Seconds{1. / kFps};
+  for (auto time = Seconds{0}; hashes.size() < kFrameCount ||
+                               !source->IsComplete();
+       time += frame_duration * kFramesPerGop / 2) {
+    source->DiscardPayloadsBefore(GetKeyframeIndex(*source, time));
+    source->ReadUntil(time + Seconds{1.});
+    if (time > frame_duration * kFrameCount * 2) {
+      std::cout << "FAILED, " << hashes.size() << " of " << kFrameCount
+                << " packets produced" << std::endl;
+      return false;
+    }
+    while (hashes.size() < source->GetPacketCount())
+      hashes.push_back(HashPayload(source->GetPacket(hashes.size())));
+  }
+  if (source->GetPacketCount() != kFrameCount) {
+    std::cout << "FAILED, " << source->GetPacketCount()
+              << " packets instead of " << kFrameCount << std::endl;
+    return false;
+  }
+
+  const auto duration = frame_duration * kFrameCount;
+  // Into a GOP whose payloads were freed, within the same GOP again, to the
+  // beginning and forward past packets that weren't produced again.
+  for (auto seek_time :
+       {duration / 2, duration / 2 + frame_duration, Seconds{0}, duration}) {
+    if (!CheckSeekBack(source, hashes, seek_time, seek_time + Seconds{2.})) {
+      std::cout << ", FAILED" << std::endl;
+      return false;
+    }
+  }
+  std::cout << "passed" << std::endl;
+  return true;
+}
+
+}  // namespace
+
+int main() {
+  const std::string fmp4_path = "streaming_file_source_test.mp4";
+  const std::string annexb_path = "streaming_file_source_test.h264";
+  const auto fmp4 = MakeFmp4();
+  if (!WriteFile(fmp4_path, fmp4) ||
+      !WriteFile(annexb_path, MakeAnnexB())) {
+    std::cout << "Cannot write test files." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  bool passed = false;
+  if (auto source = Fmp4FileSource::Open(fmp4_path)) {
+    passed = TestSource("Fmp4FileSource", source.get());
+  } else {
+    std::cout << "Fmp4FileSource: FAILED to open" << std::endl;
+  }
+  samsung::wasm::ElementaryVideoTrackConfig config{};
+  config.framerate_num = kFps;
+  config.framerate_den = 1;
+  auto annexb_source = AnnexBFileSource::Open(
+      annexb_path, AnnexBFileSource::Codec::kH264, config,
+      Seconds{static_cast<double>(kFrameCount) / kFps});
+  passed &= TestSource("AnnexBFileSource", annexb_source.get());
+  passed &= TestMalformedFmp4(GetInitSegment(fmp4));
+
+  std::remove(fmp4_path.c_str());
+  std::remove(annexb_path.c_str());
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,423 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//          *** Demux Benchmark ***
+//
+// Host tool that measures parsing throughput of Fmp4Demuxer (see
+// src/fmp4_demuxer.h) and AnnexBPacketizer (see src/annexb_packetizer.h).
+// Each file is read into memory first and then appended to a demuxer in
+// chunks, popping packets as they are produced, so that file I/O isn't
+// measured. Files ending with .mp4, .m4s or .m4v are demuxed as fragmented
+// MP4, .h265, .265 and .hevc files as HEVC Annex-B and anything else as H.264
+// Annex-B.
+//
+// Without files, synthetic content is benchmarked: an fMP4 file and an H.264
+// Annex-B stream with 15 frame GOPs at 30 fps.
+//
+// Build it with a host compiler, e.g. (Samsung WASM headers are shipped with
+// Emscripten SDK with Samsung extensions):
+//   g++ -std=gnu++14 -O2 -pthread -I../src -I<path to Samsung WASM headers>
+//       demux_benchmark.cc ../src/fmp4_demuxer.cc ../src/annexb_packetizer.cc
+//       ../src/packet_source.cc -o demux_benchmark
+//
+// Usage:
+//   demux_benchmark [--chunk-kb=<appended at once, default 64>]
+//                   [--repeat=<runs per file, default 5>]
+//                   [--synthetic-s=<synthetic content duration,
+//                                  default 120>]
+//                   [--fps=<Annex-B frame rate, default 30>]
+//                   [<file>...]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "annexb_packetizer.h"
+#include "fmp4_demuxer.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32_t kTimescale = 90000;
+constexpr uint32_t kSyntheticFps = 30;
+constexpr uint32_t kFramesPerGop = 15;
+
+struct Options {
+  double chunk_kb = 64.;
+  double repeat = 5.;
+  double synthetic_s = 120.;
+  double fps = 30.;
+  std::vector<std::string> files;
+};  // struct Options
+
+// Parses --name=value arguments, other arguments are files. Returns false on
+// an unknown argument.
+bool ParseOptions(int argc, char* argv[], Options* options) {
+  const struct {
+    const char* name;
+    double* value;
+  } kFlags[] = {
+      {"--chunk-kb=", &options->chunk_kb},
+      {"--repeat=", &options->repeat},
+      {"--synthetic-s=", &options->synthetic_s},
+      {"--fps=", &options->fps},
+  };
+  for (int arg_idx = 1; arg_idx < argc; ++arg_idx) {
+    if (std::strncmp(argv[arg_idx], "--", 2) != 0) {
+      options->files.push_back(argv[arg_idx]);
+      continue;
+    }
+    bool parsed = false;
+    for (const auto& flag : kFlags) {
+      const auto name_length = std::strlen(flag.name);
+      if (std::strncmp(argv[arg_idx], flag.name, name_length) == 0) {
+        *flag.value = std::atof(argv[arg_idx] + name_length);
+        parsed = true;
+        break;
+      }
+    }
+    if (!parsed) {
+      std::cout << "Unknown argument: " << argv[arg_idx] << std::endl;
+      return false;
+    }
+  }
+  return options->chunk_kb > 0. && options->repeat >= 1. &&
+         options->synthetic_s >= 1. && options->fps > 0.;
+}
+
+// Payload bytes of a frame, never 0, so that they don't emulate start codes.
+uint8_t GetPayloadByte(uint32_t frame_idx, size_t byte_idx) {
+  return static_cast<uint8_t>(2 + (frame_idx * 7 + byte_idx) % 250);
+}
+
+// About 4 Mbps at 30 fps.
+size_t GetPayloadSize(uint32_t frame_idx) {
+  return (frame_idx % kFramesPerGop == 0 ? 60000 : 12000) + frame_idx % 100;
+}
+
+void AppendU8(std::vector<uint8_t>* out, uint8_t value) {
+  out->push_back(value);
+}
+
+void AppendU16(std::vector<uint8_t>* out, uint16_t value) {
+  AppendU8(out, value >> 8);
+  AppendU8(out, value & 0xFF);
+}
+
+void AppendU32(std::vector<uint8_t>* out, uint32_t value) {
+  AppendU16(out, value >> 16);
+  AppendU16(out, value & 0xFFFF);
+}
+
+void AppendZeros(std::vector<uint8_t>* out, size_t count) {
+  out->insert(out->end(), count, 0);
+}
+
+// Appends a box whose payload is written by fill.
+void AppendBox(std::vector<uint8_t>* out,
+               const char (&type)[5],
+               const std::function<void(std::vector<uint8_t>*)>& fill) {
+  std::vector<uint8_t> payload;
+  fill(&payload);
+  AppendU32(out, static_cast<uint32_t>(8 + payload.size()));
+  out->insert(out->end(), type, type + 4);
+  out->insert(out->end(), payload.begin(), payload.end());
+}
+
+// An initialization segment with a single H.264 track followed by a fragment
+// per GOP.
+std::vector<uint8_t> MakeFmp4(uint32_t gop_count) {
+  const auto frame_count = gop_count * kFramesPerGop;
+  std::vector<uint8_t> file;
+  AppendBox(&file, "ftyp", [](std::vector<uint8_t>* box) {
+    box->insert(box->end(), {'i', 's', 'o', '6', 0, 0, 0, 0});
+  });
+  AppendBox(&file, "moov", [frame_count](std::vector<uint8_t>* moov) {
+    AppendBox(moov, "mvhd", [frame_count](std::vector<uint8_t>* box) {
+      AppendZeros(box, 4 + 8);
+      AppendU32(box, kTimescale);
+      AppendU32(box, frame_count * (kTimescale / kSyntheticFps));
+      AppendZeros(box, 80);
+    });
+    AppendBox(moov, "trak", [](std::vector<uint8_t>* trak) {
+      AppendBox(trak, "tkhd", [](std::vector<uint8_t>* box) {
+        AppendZeros(box, 4 + 8);
+        AppendU32(box, 1);  // track_ID
+        AppendZeros(box, 4 + 4 + 8 + 2 + 2 + 2 + 2 + 36);
+        AppendU32(box, 1920 << 16);
+        AppendU32(box, 1080 << 16);
+      });
+      AppendBox(trak, "mdia", [](std::vector<uint8_t>* mdia) {
+        AppendBox(mdia, "mdhd", [](std::vector<uint8_t>* box) {
+          AppendZeros(box, 4 + 8);
+          AppendU32(box, kTimescale);
+          AppendZeros(box, 8);
+        });
+        AppendBox(mdia, "hdlr", [](std::vector<uint8_t>* box) {
+          AppendZeros(box, 8);
+          box->insert(box->end(), {'v', 'i', 'd', 'e'});
+          AppendZeros(box, 13);
+        });
+        AppendBox(mdia, "minf", [](std::vector<uint8_t>* minf) {
+          AppendBox(minf, "stbl", [](std::vector<uint8_t>* stbl) {
+            AppendBox(stbl, "stsd", [](std::vector<uint8_t>* stsd) {
+              AppendZeros(stsd, 4);
+              AppendU32(stsd, 1);  // entry_count
+              AppendBox(stsd, "avc1", [](std::vector<uint8_t>* entry) {
+                AppendZeros(entry, 6 + 2 + 2 + 2 + 12);
+                AppendU16(entry, 1920);
+                AppendU16(entry, 1080);
+                AppendZeros(entry, 78 - 6 - 2 - 2 - 2 - 12 - 4);
+                AppendBox(entry, "avcC", [](std::vector<uint8_t>* box) {
+                  box->insert(box->end(), {1, 0x64, 0, 0x28, 0xFF, 0xE0, 0});
+                });
+              });
+            });
+          });
+        });
+      });
+    });
+    AppendBox(moov, "mvex", [](std::vector<uint8_t>* mvex) {
+      AppendBox(mvex, "trex", [](std::vector<uint8_t>* box) {
+        AppendZeros(box, 4);
+        AppendU32(box, 1);  // track_ID
+        AppendU32(box, 1);  // default_sample_description_index
+        AppendU32(box, kTimescale / kSyntheticFps);
+        AppendU32(box, 0);
+        AppendU32(box, 0x00010000);  // Non-sync by default.
+      });
+    });
+  });
+
+  for (uint32_t gop_idx = 0; gop_idx < gop_count; ++gop_idx) {
+    const auto first_frame = gop_idx * kFramesPerGop;
+    // moof is followed by mdat, whose payload begins after its 8-byte header.
+    std::vector<uint8_t> moof;
+    AppendBox(&moof, "moof", [first_frame](std::vector<uint8_t>* moof_box) {
+      AppendBox(moof_box, "traf", [first_frame](std::vector<uint8_t>* traf) {
+        AppendBox(traf, "tfhd", [](std::vector<uint8_t>* box) {
+          AppendZeros(box, 4);
+          AppendU32(box, 1);  // track_ID
+        });
+        AppendBox(traf, "tfdt", [first_frame](std::vector<uint8_t>* box) {
+          AppendZeros(box, 4);
+          AppendU32(box, first_frame * (kTimescale / kSyntheticFps));
+        });
+        AppendBox(traf, "trun", [first_frame](std::vector<uint8_t>* box) {
+          // data_offset, first_sample_flags and sample_size present.
+          AppendU32(box, 0x000205);
+          AppendU32(box, kFramesPerGop);
+          AppendU32(box, 0);  // data_offset, patched below.
+          AppendU32(box, 0);  // Sync sample.
+          for (uint32_t frame_idx = first_frame;
+               frame_idx < first_frame + kFramesPerGop; ++frame_idx) {
+            AppendU32(box, static_cast<uint32_t>(GetPayloadSize(frame_idx)));
+          }
+        });
+      });
+    });
+    // data_offset is relative to the moof: moof, traf, tfhd (16 bytes), tfdt
+    // (16 bytes) and trun headers precede it.
+    const size_t data_offset_position = 8 + 8 + 16 + 16 + 8 + 8;
+    const auto data_offset = static_cast<uint32_t>(moof.size() + 8);
+    for (size_t byte_idx = 0; byte_idx < 4; ++byte_idx) {
+      moof[data_offset_position + byte_idx] =
+          static_cast<uint8_t>(data_offset >> (24 - 8 * byte_idx));
+    }
+    file.insert(file.end(), moof.begin(), moof.end());
+    AppendBox(&file, "mdat", [first_frame](std::vector<uint8_t>* mdat) {
+      for (uint32_t frame_idx = first_frame;
+           frame_idx < first_frame + kFramesPerGop; ++frame_idx) {
+        for (size_t byte_idx = 0; byte_idx < GetPayloadSize(frame_idx);
+             ++byte_idx) {
+          AppendU8(mdat, GetPayloadByte(frame_idx, byte_idx));
+        }
+      }
+    });
+  }
+  return file;
+}
+
+// Access units made of an access unit delimiter and a single slice, which is
+// an IDR slice at the beginning of every GOP.
+std::vector<uint8_t> MakeAnnexB(uint32_t gop_count) {
+  std::vector<uint8_t> file;
+  for (uint32_t frame_idx = 0; frame_idx < gop_count * kFramesPerGop;
+       ++frame_idx) {
+    file.insert(file.end(), {0, 0, 0, 1, 0x09, 0xF0});
+    // IDR or non-IDR slice with first_mb_in_slice == 0.
+    const uint8_t nal_header = (frame_idx % kFramesPerGop == 0) ? 0x65 : 0x41;
+    file.insert(file.end(), {0, 0, 1, nal_header, 0x80});
+    for (size_t byte_idx = 0; byte_idx < GetPayloadSize(frame_idx);
+         ++byte_idx) {
+      file.push_back(GetPayloadByte(frame_idx, byte_idx));
+    }
+  }
+  return file;
+}
+
+bool EndsWith(const std::string& text, const char* suffix) {
+  const auto suffix_length = std::strlen(suffix);
+  return text.size() >= suffix_length &&
+         text.compare(text.size() - suffix_length, suffix_length, suffix) == 0;
+}
+
+bool IsFmp4(const std::string& path) {
+  return EndsWith(path, ".mp4") || EndsWith(path, ".m4s") ||
+         EndsWith(path, ".m4v");
+}
+
+bool IsHevc(const std::string& path) {
+  return EndsWith(path, ".h265") || EndsWith(path, ".265") ||
+         EndsWith(path, ".hevc");
+}
+
+struct RunResult {
+  Clock::duration time;
+  uint64_t packet_count;
+  uint64_t keyframe_count;
+  bool failed;
+};  // struct RunResult
+
+bool Append(Fmp4Demuxer* demuxer, const uint8_t* data, size_t size) {
+  return demuxer->Append(data, size);
+}
+
+bool Append(AnnexBPacketizer* packetizer, const uint8_t* data, size_t size) {
+  packetizer->Append(data, size);
+  return true;
+}
+
+void Flush(Fmp4Demuxer*) {}
+
+void Flush(AnnexBPacketizer* packetizer) {
+  packetizer->Flush();
+}
+
+// Appends data to the demuxer in chunks and pops all packets it produces.
+template <typename Demuxer>
+RunResult Demux(Demuxer* demuxer,
+                const std::vector<uint8_t>& data,
+                size_t chunk_size) {
+  RunResult result{};
+  const auto pop_packets = [demuxer, &result] {
+    DemuxedPacket packet;
+    while (demuxer->PopPacket(&packet)) {
+      ++result.packet_count;
+      result.keyframe_count += packet.packet.is_key_frame;
+    }
+  };
+  const auto start = Clock::now();
+  for (size_t offset = 0; offset < data.size(); offset += chunk_size) {
+    const auto size = std::min(chunk_size, data.size() - offset);
+    if (!Append(demuxer, data.data() + offset, size)) {
+      result.failed = true;
+      return result;
+    }
+    pop_packets();
+  }
+  Flush(demuxer);
+  pop_packets();
+  result.time = Clock::now() - start;
+  return result;
+}
+
+// Returns false if the data can't be demuxed.
+bool RunBenchmark(const std::string& name,
+                  const std::vector<uint8_t>& data,
+                  const Options& options) {
+  const auto chunk_size = static_cast<size_t>(options.chunk_kb * 1024.);
+  samsung::wasm::ElementaryVideoTrackConfig config{};
+  config.framerate_num = static_cast<uint32_t>(options.fps * 1000.);
+  config.framerate_den = 1000;
+
+  RunResult best{Clock::duration::max(), 0, 0, false};
+  for (int run = 0; run < static_cast<int>(options.repeat); ++run) {
+    RunResult result;
+    if (IsFmp4(name)) {
+      Fmp4Demuxer demuxer;
+      result = Demux(&demuxer, data, chunk_size);
+    } else {
+      AnnexBPacketizer packetizer{IsHevc(name)
+                                      ? AnnexBPacketizer::Codec::kHevc
+                                      : AnnexBPacketizer::Codec::kH264,
+                                  config};
+      result = Demux(&packetizer, data, chunk_size);
+    }
+    if (result.failed) {
+      std::cout << name << ": FAILED to demux" << std::endl;
+      return false;
+    }
+    if (result.time < best.time)
+      best = result;
+  }
+
+  const auto seconds = std::chrono::duration<double>(best.time).count();
+  std::cout << name << ": " << data.size() / 1e6 << " MB, "
+            << best.packet_count << " packets (" << best.keyframe_count
+            << " keyframes) in " << seconds * 1e3 << "ms, "
+            << data.size() / 1e6 / seconds << " MB/s, "
+            << best.packet_count / seconds << " packets/s" << std::endl;
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    std::cout << "Usage: " << argv[0]
+              << " [--chunk-kb=N] [--repeat=N] [--synthetic-s=N] [--fps=N]"
+              << " [<file>...]" << std::endl;
+    return 1;
+  }
+
+  bool succeeded = true;
+  if (options.files.empty()) {
+    const auto gop_count = static_cast<uint32_t>(
+        options.synthetic_s * kSyntheticFps / kFramesPerGop);
+    options.fps = kSyntheticFps;
+    succeeded &= RunBenchmark("synthetic.mp4", MakeFmp4(gop_count), options);
+    succeeded &=
+        RunBenchmark("synthetic.h264", MakeAnnexB(gop_count), options);
+  }
+  for (const auto& path : options.files) {
+    std::ifstream file{path, std::ios::binary};
+    if (!file) {
+      std::cout << path << ": FAILED to open" << std::endl;
+      succeeded = false;
+      continue;
+    }
+    const std::vector<uint8_t> data{std::istreambuf_iterator<char>{file},
+                                    std::istreambuf_iterator<char>{}};
+    succeeded &= RunBenchmark(path, data, options);
+  }
+  return succeeded ? 0 : 1;
+}
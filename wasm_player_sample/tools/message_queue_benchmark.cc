@@ -0,0 +1,256 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//          *** Message Queue Benchmark ***
+//
+// Host tool that compares PacketPump's WorkerMessageQueue, a lock-free
+// single-producer/single-consumer ring, with the std::queue guarded by a mutex
+// and a condition variable that it replaced. A producer thread plays the part
+// of the main (JS) thread and pushes a kSetBufferToPts message per
+// UpdateTime() and, every now and then, a kSeekTo one, at a fixed event rate.
+// A consumer thread plays the part of the pump's worker: it waits for
+// messages and spends a fixed time handling each one. Reported are the times
+// pushes take on the producer thread and the times from a push to the
+// consumer popping the message.
+//
+// Build it with a host compiler, e.g. (Samsung WASM headers are shipped with
+// Emscripten SDK with Samsung extensions):
+//   g++ -std=gnu++14 -pthread -I../src -I<path to Samsung WASM headers>
+//       message_queue_benchmark.cc ../src/packet_pump.cc
+//       ../src/buffer_ahead_controller.cc ../src/futex.cc
+//       ../src/histogram.cc ../src/packet_source.cc
+//       ../src/pump_thread_pool.cc ../src/tracing.cc
+//       -o message_queue_benchmark
+//
+// Usage:
+//   message_queue_benchmark [--messages=<per queue, default 200000>]
+//                           [--interval-us=<between pushes, default 10>]
+//                           [--seek-every=<push a seek every N messages,
+//                                          default 50>]
+//                           [--work-us=<consumer time per message,
+//                                      default 2>]
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+#include "histogram.h"
+#include "packet_pump.h"
+
+namespace {
+
+using Seconds = PacketPump::Seconds;
+using SessionId = PacketPump::SessionId;
+
+struct Options {
+  double messages = 200000.;
+  double interval_us = 10.;
+  double seek_every = 50.;
+  double work_us = 2.;
+};  // struct Options
+
+// Parses --name=value arguments. Returns false on an unknown argument.
+bool ParseOptions(int argc, char* argv[], Options* options) {
+  const struct {
+    const char* name;
+    double* value;
+  } kFlags[] = {
+      {"--messages=", &options->messages},
+      {"--interval-us=", &options->interval_us},
+      {"--seek-every=", &options->seek_every},
+      {"--work-us=", &options->work_us},
+  };
+  for (int arg_idx = 1; arg_idx < argc; ++arg_idx) {
+    bool parsed = false;
+    for (const auto& flag : kFlags) {
+      const auto name_length = std::strlen(flag.name);
+      if (std::strncmp(argv[arg_idx], flag.name, name_length) == 0) {
+        *flag.value = std::atof(argv[arg_idx] + name_length);
+        parsed = true;
+        break;
+      }
+    }
+    if (!parsed) {
+      std::cout << "Unknown argument: " << argv[arg_idx] << std::endl;
+      return false;
+    }
+  }
+  return options->messages >= 1. && options->interval_us >= 0. &&
+         options->seek_every >= 1. && options->work_us >= 0.;
+}
+
+void PrintPercentiles(const char* name, const Histogram& histogram) {
+  std::cout << name << " p50 " << histogram.GetPercentile(50.)
+            << " p99 " << histogram.GetPercentile(99.) << " max "
+            << histogram.GetMax();
+}
+
+template <typename Clock>
+void SpinUntil(typename Clock::time_point time) {
+  while (Clock::now() < time) {
+  }
+}
+
+}  // namespace
+
+// Friend of PacketPump, so that it can reach WorkerMessageQueue.
+class MessageQueueBenchmark {
+ public:
+  using RingQueue = PacketPump::WorkerMessageQueue;
+  using Message = RingQueue::Message;
+  using Clock = RingQueue::Clock;
+
+  // Message queue of TrackDataPump before WorkerMessageQueue became a ring.
+  // Pop() takes a deadline, so that both queues are driven the same way.
+  class MutexQueue {
+   public:
+    void PushBufferToPts(Seconds time,
+                         SessionId session_id,
+                         Seconds playback_time) {
+      {
+        std::lock_guard<std::mutex> lock{mutex_};
+        Push({Message::Type::kSetBufferToPts, time, session_id,
+              playback_time});
+      }
+      changed_.notify_one();
+    }
+
+    void PushSeekTo(Seconds time) {
+      {
+        std::lock_guard<std::mutex> lock{mutex_};
+        // Seek invalidates any actions queued previously.
+        std::queue<Message> flushed;
+        queue_.swap(flushed);
+        Push({Message::Type::kSeekTo, time, 0 /* ignored for kSeekTo */});
+      }
+      changed_.notify_one();
+    }
+
+    void PushTerminate() {
+      {
+        std::lock_guard<std::mutex> lock{mutex_};
+        std::queue<Message> flushed;
+        queue_.swap(flushed);
+        Push({Message::Type::kTerminate, Seconds{0}, 0});
+      }
+      changed_.notify_one();
+    }
+
+    bool Pop(Clock::time_point deadline, Message* message) {
+      std::unique_lock<std::mutex> lock{mutex_};
+      while (queue_.empty()) {
+        if (changed_.wait_until(lock, deadline) == std::cv_status::timeout)
+          return false;
+      }
+      *message = queue_.front();
+      queue_.pop();
+      return true;
+    }
+
+   private:
+    void Push(Message message) {
+      message.push_time = Clock::now();
+      queue_.push(message);
+    }
+
+    std::queue<Message> queue_;
+    std::condition_variable changed_;
+    std::mutex mutex_;
+  };  // class MutexQueue
+
+  template <typename Queue>
+  static void Run(const char* name, const Options& options) {
+    Queue queue;
+    Histogram push_ns;
+    Histogram wake_up_us;
+    uint64_t popped_count = 0;
+
+    std::thread consumer{[&] {
+      const auto work = std::chrono::duration_cast<Clock::duration>(
+          std::chrono::duration<double, std::micro>{options.work_us});
+      while (true) {
+        Message message;
+        if (!queue.Pop(Clock::now() + std::chrono::seconds{1}, &message))
+          continue;
+        const auto pop_time = Clock::now();
+        wake_up_us.Record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                pop_time - message.push_time)
+                .count()));
+        if (message.type == Message::Type::kTerminate)
+          break;
+        ++popped_count;
+        SpinUntil<Clock>(pop_time + work);
+      }
+    }};
+
+    const auto message_count = static_cast<uint64_t>(options.messages);
+    const auto seek_every = static_cast<uint64_t>(options.seek_every);
+    const auto interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double, std::micro>{options.interval_us});
+    auto next_push_time = Clock::now();
+    for (uint64_t message_idx = 0; message_idx < message_count;
+         ++message_idx) {
+      SpinUntil<Clock>(next_push_time);
+      next_push_time += interval;
+      const Seconds time{message_idx * 0.001};
+      const auto push_start = Clock::now();
+      if (message_idx % seek_every == seek_every - 1)
+        queue.PushSeekTo(time);
+      else
+        queue.PushBufferToPts(time, 1, time);
+      push_ns.Record(static_cast<uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                               push_start)
+              .count()));
+    }
+    queue.PushTerminate();
+    consumer.join();
+
+    std::cout << name << ": push [ns]:";
+    PrintPercentiles("", push_ns);
+    PrintPercentiles(", push to pop [us]:", wake_up_us);
+    std::cout << ", popped " << popped_count << " of " << message_count
+              << std::endl;
+  }
+};  // class MessageQueueBenchmark
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    std::cout << "Usage: " << argv[0]
+              << " [--messages=N] [--interval-us=N] [--seek-every=N]"
+              << " [--work-us=N]" << std::endl;
+    return 1;
+  }
+
+  MessageQueueBenchmark::Run<MessageQueueBenchmark::MutexQueue>(
+      "std::queue + mutex", options);
+  MessageQueueBenchmark::Run<MessageQueueBenchmark::RingQueue>(
+      "SPSC ring", options);
+  return 0;
+}
@@ -0,0 +1,333 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//          *** Multi-Player Soak Test ***
+//
+// Host tool that runs many live players at once, like a mosaic or a preview
+// grid, and reports how late pump workers wake up to append packets and how
+// much CPU the pumps use. Players run first on a shared PumpThreadPool
+// (WorkerMode::kThreadPool) and then on a thread each (WorkerMode::kOwnThread)
+// for comparison.
+//
+// Every player plays a live stream: a feeder thread pushes frames to the
+// player's LivePacketSource in real time and its JitterBuffer releases them
+// after a playout delay. The pump's worker schedules a wake-up at the release
+// time of every packet, so the time from a release to the packet reaching the
+// sink measures wake-up latency. Release times are computed like the jitter
+// buffer does, from arrival times recorded by the feeder. Streams of players
+// are shifted in time, so that releases are spread over a frame interval. The
+// main thread plays the part of the JS thread: it advances playback of every
+// player's SimulatedDecoderSink at every animation frame and reports positions
+// to the pumps.
+//
+// CPU use covers the whole process, i.e. the feeder thread too, and is given
+// in percent of a core.
+//
+// Build it with a host compiler, e.g. (Samsung WASM headers are shipped with
+// Emscripten SDK with Samsung extensions):
+//   g++ -std=gnu++14 -pthread -I../src -I<path to Samsung WASM headers>
+//       multi_player_soak.cc ../src/packet_pump.cc ../src/jitter_buffer.cc
+//       ../src/simulated_decoder_sink.cc ../src/buffer_ahead_controller.cc
+//       ../src/futex.cc ../src/histogram.cc ../src/packet_source.cc
+//       ../src/pump_thread_pool.cc ../src/tracing.cc -o multi_player_soak
+//
+// Usage:
+//   multi_player_soak [--players=<default 64>]
+//                     [--pool-threads=<default 4>]
+//                     [--duration-s=<per worker mode, default 30>]
+//                     [--fps=<default 30>]
+//                     [--frame-kb=<default 8>]
+//                     [--update-ms=<playback position update interval,
+//                                  default 250>]
+
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "histogram.h"
+#include "jitter_buffer.h"
+#include "packet_pump.h"
+#include "pump_thread_pool.h"
+#include "simulated_decoder_sink.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Seconds = PacketPump::Seconds;
+using WorkerMode = PacketPump::WorkerMode;
+
+constexpr size_t kGop = 30;
+constexpr auto kFrameInterval = std::chrono::microseconds{16667};
+const JitterBuffer::Config kJitterBufferConfig{std::chrono::milliseconds{50},
+                                               256};
+
+struct Options {
+  double players = 64.;
+  double pool_threads = 4.;
+  double duration_s = 30.;
+  double fps = 30.;
+  double frame_kb = 8.;
+  double update_ms = 250.;
+};  // struct Options
+
+// Parses --name=value arguments. Returns false on an unknown argument.
+bool ParseOptions(int argc, char* argv[], Options* options) {
+  const struct {
+    const char* name;
+    double* value;
+  } kFlags[] = {
+      {"--players=", &options->players},
+      {"--pool-threads=", &options->pool_threads},
+      {"--duration-s=", &options->duration_s},
+      {"--fps=", &options->fps},
+      {"--frame-kb=", &options->frame_kb},
+      {"--update-ms=", &options->update_ms},
+  };
+  for (int arg_idx = 1; arg_idx < argc; ++arg_idx) {
+    bool parsed = false;
+    for (const auto& flag : kFlags) {
+      const auto name_length = std::strlen(flag.name);
+      if (std::strncmp(argv[arg_idx], flag.name, name_length) == 0) {
+        *flag.value = std::atof(argv[arg_idx] + name_length);
+        parsed = true;
+        break;
+      }
+    }
+    if (!parsed) {
+      std::cout << "Unknown argument: " << argv[arg_idx] << std::endl;
+      return false;
+    }
+  }
+  return options->players >= 1. && options->pool_threads >= 1. &&
+         options->duration_s > 0. && options->fps > 0. &&
+         options->frame_kb > 0. && options->update_ms > 0.;
+}
+
+// Estimates release times of packets pushed to a JitterBuffer, i.e. tracks
+// the smallest difference between arrival time and dts like the buffer does.
+class ReleaseClock {
+ public:
+  // Called on the feeder thread right before a packet is pushed.
+  void OnArrival(Seconds dts) {
+    const auto offset =
+        Clock::now().time_since_epoch() -
+        std::chrono::duration_cast<Clock::duration>(dts);
+    if (offset.count() < min_offset_.load(std::memory_order_relaxed))
+      min_offset_.store(offset.count(), std::memory_order_release);
+  }
+
+  // Can be called on any thread.
+  Clock::time_point GetReleaseTime(Seconds dts) const {
+    return Clock::time_point{} +
+           std::chrono::duration_cast<Clock::duration>(
+               dts + kJitterBufferConfig.playout_delay) +
+           Clock::duration{min_offset_.load(std::memory_order_acquire)};
+  }
+
+ private:
+  std::atomic<Clock::rep> min_offset_{Clock::duration::max().count()};
+};  // class ReleaseClock
+
+// Records time from the release of a packet to its append.
+class LatencyRecordingSink : public SimulatedDecoderSink {
+ public:
+  LatencyRecordingSink(const ReleaseClock& release_clock,
+                       Histogram* wake_up_us)
+      : release_clock_(release_clock), wake_up_us_(wake_up_us) {}
+
+  void AppendPacket(const ElementaryMediaPacket& packet) override {
+    const auto latency =
+        Clock::now() - release_clock_.GetReleaseTime(packet.dts);
+    wake_up_us_->Record(static_cast<uint64_t>(std::max<int64_t>(
+        0, std::chrono::duration_cast<std::chrono::microseconds>(latency)
+               .count())));
+    SimulatedDecoderSink::AppendPacket(packet);
+  }
+
+ private:
+  const ReleaseClock& release_clock_;
+  Histogram* wake_up_us_;
+};  // class LatencyRecordingSink
+
+struct Player {
+  ReleaseClock release_clock;
+  std::shared_ptr<LivePacketSource> source;
+  // Owned by the pump.
+  SimulatedDecoderSink* sink;
+  std::unique_ptr<PacketPump> pump;
+  // Shift of the stream against the first player's one.
+  Clock::duration phase;
+};  // struct Player
+
+std::chrono::nanoseconds GetCpuTime(clockid_t clock) {
+  timespec time{};
+  clock_gettime(clock, &time);
+  return std::chrono::seconds{time.tv_sec} +
+         std::chrono::nanoseconds{time.tv_nsec};
+}
+
+// Pushes frames to players in real time until stopped.
+void RunFeeder(const Options& options,
+               Clock::time_point start,
+               const std::atomic<bool>& stopped,
+               std::vector<std::unique_ptr<Player>>* players) {
+  const auto frame_duration = Seconds{1. / options.fps};
+  const auto frame_size = static_cast<size_t>(options.frame_kb * 1024.);
+  for (size_t frame_idx = 0; !stopped.load(); ++frame_idx) {
+    const auto dts = frame_duration * frame_idx;
+    const auto frame_time =
+        start + std::chrono::duration_cast<Clock::duration>(dts);
+    // Players are sorted by phase.
+    for (auto& player : *players) {
+      std::this_thread::sleep_until(frame_time + player->phase);
+      DemuxedPacket packet;
+      packet.packet.pts = packet.packet.dts = dts;
+      packet.packet.duration = frame_duration;
+      packet.packet.is_key_frame = frame_idx % kGop == 0;
+      packet.data.resize(frame_size);
+      packet.packet.size = packet.data.size();
+      player->release_clock.OnArrival(dts);
+      player->source->Push(std::move(packet));
+    }
+  }
+}
+
+void PrintPercentiles(const char* name, const Histogram& histogram) {
+  std::cout << name << " p50 " << histogram.GetPercentile(50.)
+            << " p99 " << histogram.GetPercentile(99.) << " max "
+            << histogram.GetMax();
+}
+
+void RunSoak(WorkerMode worker_mode, const Options& options) {
+  const auto player_count = static_cast<size_t>(options.players);
+  const auto pool_thread_count = static_cast<size_t>(options.pool_threads);
+  std::unique_ptr<PumpThreadPool> thread_pool;
+  if (worker_mode == WorkerMode::kThreadPool)
+    thread_pool = std::make_unique<PumpThreadPool>(pool_thread_count);
+
+  Histogram wake_up_us;
+  std::vector<std::unique_ptr<Player>> players;
+  const auto frame_duration = std::chrono::duration_cast<Clock::duration>(
+      Seconds{1. / options.fps});
+  for (size_t player_idx = 0; player_idx < player_count; ++player_idx) {
+    auto player = std::make_unique<Player>();
+    player->source = std::make_shared<LivePacketSource>(
+        samsung::wasm::ElementaryVideoTrackConfig{}, kJitterBufferConfig);
+    auto sink = std::make_unique<LatencyRecordingSink>(player->release_clock,
+                                                       &wake_up_us);
+    player->sink = sink.get();
+    std::vector<PacketPump::Track> tracks;
+    tracks.push_back({std::move(sink), player->source});
+    player->pump = std::make_unique<PacketPump>(
+        std::move(tracks),
+        PacketPump::BufferPolicy{PacketPump::kLowLatencyBufferAhead,
+                                 PacketPump::kMaxBufferedBytes,
+                                 PacketPump::kMaxTrackSkew},
+        worker_mode, thread_pool.get());
+    player->phase = frame_duration * player_idx / player_count;
+    player->pump->OnTrackOpen();
+    players.push_back(std::move(player));
+  }
+
+  std::atomic<bool> stopped{false};
+  const auto start = Clock::now();
+  const auto process_cpu_start = GetCpuTime(CLOCK_PROCESS_CPUTIME_ID);
+  const auto main_cpu_start = GetCpuTime(CLOCK_THREAD_CPUTIME_ID);
+  std::thread feeder{RunFeeder, std::cref(options), start, std::cref(stopped),
+                     &players};
+
+  // Animation frames of the main thread.
+  const auto end = start + std::chrono::duration_cast<Clock::duration>(
+                               Seconds{options.duration_s});
+  const auto update_interval = std::chrono::duration_cast<Clock::duration>(
+      Seconds{options.update_ms / 1000.});
+  auto next_update = start + update_interval;
+  auto last_frame = start;
+  for (auto frame = start + kFrameInterval; frame < end;
+       frame += kFrameInterval) {
+    std::this_thread::sleep_until(frame);
+    const auto now = Clock::now();
+    const auto update = now >= next_update;
+    if (update)
+      next_update += update_interval;
+    for (auto& player : players) {
+      const auto position = player->sink->Advance(now - last_frame);
+      if (update)
+        player->pump->UpdateTime(position);
+    }
+    last_frame = now;
+  }
+  const auto wall_time = Clock::now() - start;
+  const auto process_cpu_time =
+      GetCpuTime(CLOCK_PROCESS_CPUTIME_ID) - process_cpu_start;
+  const auto main_cpu_time =
+      GetCpuTime(CLOCK_THREAD_CPUTIME_ID) - main_cpu_start;
+
+  stopped.store(true);
+  feeder.join();
+  uint64_t appended_packets = 0;
+  for (auto& player : players) {
+    player->pump->Terminate();
+    appended_packets += player->sink->GetStats().appended_packets;
+  }
+  players.clear();
+
+  auto to_percent = [wall_time](std::chrono::nanoseconds cpu_time) {
+    return 100. * cpu_time.count() /
+           std::chrono::duration_cast<std::chrono::nanoseconds>(wall_time)
+               .count();
+  };
+  if (worker_mode == WorkerMode::kThreadPool)
+    std::cout << "kThreadPool (" << pool_thread_count << " threads)";
+  else
+    std::cout << "kOwnThread (" << player_count << " threads)";
+  std::cout << ": " << player_count << " players, " << appended_packets
+            << " packets appended, wake-up latency [us]:";
+  PrintPercentiles("", wake_up_us);
+  std::cout << ", CPU " << to_percent(process_cpu_time) << "% (main thread "
+            << to_percent(main_cpu_time) << "%)" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    std::cout << "Usage: " << argv[0]
+              << " [--players=N] [--pool-threads=N] [--duration-s=N]"
+              << " [--fps=N] [--frame-kb=N] [--update-ms=N]" << std::endl;
+    return 1;
+  }
+
+  RunSoak(WorkerMode::kThreadPool, options);
+  RunSoak(WorkerMode::kOwnThread, options);
+  return 0;
+}
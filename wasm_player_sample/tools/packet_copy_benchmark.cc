@@ -0,0 +1,254 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//          *** Packet Copy Benchmark ***
+//
+// Host tool that shows what filling packet descriptors in place (see
+// PacketSource::FillPacket()) saves on the pump's append path. Packets are
+// staged in a batch and appended to a sink in two ways:
+//  - by value: a descriptor is returned by PacketSource::GetPacket(), stamped
+//    with a session id on a local copy and copied into the batch, as the pump
+//    did before,
+//  - in place: the source fills a descriptor straight in the batch, where it's
+//    stamped, as PacketPump::StagePackets() does.
+// Descriptor copies made on the way from the source to the sink are counted
+// and the time per packet is measured. Payloads are never copied in either
+// way: descriptors point at payloads owned by the source.
+//
+// Build it with a host compiler, e.g. (Samsung WASM headers are shipped with
+// Emscripten SDK with Samsung extensions):
+//   g++ -std=gnu++14 -O2 -I../src -I<path to Samsung WASM headers>
+//       packet_copy_benchmark.cc ../src/packet_source.cc
+//       -o packet_copy_benchmark
+//
+// Usage:
+//   packet_copy_benchmark [--packets=<per way, default 10000000>]
+//                         [--batch=<packets per batch, default 30>]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "packet_sink.h"
+#include "packet_source.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using ElementaryMediaPacket = PacketSource::ElementaryMediaPacket;
+using Seconds = PacketSource::Seconds;
+using SessionId = PacketSink::SessionId;
+
+constexpr double kFps = 30.;
+constexpr size_t kGop = 30;
+constexpr size_t kFrameCount = 3000;
+constexpr size_t kFrameSize = 16 * 1024;
+
+struct Options {
+  double packets = 10000000.;
+  double batch = 30.;
+};  // struct Options
+
+// Parses --name=value arguments. Returns false on an unknown argument.
+bool ParseOptions(int argc, char* argv[], Options* options) {
+  const struct {
+    const char* name;
+    double* value;
+  } kFlags[] = {
+      {"--packets=", &options->packets},
+      {"--batch=", &options->batch},
+  };
+  for (int arg_idx = 1; arg_idx < argc; ++arg_idx) {
+    bool parsed = false;
+    for (const auto& flag : kFlags) {
+      const auto name_length = std::strlen(flag.name);
+      if (std::strncmp(argv[arg_idx], flag.name, name_length) == 0) {
+        *flag.value = std::atof(argv[arg_idx] + name_length);
+        parsed = true;
+        break;
+      }
+    }
+    if (!parsed) {
+      std::cout << "Unknown argument: " << argv[arg_idx] << std::endl;
+      return false;
+    }
+  }
+  return options->packets >= 1. && options->batch >= 1.;
+}
+
+// Descriptor copies made since the last reset.
+uint64_t descriptor_copies = 0;
+
+// Like PacketPump's StagedPacket, but counts descriptor copies.
+struct StagedPacket {
+  StagedPacket() = default;
+  explicit StagedPacket(const ElementaryMediaPacket& packet)
+      : packet(packet) {
+    ++descriptor_copies;
+  }
+  StagedPacket(const StagedPacket& other)
+      : track_idx(other.track_idx), packet(other.packet) {
+    ++descriptor_copies;
+  }
+  StagedPacket& operator=(const StagedPacket& other) {
+    track_idx = other.track_idx;
+    packet = other.packet;
+    ++descriptor_copies;
+    return *this;
+  }
+
+  size_t track_idx{0};
+  ElementaryMediaPacket packet{};
+};  // struct StagedPacket
+
+// Complete stream held in memory. All packets share a single payload buffer.
+class InMemoryPacketSource : public PacketSource {
+ public:
+  InMemoryPacketSource() : payload_(kFrameSize) {}
+
+  Seconds GetDuration() const override {
+    return Seconds{kFrameCount / kFps};
+  }
+
+  const ElementaryVideoTrackConfig& GetVideoTrackConfig() const override {
+    return video_track_config_;
+  }
+
+  size_t GetPacketCount() const override { return kFrameCount; }
+
+  void FillPacket(size_t index, ElementaryMediaPacket* packet) const override {
+    *packet = {};
+    packet->pts = packet->dts = Seconds{index / kFps};
+    packet->duration = Seconds{1. / kFps};
+    packet->is_key_frame = index % kGop == 0;
+    packet->size = payload_.size();
+    packet->data = payload_.data();
+  }
+
+ private:
+  std::vector<uint8_t> payload_;
+  ElementaryVideoTrackConfig video_track_config_;
+};  // class InMemoryPacketSource
+
+// Folds appended descriptors into a checksum, so that they can't be
+// optimized away.
+class ChecksumSink : public PacketSink {
+ public:
+  void AppendPacket(const ElementaryMediaPacket& packet) override {
+    checksum_ += packet.size + packet.session_id +
+                 static_cast<uint64_t>(packet.pts.count() * 1000.);
+  }
+
+  void AppendEndOfTrack(SessionId) override {}
+
+  uint64_t GetChecksum() const { return checksum_; }
+
+ private:
+  uint64_t checksum_{0};
+};  // class ChecksumSink
+
+void StageByValue(const PacketSource& source,
+                  size_t begin,
+                  size_t end,
+                  SessionId session_id,
+                  std::vector<StagedPacket>* batch) {
+  for (auto idx = begin; idx < end; ++idx) {
+    StagedPacket packet{source.GetPacket(idx)};
+    packet.packet.session_id = session_id;
+    batch->push_back(packet);
+  }
+}
+
+void StageInPlace(const PacketSource& source,
+                  size_t begin,
+                  size_t end,
+                  SessionId session_id,
+                  std::vector<StagedPacket>* batch) {
+  for (auto idx = begin; idx < end; ++idx) {
+    batch->emplace_back();
+    auto& staged = batch->back();
+    source.FillPacket(idx, &staged.packet);
+    staged.packet.session_id = session_id;
+  }
+}
+
+template <typename Stage>
+uint64_t RunBenchmark(const char* name,
+                      const PacketSource& source,
+                      const Options& options,
+                      Stage stage) {
+  const auto packet_count = static_cast<uint64_t>(options.packets);
+  const auto batch_size = static_cast<size_t>(options.batch);
+  std::vector<StagedPacket> batch;
+  // Reserved upfront like the pump's batch, which is reused, so that
+  // reallocations don't count as copies.
+  batch.reserve(batch_size);
+  ChecksumSink sink;
+  descriptor_copies = 0;
+
+  const auto start = Clock::now();
+  size_t packet_idx = 0;
+  for (uint64_t appended = 0; appended < packet_count;
+       appended += batch.size()) {
+    const auto end = std::min(packet_idx + batch_size, kFrameCount);
+    batch.clear();
+    stage(source, packet_idx, end, 1, &batch);
+    for (const auto& staged : batch)
+      sink.AppendPacket(staged.packet);
+    packet_idx = end % kFrameCount;
+  }
+  const auto time = Clock::now() - start;
+
+  std::cout << name << ": "
+            << static_cast<double>(descriptor_copies) / packet_count
+            << " descriptor copies per packet ("
+            << sizeof(ElementaryMediaPacket) << " bytes each), "
+            << std::chrono::duration<double, std::nano>(time).count() /
+                   packet_count
+            << "ns per packet" << std::endl;
+  return sink.GetChecksum();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    std::cout << "Usage: " << argv[0] << " [--packets=N] [--batch=N]"
+              << std::endl;
+    return 1;
+  }
+
+  const InMemoryPacketSource source;
+  const auto by_value_checksum =
+      RunBenchmark("by value", source, options, StageByValue);
+  const auto in_place_checksum =
+      RunBenchmark("in place", source, options, StageInPlace);
+  if (by_value_checksum != in_place_checksum) {
+    std::cout << "Appended packets differ!" << std::endl;
+    return 1;
+  }
+  return 0;
+}
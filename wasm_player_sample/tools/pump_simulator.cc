@@ -0,0 +1,288 @@
+// Copyright (c) 2021 Samsung Electronics Inc.
+// Licensed under the MIT license.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+//          *** Track Data Pump Simulator ***
+//
+// Host tool that runs PacketPump (see src/packet_pump.h), i.e. the buffering
+// logic of TrackDataPump, against a SimulatedDecoderSink that consumes
+// packets as a virtual playback clock advances. Reports underruns, time to
+// resume after seeks, buffer occupancy and time spent in the pump on the main
+// thread, so that buffering changes can be checked for regressions without
+// a TV.
+//
+// Content is synthetic: frames of a constant bitrate stream with a keyframe
+// starting every GOP. The pump runs in WorkerMode::kMainLoop, i.e. in slices
+// on the simulation thread at every animation frame, so results other than
+// the measured run times don't depend on the machine or on thread scheduling.
+// Playback loops like in the sample: once it reaches the end, the track is
+// seeked to 0s.
+//
+// Build it with a host compiler, e.g. (Samsung WASM headers are shipped with
+// Emscripten SDK with Samsung extensions):
+//   g++ -std=gnu++14 -pthread -I../src -I<path to Samsung WASM headers>
+//       pump_simulator.cc ../src/packet_pump.cc
+//       ../src/simulated_decoder_sink.cc ../src/buffer_ahead_controller.cc
+//       ../src/futex.cc ../src/histogram.cc ../src/packet_source.cc
+//       ../src/pump_thread_pool.cc ../src/tracing.cc -o pump_simulator
+//
+// Usage:
+//   pump_simulator [--content-s=<content duration, default 120>]
+//                  [--play-s=<simulated playback time, default 600>]
+//                  [--fps=<default 30>]
+//                  [--gop=<frames per GOP, default 30>]
+//                  [--bitrate-kbps=<default 8000>]
+//                  [--update-ms=<playback position update interval,
+//                               default 250>]
+//                  [--seek-interval-s=<0 disables seeks, default 0>]
+//                  [--metrics=<1 dumps pump metrics as JSON, default 0>]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "histogram.h"
+#include "packet_pump.h"
+#include "simulated_decoder_sink.h"
+
+namespace {
+
+using Seconds = PacketPump::Seconds;
+using WallClock = std::chrono::steady_clock;
+
+// Main loop iterations happen at the display refresh rate.
+constexpr Seconds kFrameInterval = Seconds{1. / 60.};
+
+struct Options {
+  double content_s = 120.;
+  double play_s = 600.;
+  double fps = 30.;
+  double gop = 30.;
+  double bitrate_kbps = 8000.;
+  double update_ms = 250.;
+  double seek_interval_s = 0.;
+  double metrics = 0.;
+};  // struct Options
+
+// Parses --name=value arguments. Returns false on an unknown argument.
+bool ParseOptions(int argc, char* argv[], Options* options) {
+  const struct {
+    const char* name;
+    double* value;
+  } kFlags[] = {
+      {"--content-s=", &options->content_s},
+      {"--play-s=", &options->play_s},
+      {"--fps=", &options->fps},
+      {"--gop=", &options->gop},
+      {"--bitrate-kbps=", &options->bitrate_kbps},
+      {"--update-ms=", &options->update_ms},
+      {"--seek-interval-s=", &options->seek_interval_s},
+      {"--metrics=", &options->metrics},
+  };
+  for (int arg_idx = 1; arg_idx < argc; ++arg_idx) {
+    bool parsed = false;
+    for (const auto& flag : kFlags) {
+      const auto name_length = std::strlen(flag.name);
+      if (std::strncmp(argv[arg_idx], flag.name, name_length) == 0) {
+        *flag.value = std::atof(argv[arg_idx] + name_length);
+        parsed = true;
+        break;
+      }
+    }
+    if (!parsed) {
+      std::cout << "Unknown argument: " << argv[arg_idx] << std::endl;
+      return false;
+    }
+  }
+  return options->content_s > 0. && options->fps > 0. && options->gop >= 1. &&
+         options->update_ms > 0.;
+}
+
+// Constant bitrate stream where a keyframe is 4 times larger than other
+// frames. All packets share a single payload buffer, as its contents don't
+// matter to the pump.
+class SyntheticPacketSource : public PacketSource {
+ public:
+  explicit SyntheticPacketSource(const Options& options)
+      : frame_duration_(1. / options.fps),
+        frame_count_(static_cast<size_t>(options.content_s * options.fps)),
+        gop_(static_cast<size_t>(options.gop)) {
+    const auto gop_bytes = options.bitrate_kbps * 1000. / 8. * options.gop /
+                           options.fps;
+    frame_size_ = static_cast<uint32_t>(gop_bytes / (gop_ + 3));
+    payload_.resize(frame_size_ * 4);
+  }
+
+  Seconds GetDuration() const override {
+    return frame_duration_ * frame_count_;
+  }
+
+  const ElementaryVideoTrackConfig& GetVideoTrackConfig() const override {
+    return video_track_config_;
+  }
+
+  size_t GetPacketCount() const override { return frame_count_; }
+
+  void FillPacket(size_t index, ElementaryMediaPacket* packet) const override {
+    *packet = {};
+    packet->pts = packet->dts = frame_duration_ * index;
+    packet->duration = frame_duration_;
+    packet->is_key_frame = index % gop_ == 0;
+    packet->size = packet->is_key_frame ? frame_size_ * 4 : frame_size_;
+    packet->data = payload_.data();
+  }
+
+ private:
+  Seconds frame_duration_;
+  size_t frame_count_;
+  size_t gop_;
+  uint32_t frame_size_;
+  std::vector<uint8_t> payload_;
+  ElementaryVideoTrackConfig video_track_config_;
+};  // class SyntheticPacketSource
+
+uint64_t ToMicroseconds(WallClock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(duration)
+      .count();
+}
+
+void PrintPercentiles(const char* name, const Histogram& histogram) {
+  std::cout << name << " p50 " << histogram.GetPercentile(50.)
+            << " p99 " << histogram.GetPercentile(99.) << " max "
+            << histogram.GetMax();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    std::cout << "Usage: " << argv[0]
+              << " [--content-s=N] [--play-s=N] [--fps=N] [--gop=N]"
+                 " [--bitrate-kbps=N] [--update-ms=N] [--seek-interval-s=N]"
+                 " [--metrics=0|1]"
+              << std::endl;
+    return 1;
+  }
+
+  auto packet_source = std::make_shared<SyntheticPacketSource>(options);
+  auto sink_owner = std::make_unique<SimulatedDecoderSink>();
+  auto* sink = sink_owner.get();
+  std::vector<PacketPump::Track> tracks;
+  tracks.push_back({std::move(sink_owner), packet_source});
+  PacketPump pump{std::move(tracks),
+                  {PacketPump::kBufferAhead, PacketPump::kMaxBufferedBytes,
+                   PacketPump::kMaxTrackSkew},
+                  PacketPump::WorkerMode::kMainLoop};
+
+  Histogram run_slice_us;
+  Histogram update_time_us;
+  Histogram resume_ms;
+  uint32_t seek_count = 0;
+
+  const auto update_interval = Seconds{options.update_ms / 1000.};
+  const auto seek_interval = Seconds{options.seek_interval_s};
+  const auto content_duration = packet_source->GetDuration();
+  auto position = Seconds{0};
+  auto next_update = Seconds{0};
+  auto next_seek = seek_interval;
+  // Set while playback waits for data after a seek (or startup).
+  bool resume_pending = true;
+  auto resume_start = Seconds{0};
+
+  auto seek = [&](Seconds now, Seconds time) {
+    // A track closes before it's seeked and opens once it's ready for data.
+    pump.OnTrackClosed();
+    sink->Seek(time);
+    pump.OnSeek(time);
+    pump.OnTrackOpen();
+    position = time;
+    next_update = now;
+    resume_pending = true;
+    resume_start = now;
+  };
+
+  const auto wall_start = WallClock::now();
+  pump.OnTrackOpen();
+  for (auto now = Seconds{0}; now < Seconds{options.play_s};
+       now += kFrameInterval) {
+    auto call_start = WallClock::now();
+    pump.RunSlice(PacketPump::kSliceBudget);
+    run_slice_us.Record(ToMicroseconds(WallClock::now() - call_start));
+
+    position = sink->Advance(kFrameInterval);
+    if (resume_pending && !sink->IsWaiting()) {
+      resume_pending = false;
+      resume_ms.Record(
+          static_cast<uint64_t>((now - resume_start).count() * 1e3));
+    }
+    if (sink->HasEnded()) {
+      seek(now, Seconds{0});
+      continue;
+    }
+    if (seek_interval > Seconds{0} && now >= next_seek) {
+      next_seek += seek_interval;
+      ++seek_count;
+      // Jumps forward by a third of the content, wrapping around.
+      seek(now, Seconds{std::fmod((position + content_duration / 3.).count(),
+                                  content_duration.count())});
+      continue;
+    }
+    if (now >= next_update) {
+      next_update += update_interval;
+      call_start = WallClock::now();
+      pump.UpdateTime(position);
+      update_time_us.Record(ToMicroseconds(WallClock::now() - call_start));
+    }
+  }
+  const auto wall_time =
+      std::chrono::duration_cast<Seconds>(WallClock::now() - wall_start);
+
+  const auto stats = sink->GetStats();
+  std::cout << "Simulated " << options.play_s << "s of playback in "
+            << wall_time.count() << "s, seeks: " << seek_count << std::endl;
+  std::cout << "Underruns: " << stats.underrun_count
+            << ", stalled: " << stats.stall_time.count()
+            << "s, buffer ahead underruns: "
+            << pump.GetBufferAheadController().GetUnderrunCount()
+            << ", final buffer ahead: "
+            << pump.GetBufferAheadController().GetBufferAhead().count() << "s"
+            << std::endl;
+  std::cout << "Appended packets: " << stats.appended_packets
+            << ", bytes: " << stats.appended_bytes
+            << ", decoded packets: " << stats.decoded_packets
+            << ", max buffered: " << stats.max_buffered_bytes << " bytes, "
+            << stats.max_buffered_duration.count() << "s" << std::endl;
+  std::cout << "Time to play after startup and seeks [ms]:";
+  PrintPercentiles("", resume_ms);
+  std::cout << std::endl << "Main thread [us]:";
+  PrintPercentiles(" RunSlice()", run_slice_us);
+  PrintPercentiles(", UpdateTime()", update_time_us);
+  std::cout << std::endl;
+  if (options.metrics != 0.)
+    std::cout << pump.GetMetricsJson() << std::endl;
+  return 0;
+}